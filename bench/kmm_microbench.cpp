@@ -0,0 +1,1654 @@
+// Microbenchmarks for the hot paths: config parsing, mapping lookup,
+// qualified binding lookup, usage counting, touch contact construction, hotkey/modifier dispatch, overlay painting,
+// event stream publishing, trace spans, plugin action dispatch, the whole
+// key-to-touch path and simulated-time scheduling.
+//
+// Usage: kmm_microbench [--filter=SUBSTRING] [--min_time=SECONDS] [--out=FILE]
+//        kmm_microbench [--check_allocs] [--check_replays]
+//
+// Results are written as JSON in the same layout Google Benchmark uses
+// ("context" + "benchmarks" with real_time/cpu_time in ns), so the usual
+// compare tooling can diff two runs.
+//
+// Global operator new is replaced with a counting version. Benchmarks mark
+// their measured loop as steady state; the heap allocations made inside it
+// are reported per iteration, and --check_allocs exits nonzero if any
+// benchmark whose path must be allocation-free allocated at all.
+//
+// --check_replays replays key sequences through the application on a
+// simulated clock and exits nonzero if any of them ends in the wrong state.
+
+#include <windows.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include "ConfigManager.h"
+#include "KeyboardHook.h"
+#include "TouchInjector.h"
+#include "DisplayOverlay.h"
+#include "SpatialGrid.h"
+#include "ChordMatcher.h"
+#include "UsageCounters.h"
+#include "BindingTable.h"
+#include "KeyState.h"
+#include "EventStream.h"
+#include "Scheduler.h"
+#include "Clock.h"
+#include "Tracer.h"
+#include "PluginHost.h"
+#include "Application.h"
+
+// Default minimum measuring time per benchmark (seconds)
+#define DEFAULT_MIN_TIME_S 0.5
+
+// Touch injection supports up to 10 simultaneous contacts
+#define BENCH_MAX_CONTACTS 10
+
+// Overlay render target size
+#define BENCH_SCREEN_WIDTH  1920
+#define BENCH_SCREEN_HEIGHT 1080
+
+// Iterations each benchmark runs under --check_allocs
+#define CHECK_ALLOCS_ITERATIONS 2000
+
+// Heap allocations made through operator new since startup
+static std::atomic<int64_t> g_allocationCount(0);
+
+void* operator new(size_t size) {
+    g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* block = malloc(size ? size : 1);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* block) noexcept {
+    free(block);
+}
+
+void operator delete[](void* block) noexcept {
+    free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    free(block);
+}
+
+void operator delete[](void* block, size_t) noexcept {
+    free(block);
+}
+
+namespace {
+
+// Keeps results observable so the optimizer cannot drop the measured work
+volatile int64_t g_sink = 0;
+
+struct BenchState {
+    int64_t iterations;
+    int64_t bytesProcessed;
+    int64_t itemsProcessed;
+    int64_t allocationsAtStart;  // -1 until the benchmark enters its steady state
+    int64_t allocations;         // -1 if the benchmark never marked a steady state
+};
+
+// Mark the start and end of the measured loop (after setup and warm-up);
+// heap allocations in between are reported for the benchmark
+void BeginSteadyState(BenchState& state) {
+    state.allocationsAtStart = g_allocationCount.load(std::memory_order_relaxed);
+}
+
+void EndSteadyState(BenchState& state) {
+    if (state.allocationsAtStart >= 0) {
+        state.allocations = g_allocationCount.load(std::memory_order_relaxed) - state.allocationsAtStart;
+    }
+}
+
+typedef void (*BenchProc)(BenchState& state, int arg);
+
+struct BenchDef {
+    std::string name;
+    BenchProc proc;
+    int arg;
+    bool noAlloc;  // Steady state must not allocate (checked by --check_allocs)
+};
+
+struct BenchResult {
+    std::string name;
+    int64_t iterations;
+    double nsPerIteration;
+    double cpuNsPerIteration;
+    double bytesPerSecond;
+    double itemsPerSecond;
+    double allocsPerIteration;  // Negative if not measured
+};
+
+// Silences the "Loaded N mappings" style console chatter while measuring
+class ScopedQuietOutput {
+public:
+    ScopedQuietOutput() : m_oldOut(std::cout.rdbuf(&m_null)), m_oldErr(std::cerr.rdbuf(&m_null)) {}
+    ~ScopedQuietOutput() {
+        std::cout.rdbuf(m_oldOut);
+        std::cerr.rdbuf(m_oldErr);
+    }
+
+private:
+    struct NullBuffer : std::streambuf {
+        int overflow(int c) override { return c; }
+    };
+    NullBuffer m_null;
+    std::streambuf* m_oldOut;
+    std::streambuf* m_oldErr;
+};
+
+double ProcessCpuSeconds() {
+    FILETIME creation, exitTime, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel, &user)) {
+        return 0.0;
+    }
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) * 1e-7;
+}
+
+// Run a benchmark with a growing iteration count until it takes at least minTime
+BenchResult RunBenchmark(const BenchDef& def, double minTime) {
+    BenchState state = {1, 0, 0, -1, -1};
+    double elapsed = 0.0;
+    double cpuElapsed = 0.0;
+    
+    for (;;) {
+        state.bytesProcessed = 0;
+        state.itemsProcessed = 0;
+        state.allocationsAtStart = -1;
+        state.allocations = -1;
+        
+        double cpuStart = ProcessCpuSeconds();
+        auto start = std::chrono::steady_clock::now();
+        def.proc(state, def.arg);
+        auto end = std::chrono::steady_clock::now();
+        cpuElapsed = ProcessCpuSeconds() - cpuStart;
+        elapsed = std::chrono::duration<double>(end - start).count();
+        
+        if (elapsed >= minTime || state.iterations >= ((int64_t)1 << 40)) {
+            break;
+        }
+        
+        // Aim for 1.4x the minimum time, growing by at most 10x per round
+        double scale = (elapsed > 0.0) ? (minTime * 1.4 / elapsed) : 10.0;
+        if (scale > 10.0) scale = 10.0;
+        if (scale < 2.0) scale = 2.0;
+        state.iterations = static_cast<int64_t>(state.iterations * scale);
+    }
+    
+    BenchResult result;
+    result.name = def.name;
+    result.iterations = state.iterations;
+    result.nsPerIteration = elapsed * 1e9 / state.iterations;
+    result.cpuNsPerIteration = cpuElapsed * 1e9 / state.iterations;
+    result.bytesPerSecond = state.bytesProcessed / elapsed;
+    result.itemsPerSecond = state.itemsProcessed / elapsed;
+    result.allocsPerIteration = (state.allocations >= 0)
+        ? static_cast<double>(state.allocations) / state.iterations : -1.0;
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Config parsing
+// ---------------------------------------------------------------------------
+
+// Path of a temporary config file: kmm_bench_config_<name>.txt
+std::string TempConfigPath(const std::string& name) {
+    char tempDir[MAX_PATH];
+    DWORD length = GetTempPathA(MAX_PATH, tempDir);
+    std::string dir = (length > 0 && length < MAX_PATH) ? std::string(tempDir) : std::string(".\\");
+    return dir + "kmm_bench_config_" + name + ".txt";
+}
+
+// Path of a generated config with the given number of layers
+std::string GeneratedConfigPath(int layers) {
+    return TempConfigPath(std::to_string(layers));
+}
+
+// Write a config with every letter, digit and F-key mapped in the base
+// layer and in each extra layer, plus turbo lines and a set of chords.
+// Returns the file size in bytes.
+int64_t WriteGeneratedConfig(const std::string& path, int layers) {
+    std::ofstream file(path, std::ios::trunc);
+    
+    file << "# Generated by kmm_microbench\n";
+    file << "hold_triggers_continuous_tap=0\n";
+    file << "chord_resolve_window_ms=30\n";
+    file << "continuous_tap_turbo=15 50\n";
+    
+    std::vector<int> keys;
+    for (int vk = '0'; vk <= '9'; ++vk) keys.push_back(vk);
+    for (int vk = 'A'; vk <= 'Z'; ++vk) keys.push_back(vk);
+    for (int vk = VK_F1; vk <= VK_F24; ++vk) keys.push_back(vk);
+    
+    for (int layer = 0; layer <= layers; ++layer) {
+        if (layer > 0) {
+            file << "[layer bench" << layer << " hold " << (0xC0 + layer) << "]\n";
+        }
+        for (size_t i = 0; i < keys.size(); ++i) {
+            int x = static_cast<int>((i * 37 + layer * 11) % 1900);
+            int y = static_cast<int>((i * 53 + layer * 7) % 1060);
+            file << keys[i] << " " << x << " " << y << " Key" << keys[i] << "_" << layer << "\n";
+            if (i % 4 == 0) {
+                file << "turbo=" << keys[i] << " 20 50\n";
+            }
+        }
+    }
+    
+    file << "[base]\n";
+    for (int i = 0; i < 16; ++i) {
+        file << "chord=" << VK_SHIFT << "+" << ('0' + (i % 10)) << "+" << ('A' + i)
+             << " " << (100 + i * 50) << " 900 Chord" << i << "\n";
+    }
+    
+    file.flush();
+    return static_cast<int64_t>(file.tellp());
+}
+
+void BM_ConfigParse(BenchState& state, int layers) {
+    std::string path = GeneratedConfigPath(layers);
+    int64_t fileBytes = WriteGeneratedConfig(path, layers);
+    
+    {
+        ScopedQuietOutput quiet;
+        ConfigManager config(path);
+        for (int64_t i = 0; i < state.iterations; ++i) {
+            config.LoadMappings();
+        }
+        g_sink = g_sink + config.GetLayerCount();
+    }
+    
+    state.bytesProcessed = fileBytes * state.iterations;
+    DeleteFileA(path.c_str());
+}
+
+// ---------------------------------------------------------------------------
+// Mapping lookup
+// ---------------------------------------------------------------------------
+
+void BM_MappingLookup(BenchState& state, int activeLayers) {
+    const int layers = 8;
+    std::string path = GeneratedConfigPath(layers);
+    WriteGeneratedConfig(path, layers);
+    
+    {
+        ScopedQuietOutput quiet;
+        ConfigManager config(path);
+        for (int layer = 1; layer <= activeLayers && layer < config.GetLayerCount(); ++layer) {
+            config.SetLayerActive(layer, true);
+        }
+        
+        // Mix of mapped and unmapped keys in a fixed pseudo-random order
+        int order[256];
+        uint32_t seed = 12345;
+        for (int i = 0; i < 256; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            order[i] = static_cast<int>((seed >> 16) & 0xFF);
+        }
+        
+        int64_t found = 0;
+        BeginSteadyState(state);
+        for (int64_t i = 0; i < state.iterations; ++i) {
+            const KeyMapping* mapping = config.GetMapping(order[i & 255]);
+            if (mapping != nullptr) {
+                found += mapping->x;
+            }
+        }
+        EndSteadyState(state);
+        g_sink = g_sink + found;
+    }
+    
+    state.itemsProcessed = state.iterations;
+    DeleteFileA(path.c_str());
+}
+
+// Perfect hash lookup of packed binding keys; half the probes miss
+void BM_BindingLookup(BenchState& state, int bindingCount) {
+    std::vector<uint32_t> keys;
+    uint32_t seed = 12345;
+    while (static_cast<int>(keys.size()) < bindingCount) {
+        seed = seed * 1103515245u + 12345u;
+        uint32_t key = ((seed >> 8) & (BINDING_MOD_MASK | BINDING_SCANCODE | BINDING_EXTENDED)) |
+                       ((seed >> 20) & BINDING_CODE_MASK);
+        if (std::find(keys.begin(), keys.end(), key) == keys.end()) {
+            keys.push_back(key);
+        }
+    }
+    
+    BindingTable table;
+    table.Build(keys);
+    
+    uint32_t probes[256];
+    for (int i = 0; i < 256; ++i) {
+        probes[i] = (i & 1) ? keys[i % bindingCount] : (keys[i % bindingCount] ^ BINDING_MOD_WIN ^ BINDING_EXTENDED);
+    }
+    
+    int64_t found = 0;
+    BeginSteadyState(state);
+    for (int64_t i = 0; i < state.iterations; ++i) {
+        found += table.Find(probes[i & 255]);
+    }
+    EndSteadyState(state);
+    g_sink = g_sink + found;
+    
+    state.itemsProcessed = state.iterations;
+}
+
+// Usage counter updates for a press and release of one of 'keys' keys
+void BM_UsageRecord(BenchState& state, int keys) {
+    UsageCounters usage;
+    
+    int64_t now = 1;
+    BeginSteadyState(state);
+    for (int64_t i = 0; i < state.iterations; ++i) {
+        int virtualKey = 'A' + static_cast<int>(i % keys);
+        usage.RecordPress(virtualKey, now);
+        now += 1000;
+        usage.RecordRelease(virtualKey, now);
+    }
+    EndSteadyState(state);
+    g_sink = g_sink + usage.GetMaxPresses();
+    
+    state.itemsProcessed = state.iterations;
+}
+
+// ---------------------------------------------------------------------------
+// Touch contact construction
+// ---------------------------------------------------------------------------
+
+void BM_ContactFrameBuild(BenchState& state, int contacts) {
+    POINTER_TOUCH_INFO frame[BENCH_MAX_CONTACTS];
+    
+    BeginSteadyState(state);
+    for (int64_t i = 0; i < state.iterations; ++i) {
+        for (int c = 0; c < contacts; ++c) {
+            int x = 100 + c * 40 + static_cast<int>(i & 7);
+            TouchInjector::BuildContact(frame[c], x, 500, c,
+                                        POINTER_FLAG_UPDATE | POINTER_FLAG_INRANGE | POINTER_FLAG_INCONTACT);
+        }
+        g_sink = g_sink + frame[contacts - 1].rcContact.left;
+    }
+    EndSteadyState(state);
+    
+    state.itemsProcessed = state.iterations * contacts;
+}
+
+// Prebuilt per-mapping contacts, as the application injects them: a copy
+// of the template plus the pointer ID and flags
+void BM_ContactFromTemplate(BenchState& state, int contacts) {
+    POINTER_TOUCH_INFO templates[BENCH_MAX_CONTACTS];
+    POINTER_TOUCH_INFO frame[BENCH_MAX_CONTACTS];
+    for (int c = 0; c < BENCH_MAX_CONTACTS; ++c) {
+        TouchInjector::BuildContactTemplate(templates[c], 100 + c * 40, 500, 8, 512, 90);
+    }
+    
+    BeginSteadyState(state);
+    for (int64_t i = 0; i < state.iterations; ++i) {
+        for (int c = 0; c < contacts; ++c) {
+            frame[c] = templates[c];
+            frame[c].pointerInfo.pointerId = c;
+            frame[c].pointerInfo.pointerFlags = POINTER_FLAG_UPDATE | POINTER_FLAG_INRANGE | POINTER_FLAG_INCONTACT |
+                                                (c == 0 ? POINTER_FLAG_PRIMARY : 0);
+        }
+        g_sink = g_sink + frame[contacts - 1].pointerInfo.pointerFlags + static_cast<int64_t>(i & 1);
+    }
+    EndSteadyState(state);
+    
+    state.itemsProcessed = state.iterations * contacts;
+}
+
+// ---------------------------------------------------------------------------
+// Hotkey / modifier dispatch
+// ---------------------------------------------------------------------------
+
+struct DispatchCounter {
+    int64_t downs;
+    int64_t ups;
+    
+    void OnKeyEvent(int virtualKey, bool isDown) {
+        if (isDown) {
+            ++downs;
+        } else {
+            ++ups;
+        }
+    }
+};
+
+// Hook filter, consume table and statically bound handler, as run for every
+// hooked key event. Streams include key repeats (auto-repeat key-downs) and
+// unfiltered keys; the mapped letters are consumed, the modifiers pass.
+void BM_HookDispatch(BenchState& state, int filteredKeys) {
+    KeyboardHook hook;
+    DispatchCounter counter = {0, 0};
+    hook.SetKeyHandler<DispatchCounter, &DispatchCounter::OnKeyEvent>(&counter);
+    
+    KeyBitset filter;
+    for (int vk = 'A'; vk < 'A' + filteredKeys && vk <= 'Z'; ++vk) {
+        filter.Set(vk);
+    }
+    hook.SetConsumeKeys(filter);
+    filter.Set(VK_LCONTROL);
+    filter.Set(VK_LSHIFT);
+    hook.SetKeyFilter(filter);
+    
+    // Ctrl+Shift+<letter> press, two auto-repeats, release
+    static const int stream[][2] = {
+        {VK_LCONTROL, 1}, {VK_LSHIFT, 1}, {'M', 1}, {'M', 1}, {'M', 1}, {'M', 0},
+        {'Q', 1}, {'Q', 0}, {'7', 1}, {'7', 0}, {VK_LSHIFT, 0}, {VK_LCONTROL, 0},
+    };
+    const int streamLength = sizeof(stream) / sizeof(stream[0]);
+    
+    int64_t consumed = 0;
+    BeginSteadyState(state);
+    for (int64_t i = 0; i < state.iterations; ++i) {
+        for (int e = 0; e < streamLength; ++e) {
+            // Same path as the hook callback: unwanted keys stop at the pass-through
+            if (!hook.PassThrough(stream[e][0], stream[e][1] != 0)) {
+                consumed += hook.Dispatch(stream[e][0], stream[e][1] != 0);
+            }
+        }
+    }
+    EndSteadyState(state);
+    g_sink = g_sink + counter.downs + counter.ups + consumed;
+    
+    state.itemsProcessed = state.iterations * streamLength;
+}
+
+// Chord lookup on a key press with modifiers held
+void BM_ChordMatch(BenchState& state, int chordCount) {
+    std::vector<KeyBitset> chords;
+    for (int i = 0; i < chordCount; ++i) {
+        KeyBitset chord;
+        chord.Set((i & 1) ? VK_CONTROL : VK_SHIFT);
+        chord.Set('0' + (i % 10));
+        if (i >= 10) {
+            chord.Set('A' + (i % 26));
+        }
+        chords.push_back(chord);
+    }
+    
+    ChordMatcher matcher;
+    matcher.Build(chords);
+    
+    KeyBitset pressed;
+    pressed.Set(VK_SHIFT);
+    pressed.Set('A');
+    
+    int64_t matched = 0;
+    BeginSteadyState(state);
+    for (int64_t i = 0; i < state.iterations; ++i) {
+        int key = '0' + static_cast<int>(i % 10);
+        pressed.Set(key);
+        matched += matcher.Match(pressed, key);
+        pressed.Clear(key);
+    }
+    EndSteadyState(state);
+    g_sink = g_sink + matched;
+    
+    state.itemsProcessed = state.iterations;
+}
+
+// ---------------------------------------------------------------------------
+// Overlay painting
+// ---------------------------------------------------------------------------
+
+void BM_OverlayRender(BenchState& state, int indicators) {
+    // Stand-in for the config's resolved table: the overlay only keeps a view
+    std::vector<KeyMapping> mappings(indicators);
+    const KeyMapping* table[256] = {};
+    for (int i = 0; i < indicators && i < 256; ++i) {
+        mappings[i].x = 60 + (i % 16) * 110;
+        mappings[i].y = 60 + (i / 16) * 110;
+        mappings[i].keyName = "Key" + std::to_string(i);
+        table[i] = &mappings[i];
+    }
+    
+    DisplayOverlay overlay;
+    overlay.SetMappings(table);
+    
+    // Render into an offscreen 32-bit DIB, like the paint handler's back buffer
+    BITMAPINFO info;
+    memset(&info, 0, sizeof(info));
+    info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    info.bmiHeader.biWidth = BENCH_SCREEN_WIDTH;
+    info.bmiHeader.biHeight = -BENCH_SCREEN_HEIGHT;
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+    
+    void* bits = nullptr;
+    HDC dc = CreateCompatibleDC(nullptr);
+    HBITMAP bitmap = CreateDIBSection(dc, &info, DIB_RGB_COLORS, &bits, nullptr, 0);
+    HBITMAP oldBitmap = (HBITMAP)SelectObject(dc, bitmap);
+    RECT rect = {0, 0, BENCH_SCREEN_WIDTH, BENCH_SCREEN_HEIGHT};
+    
+    BeginSteadyState(state);
+    for (int64_t i = 0; i < state.iterations; ++i) {
+        overlay.Render(dc, rect);
+    }
+    EndSteadyState(state);
+    GdiFlush();
+    
+    SelectObject(dc, oldBitmap);
+    DeleteObject(bitmap);
+    DeleteDC(dc);
+    
+    state.itemsProcessed = state.iterations;
+}
+
+// ---------------------------------------------------------------------------
+// Tracing
+// ---------------------------------------------------------------------------
+
+// One traced span, as put around each pipeline stage, with tracing off (0) or on (1)
+void BM_TraceSpan(BenchState& state, int enabled) {
+    Tracer::SetEnabled(enabled != 0);
+    
+    // Claim this thread's ring before measuring
+    Tracer::End(TRACE_HOOK_CALLBACK, Tracer::Begin(), 0);
+    
+    BeginSteadyState(state);
+    for (int64_t i = 0; i < state.iterations; ++i) {
+        int64_t begin = Tracer::Begin();
+        g_sink = g_sink + i;
+        Tracer::End(TRACE_HOOK_CALLBACK, begin, static_cast<int>(i & 0xFF));
+    }
+    EndSteadyState(state);
+    Tracer::SetEnabled(false);
+    
+    state.itemsProcessed = state.iterations;
+}
+
+// ---------------------------------------------------------------------------
+// Plugin actions
+// ---------------------------------------------------------------------------
+
+// Tap at the key's position while Shift is held, as a plugin would write it
+static int KMM_CALL BenchPluginAction(void* userData, const KmmKeyEvent* event,
+                                      const KmmKeyState* keys, KmmContactBuffer* out) {
+    if (((keys->pressed[VK_SHIFT >> 6] >> (VK_SHIFT & 63)) & 1) == 0 || out->count == out->capacity) {
+        return 0;
+    }
+    KmmContact& contact = out->contacts[out->count++];
+    contact.action = event->isDown ? KMM_CONTACT_DOWN : KMM_CONTACT_UP;
+    contact.touchId = event->virtualKey % BENCH_MAX_CONTACTS;
+    contact.x = event->x;
+    contact.y = event->y;
+    return 1;
+}
+
+// Host side of a plugin action per key event: event and key state views,
+// the timed handler call and the contacts it emitted, over 'actions' bound keys
+void BM_PluginDispatch(BenchState& state, int actions) {
+    PluginHost host;
+    const KmmHostApi* api = host.GetHostApi();
+    std::vector<ActionBinding> bindings;
+    for (int i = 0; i < actions; ++i) {
+        ActionBinding binding;
+        binding.virtualKey = 'A' + i;
+        binding.name = "bench" + std::to_string(i);
+        api->registerAction(api->context, binding.name.c_str(), BenchPluginAction, nullptr);
+        bindings.push_back(binding);
+    }
+    host.BindKeys(bindings);
+    
+    KeyBitset pressed;
+    KeyBitset touching;
+    pressed.Set(VK_SHIFT);
+    KmmContact contacts[BENCH_MAX_CONTACTS];
+    
+    int64_t emitted = 0;
+    BeginSteadyState(state);
+    for (int64_t i = 0; i < state.iterations; ++i) {
+        KmmKeyEvent event;
+        event.size = sizeof(event);
+        event.virtualKey = 'A' + static_cast<int>(i % actions);
+        event.isDown = static_cast<int32_t>(i & 1);
+        event.isRepeat = 0;
+        event.scanCode = 0;
+        event.extended = 0;
+        event.x = 100;
+        event.y = 200;
+        event.timeUs = i;
+        
+        KmmKeyState keys;
+        keys.size = sizeof(keys);
+        keys.pressed = pressed.words;
+        keys.touching = touching.words;
+        
+        KmmContactBuffer out;
+        out.contacts = contacts;
+        out.capacity = BENCH_MAX_CONTACTS;
+        out.count = 0;
+        host.Dispatch(event, keys, out);
+        emitted += out.count;
+    }
+    EndSteadyState(state);
+    g_sink = g_sink + emitted;
+    
+    state.itemsProcessed = state.iterations;
+}
+
+// ---------------------------------------------------------------------------
+// Event stream
+// ---------------------------------------------------------------------------
+
+// Writer cost per record with readers draining the ring every 64 records;
+// the last reader only drains every other ring length, so it is always lapped
+void BM_EventStream(BenchState& state, int readers) {
+    EventStream stream;
+    if (!stream.Create(nullptr)) {
+        return;
+    }
+    
+    std::vector<uint64_t> cursors(readers, 0);
+    uint64_t lost = 0;
+    EventRecord record;
+    
+    BeginSteadyState(state);
+    for (int64_t i = 0; i < state.iterations; ++i) {
+        stream.Write((i & 1) ? EVENT_TOUCH_UPDATE : EVENT_KEY_DOWN, static_cast<int>(i & 0xFF), 0,
+                     static_cast<int>(i & 1023), 500);
+        
+        if ((i & 63) == 63) {
+            for (int r = 0; r < readers; ++r) {
+                if (r == readers - 1 && readers > 1 && ((i / EVENT_STREAM_CAPACITY) & 1) == 0) {
+                    continue;
+                }
+                while (EventStream::ReadNext(stream.GetData(), cursors[r], record, lost)) {
+                    g_sink = g_sink + record.code;
+                }
+            }
+        }
+    }
+    EndSteadyState(state);
+    g_sink = g_sink + static_cast<int64_t>(lost);
+    
+    state.itemsProcessed = state.iterations;
+    state.bytesProcessed = state.iterations * static_cast<int64_t>(sizeof(EventRecord));
+}
+
+// ---------------------------------------------------------------------------
+// Key to touch
+// ---------------------------------------------------------------------------
+
+// Key events replayed through the application in mapping mode on a simulated
+// clock: Application::OnKeyEvent, chord and layer handling, binding and mapping
+// lookup, the touch injector's frame (sent to a discarding sink) and the
+// scheduled tap releases, for a press/repeat/release stream of mapped and
+// unmapped keys with the given number of layers active. Events are 1 ms apart.
+void BM_KeyToTouch(BenchState& state, int activeLayers) {
+    const int layers = 8;
+    std::string path = GeneratedConfigPath(layers);
+    WriteGeneratedConfig(path, layers);
+    
+    {
+        ScopedQuietOutput quiet;
+        SimulatedClock clock;
+        Application app(path, &clock);
+        if (!app.Initialize()) {
+            DeleteFileA(path.c_str());
+            return;
+        }
+        app.OnControlCommand("mode mapping");
+        for (int layer = 1; layer <= activeLayers && layer <= layers; ++layer) {
+            app.OnControlCommand("layer bench" + std::to_string(layer) + " on");
+        }
+        
+        static const int events[][2] = {
+            {'W', 1}, {'W', 1}, {'A', 1}, {'W', 0}, {'A', 0}, {VK_F5, 1}, {VK_F5, 0},
+            {VK_SPACE, 1}, {VK_SPACE, 0}, {'7', 1}, {'7', 1}, {'7', 0},
+        };
+        const int streamLength = sizeof(events) / sizeof(events[0]);
+        int64_t now = 0;
+        
+        // Warm-up: first use of every path may set things up lazily
+        for (int e = 0; e < streamLength; ++e) {
+            now += 1000;
+            app.RunUntil(now);
+            app.ReplayKeyEvent(events[e][0], events[e][1] != 0);
+        }
+        uint64_t contactsAtStart = app.GetTouchInjector().GetContactCount();
+        
+        BeginSteadyState(state);
+        for (int64_t i = 0; i < state.iterations; ++i) {
+            for (int e = 0; e < streamLength; ++e) {
+                now += 1000;
+                app.RunUntil(now);
+                app.ReplayKeyEvent(events[e][0], events[e][1] != 0);
+            }
+        }
+        EndSteadyState(state);
+        g_sink = g_sink + static_cast<int64_t>(app.GetTouchInjector().GetContactCount() - contactsAtStart);
+        
+        state.itemsProcessed = state.iterations * streamLength;
+    }
+    
+    DeleteFileA(path.c_str());
+}
+
+// ---------------------------------------------------------------------------
+// Simulated time
+// ---------------------------------------------------------------------------
+
+// Write a config with keys '0'-'9' mapped and tapping at 20 Hz (50% duty)
+void WriteTurboConfig(const std::string& path) {
+    std::ofstream file(path, std::ios::trunc);
+    file << "# Generated by kmm_microbench\n";
+    file << "control_ipc=0\n";
+    for (int vk = '0'; vk <= '9'; ++vk) {
+        file << vk << " " << (100 + (vk - '0') * 50) << " 300 Turbo" << (vk - '0') << "\n";
+        file << "turbo=" << vk << " 20 50\n";
+    }
+}
+
+// Turbo keys held in mapping mode, replayed through the application on a
+// simulated clock: every edge is Application::OnTurboTask on the scheduler,
+// with the keepalive and hook watchdog running beside it. One simulated
+// second per iteration (items are contact changes sent).
+void BM_SimulatedTurbo(BenchState& state, int keys) {
+    std::string path = TempConfigPath("turbo");
+    WriteTurboConfig(path);
+    
+    {
+        ScopedQuietOutput quiet;
+        SimulatedClock clock;
+        Application app(path, &clock);
+        if (!app.Initialize()) {
+            DeleteFileA(path.c_str());
+            return;
+        }
+        app.OnControlCommand("mode mapping");
+        
+        // Presses 1 ms apart, so the keys tap out of phase
+        for (int key = 0; key < keys; ++key) {
+            app.RunUntil(key * 1000);
+            app.ReplayKeyEvent('0' + key, true);
+        }
+        uint64_t contactsAtStart = app.GetTouchInjector().GetContactCount();
+        
+        BeginSteadyState(state);
+        for (int64_t i = 0; i < state.iterations; ++i) {
+            app.RunUntil((i + 1) * 1000000);
+        }
+        EndSteadyState(state);
+        
+        state.itemsProcessed = static_cast<int64_t>(app.GetTouchInjector().GetContactCount() - contactsAtStart);
+        g_sink = g_sink + state.itemsProcessed;
+    }
+    
+    DeleteFileA(path.c_str());
+}
+
+// ---------------------------------------------------------------------------
+// Replay checks
+// ---------------------------------------------------------------------------
+
+// Key sequences replayed through the application on a simulated clock, with a
+// pass/fail verdict instead of a timing (run by --check_replays)
+typedef bool (*ReplayCheckProc)();
+
+struct ReplayCheck {
+    const char* name;
+    ReplayCheckProc proc;
+};
+
+// Simulated time past a few hook watchdog runs (it checks every 250 ms)
+#define REPLAY_WATCHDOG_SPAN_US 1000000
+
+// Write a replay config (the control pipe stays closed) and return its path
+std::string WriteReplayConfig(const std::string& name, const std::string& lines) {
+    std::string path = TempConfigPath("replay_" + name);
+    std::ofstream file(path, std::ios::trunc);
+    file << "# Generated by kmm_microbench\n";
+    file << "control_ipc=0\n";
+    file << lines;
+    return path;
+}
+
+// Contacts currently down
+int CountActiveTouches(const TouchInjector& touches) {
+    int count = 0;
+    for (int touchId = 0; touchId < BENCH_MAX_CONTACTS; ++touchId) {
+        if (touches.IsTouchActive(touchId)) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+// Press Ctrl+Shift plus a key (a control hotkey)
+void ReplayHotkey(Application& app, int virtualKey) {
+    app.ReplayKeyEvent(VK_LCONTROL, true);
+    app.ReplayKeyEvent(VK_LSHIFT, true);
+    app.ReplayKeyEvent(virtualKey, true);
+    app.ReplayKeyEvent(virtualKey, false);
+    app.ReplayKeyEvent(VK_LSHIFT, false);
+    app.ReplayKeyEvent(VK_LCONTROL, false);
+}
+
+// A swallowed key never shows as held to the system, so the watchdog must
+// not take it for a key whose key-up was lost
+bool CheckConsumedKeyHeldAcrossWatchdog() {
+    std::string path = WriteReplayConfig("consumed", "87 400 300 W\n");
+    bool ok = false;
+    {
+        ScopedQuietOutput quiet;
+        SimulatedClock clock;
+        Application app(path, &clock);
+        if (app.Initialize()) {
+            app.OnControlCommand("mode mapping");
+            bool consumed = app.ReplayKeyEvent('W', true);
+            app.RunUntil(REPLAY_WATCHDOG_SPAN_US);
+            
+            const HookHealth& health = app.GetKeyboardHook().GetHealth();
+            ok = consumed && CountActiveTouches(app.GetTouchInjector()) == 1 &&
+                 health.orphanedKeys == 0 && health.reinstalls == 0;
+            
+            app.ReplayKeyEvent('W', false);
+            ok = ok && CountActiveTouches(app.GetTouchInjector()) == 0;
+        }
+    }
+    DeleteFileA(path.c_str());
+    return ok;
+}
+
+// A modifier binding fires from the hook's left/right modifier codes: the
+// modifier must reach the application for the binding to see it held
+bool CheckModifierBindingFires() {
+    std::string path = WriteReplayConfig("binding", "bind=Ctrl+87 400 300 CtrlW\n");
+    bool ok = false;
+    {
+        ScopedQuietOutput quiet;
+        SimulatedClock clock;
+        Application app(path, &clock);
+        if (app.Initialize()) {
+            app.OnControlCommand("mode mapping");
+            app.ReplayKeyEvent(VK_LCONTROL, true);
+            bool consumed = app.ReplayKeyEvent('W', true);
+            ok = consumed && CountActiveTouches(app.GetTouchInjector()) == 1;
+            
+            consumed = app.ReplayKeyEvent('W', false);
+            app.ReplayKeyEvent(VK_LCONTROL, false);
+            ok = ok && consumed && CountActiveTouches(app.GetTouchInjector()) == 0;
+        }
+    }
+    DeleteFileA(path.c_str());
+    return ok;
+}
+
+// A key that is only bound with modifiers is typed normally without them
+bool CheckUnmodifiedBoundKeyPasses() {
+    std::string path = WriteReplayConfig("unmodified", "bind=Ctrl+87 400 300 CtrlW\n");
+    bool ok = false;
+    {
+        ScopedQuietOutput quiet;
+        SimulatedClock clock;
+        Application app(path, &clock);
+        if (app.Initialize()) {
+            app.OnControlCommand("mode mapping");
+            bool consumed = app.ReplayKeyEvent('W', true);
+            consumed = app.ReplayKeyEvent('W', true) || consumed;
+            ok = !consumed && CountActiveTouches(app.GetTouchInjector()) == 0;
+            
+            consumed = app.ReplayKeyEvent('W', false);
+            ok = ok && !consumed;
+        }
+    }
+    DeleteFileA(path.c_str());
+    return ok;
+}
+
+// Options a profile leaves out must not keep the previous profile's values:
+// switching to a profile gives the same options as starting with it
+bool CheckProfileSwitchResetsOptions() {
+    std::string pathA = WriteReplayConfig("profile_a",
+        "hold_triggers_continuous_tap=1\n"
+        "chord_resolve_window_ms=80\n"
+        "continuous_tap_turbo=30 20\n"
+        "frame_pacing_lead_us=2000\n"
+        "gamepad=1\n"
+        "control_ipc=1\n"
+        "event_stream=1\n"
+        "consume_mapped_keys=0\n"
+        "trace=1\n"
+        "log_touches=1\n"
+        "87 400 300 W\n");
+    std::string pathB = TempConfigPath("replay_profile_b");
+    {
+        std::ofstream file(pathB, std::ios::trunc);
+        file << "87 400 300 W\n";
+    }
+    
+    bool ok = false;
+    {
+        ScopedQuietOutput quiet;
+        SimulatedClock clock;
+        Application app(pathA, &clock);
+        if (app.Initialize()) {
+            app.OnControlCommand("mode mapping");
+            bool consumedInA = app.ReplayKeyEvent('W', true);
+            app.ReplayKeyEvent('W', false);
+            
+            ok = !consumedInA && app.OnControlCommand("profile " + pathB) == "OK";
+            const ConfigManager& config = app.GetConfig();
+            ConfigManager fresh(pathB);
+            ok = ok &&
+                 config.GetHoldTriggersContinuousTap() == fresh.GetHoldTriggersContinuousTap() &&
+                 config.GetChordResolveWindowMs() == fresh.GetChordResolveWindowMs() &&
+                 config.GetDefaultTurboRateHz() == fresh.GetDefaultTurboRateHz() &&
+                 config.GetDefaultTurboDutyPercent() == fresh.GetDefaultTurboDutyPercent() &&
+                 config.GetFramePacingLeadUs() == fresh.GetFramePacingLeadUs() &&
+                 config.IsGamepadEnabled() == fresh.IsGamepadEnabled() &&
+                 config.IsControlIpcEnabled() == fresh.IsControlIpcEnabled() &&
+                 config.IsEventStreamEnabled() == fresh.IsEventStreamEnabled() &&
+                 config.IsConsumeMappedKeysEnabled() == fresh.IsConsumeMappedKeysEnabled() &&
+                 config.IsUsageStatsEnabled() == fresh.IsUsageStatsEnabled() &&
+                 config.IsTraceEnabled() == fresh.IsTraceEnabled() &&
+                 config.IsTouchLogEnabled() == fresh.IsTouchLogEnabled() &&
+                 !Tracer::IsEnabled();
+            
+            // Mapped keys are swallowed again under the default consume_mapped_keys=1
+            bool consumedInB = app.ReplayKeyEvent('W', true);
+            app.ReplayKeyEvent('W', false);
+            ok = ok && consumedInB;
+        }
+    }
+    DeleteFileA(pathA.c_str());
+    DeleteFileA(pathB.c_str());
+    return ok;
+}
+
+// Leaving mapping mode lifts the touches of held keys and chords; their
+// key-ups arrive outside mapping mode and cannot lift them any more
+bool CheckModeSwitchReleasesTouches() {
+    std::string path = WriteReplayConfig("mode", "87 400 300 W\nchord=16+49 300 300 Shift1\n");
+    bool ok = false;
+    {
+        ScopedQuietOutput quiet;
+        SimulatedClock clock;
+        Application app(path, &clock);
+        if (app.Initialize()) {
+            const TouchInjector& touches = app.GetTouchInjector();
+            app.OnControlCommand("mode mapping");
+            app.ReplayKeyEvent('W', true);
+            app.ReplayKeyEvent(VK_LSHIFT, true);
+            app.ReplayKeyEvent('1', true);
+            ok = CountActiveTouches(touches) == 2;
+            
+            app.OnControlCommand("mode idle");
+            ok = ok && CountActiveTouches(touches) == 0;
+            
+            app.ReplayKeyEvent('W', false);
+            app.ReplayKeyEvent('1', false);
+            app.ReplayKeyEvent(VK_LSHIFT, false);
+            app.OnControlCommand("mode mapping");
+            ok = ok && CountActiveTouches(touches) == 0;
+        }
+    }
+    DeleteFileA(path.c_str());
+    return ok;
+}
+
+// Control hotkeys read the replayed modifiers, not the keyboard of the
+// machine running the replay: I alone does nothing, Ctrl+Shift+I goes idle
+bool CheckHotkeyUsesReplayedModifiers() {
+    std::string path = WriteReplayConfig("hotkey", "87 400 300 W\n");
+    bool ok = false;
+    {
+        ScopedQuietOutput quiet;
+        SimulatedClock clock;
+        Application app(path, &clock);
+        if (app.Initialize()) {
+            const TouchInjector& touches = app.GetTouchInjector();
+            app.OnControlCommand("mode mapping");
+            app.ReplayKeyEvent('I', true);
+            app.ReplayKeyEvent('I', false);
+            app.ReplayKeyEvent('W', true);
+            ok = CountActiveTouches(touches) == 1;
+            app.ReplayKeyEvent('W', false);
+            
+            ReplayHotkey(app, 'I');
+            bool consumed = app.ReplayKeyEvent('W', true);
+            ok = ok && !consumed && CountActiveTouches(touches) == 0;
+            app.ReplayKeyEvent('W', false);
+        }
+    }
+    DeleteFileA(path.c_str());
+    return ok;
+}
+
+// Key contacts never take the mouse look contact's ID: 'A' (VK % 10 = 5, the
+// mouse look ID) held while dragging gives two independent contacts
+bool CheckMouseLookKeepsOwnTouch() {
+    std::string path = WriteReplayConfig("mouselook", "65 400 300 A\nmouselook=800 200 1200 600 100\n");
+    bool ok = false;
+    {
+        ScopedQuietOutput quiet;
+        SimulatedClock clock;
+        Application app(path, &clock);
+        if (app.Initialize()) {
+            const TouchInjector& touches = app.GetTouchInjector();
+            app.OnControlCommand("mode mapping");
+            ReplayHotkey(app, 'L');
+            app.ReplayMouseMotion(10, 0);
+            app.RunUntil(10000);
+            ok = CountActiveTouches(touches) == 1;
+            
+            app.ReplayKeyEvent('A', true);
+            ok = ok && CountActiveTouches(touches) == 2;
+            app.ReplayMouseMotion(10, 0);
+            app.RunUntil(20000);
+            ok = ok && CountActiveTouches(touches) == 2;
+            
+            // Releasing the key lifts its contact only
+            app.ReplayKeyEvent('A', false);
+            ok = ok && CountActiveTouches(touches) == 1;
+            
+            ReplayHotkey(app, 'L');
+            ok = ok && CountActiveTouches(touches) == 0;
+        }
+    }
+    DeleteFileA(path.c_str());
+    return ok;
+}
+
+// Key contacts never take a configured stick's ID: 'D' (VK % 10 = 8, the
+// right stick's ID) held while the stick is pushed gives two contacts
+bool CheckStickKeepsOwnTouch() {
+    std::string path = WriteReplayConfig("stick", "68 400 300 D\nstick=right 1000 500 100\n");
+    bool ok = false;
+    {
+        ScopedQuietOutput quiet;
+        SimulatedClock clock;
+        Application app(path, &clock);
+        if (app.Initialize()) {
+            const TouchInjector& touches = app.GetTouchInjector();
+            app.OnControlCommand("mode mapping");
+            app.ReplayGamepadAxis(GAMEPAD_RIGHT_STICK, 0.5f, 0.0f);
+            app.ReplayKeyEvent('D', true);
+            ok = CountActiveTouches(touches) == 2;
+            
+            app.ReplayKeyEvent('D', false);
+            ok = ok && CountActiveTouches(touches) == 1;
+            app.ReplayGamepadAxis(GAMEPAD_RIGHT_STICK, 0.0f, 0.0f);
+            ok = ok && CountActiveTouches(touches) == 0;
+        }
+    }
+    DeleteFileA(path.c_str());
+    return ok;
+}
+
+// '1' pressed just before Shift resolves into the Shift+1 chord: one contact
+// change (the chord's down), not a '1' touch lifted again for the chord.
+// '1' alone still fires once the resolve window has passed.
+bool CheckChordResolveWindow() {
+    std::string path = WriteReplayConfig("chord",
+        "chord_resolve_window_ms=30\n"
+        "49 400 300 1\n"
+        "chord=16+49 300 300 Shift1\n");
+    bool ok = false;
+    {
+        ScopedQuietOutput quiet;
+        SimulatedClock clock;
+        Application app(path, &clock);
+        if (app.Initialize()) {
+            const TouchInjector& touches = app.GetTouchInjector();
+            app.OnControlCommand("mode mapping");
+            uint64_t contacts = touches.GetContactCount();
+            bool consumed = app.ReplayKeyEvent('1', true);
+            ok = consumed && CountActiveTouches(touches) == 0;
+            
+            app.RunUntil(10000);
+            app.ReplayKeyEvent(VK_LSHIFT, true);
+            ok = ok && CountActiveTouches(touches) == 1 && touches.GetContactCount() == contacts + 1;
+            
+            // Past the window: the resolved '1' does not fire on its own
+            app.RunUntil(100000);
+            app.ReplayKeyEvent('1', false);
+            app.ReplayKeyEvent(VK_LSHIFT, false);
+            app.RunUntil(200000);
+            ok = ok && CountActiveTouches(touches) == 0 && touches.GetContactCount() == contacts + 2;
+            
+            app.ReplayKeyEvent('1', true);
+            ok = ok && CountActiveTouches(touches) == 0;
+            app.RunUntil(300000);
+            ok = ok && CountActiveTouches(touches) == 1;
+            app.ReplayKeyEvent('1', false);
+            ok = ok && CountActiveTouches(touches) == 0;
+        }
+    }
+    DeleteFileA(path.c_str());
+    return ok;
+}
+
+// Layer keys turn layers on and off: a hold layer (Caps Lock) maps 'B' only
+// while held, a toggle layer ('G') maps 'N' from one press to the next. A key
+// held across the layer switching off keeps its touch until its own key-up.
+bool CheckLayersResolve() {
+    std::string path = WriteReplayConfig("layers",
+        "65 400 300 A\n"
+        "[layer hold_layer hold 20]\n"
+        "66 500 300 B\n"
+        "[layer toggle_layer toggle 71]\n"
+        "78 600 300 N\n");
+    bool ok = false;
+    {
+        ScopedQuietOutput quiet;
+        SimulatedClock clock;
+        Application app(path, &clock);
+        if (app.Initialize()) {
+            const TouchInjector& touches = app.GetTouchInjector();
+            const ConfigManager& config = app.GetConfig();
+            app.OnControlCommand("mode mapping");
+            ok = config.GetLayerCount() == 3;
+            
+            // Hold layer: 'B' resolves only while Caps Lock is down; 'A' falls through
+            app.ReplayKeyEvent('B', true);
+            app.ReplayKeyEvent('B', false);
+            ok = ok && CountActiveTouches(touches) == 0;
+            app.ReplayKeyEvent(VK_CAPITAL, true);
+            app.ReplayKeyEvent(VK_CAPITAL, true);  // Auto-repeat changes nothing
+            ok = ok && config.IsLayerActive(1);
+            app.ReplayKeyEvent('A', true);
+            app.ReplayKeyEvent('B', true);
+            ok = ok && CountActiveTouches(touches) == 2;
+            app.ReplayKeyEvent('A', false);
+            app.ReplayKeyEvent(VK_CAPITAL, false);
+            ok = ok && !config.IsLayerActive(1) && CountActiveTouches(touches) == 1;
+            app.ReplayKeyEvent('B', false);
+            ok = ok && CountActiveTouches(touches) == 0;
+            app.ReplayKeyEvent('B', true);
+            ok = ok && CountActiveTouches(touches) == 0;
+            app.ReplayKeyEvent('B', false);
+            
+            // Toggle layer: on at the first press of 'G', off at the second
+            app.ReplayKeyEvent('G', true);
+            app.ReplayKeyEvent('G', false);
+            ok = ok && config.IsLayerActive(2);
+            app.ReplayKeyEvent('N', true);
+            ok = ok && CountActiveTouches(touches) == 1;
+            app.ReplayKeyEvent('N', false);
+            app.ReplayKeyEvent('G', true);
+            app.ReplayKeyEvent('G', false);
+            ok = ok && !config.IsLayerActive(2);
+            app.ReplayKeyEvent('N', true);
+            ok = ok && CountActiveTouches(touches) == 0;
+            app.ReplayKeyEvent('N', false);
+        }
+    }
+    DeleteFileA(path.c_str());
+    return ok;
+}
+
+// Turbo edges sit on an absolute grid: holding a 20 Hz, 50% duty key for a
+// second gives 39 edges after the first down, each found within 1 ms of its
+// slot (time advances in 100 us steps, so a drifting or late edge shows up)
+bool CheckTurboEdgesOnPeriod() {
+    std::string path = WriteReplayConfig("turbo", "53 400 300 Five\nturbo=53 20 50\n");
+    bool ok = false;
+    {
+        ScopedQuietOutput quiet;
+        SimulatedClock clock;
+        Application app(path, &clock);
+        if (app.Initialize()) {
+            const TouchInjector& touches = app.GetTouchInjector();
+            app.OnControlCommand("mode mapping");
+            const int64_t startUs = 1000;
+            const int64_t halfPeriodUs = 25000;
+            app.RunUntil(startUs);
+            app.ReplayKeyEvent('5', true);
+            
+            bool touching = CountActiveTouches(touches) == 1;
+            ok = touching;
+            int edges = 0;
+            for (int64_t now = startUs + 100; now <= startUs + 1000000 - 100; now += 100) {
+                app.RunUntil(now);
+                bool down = CountActiveTouches(touches) == 1;
+                if (down == touching) {
+                    continue;
+                }
+                // Edge k (after the first down) belongs at startUs + k * halfPeriodUs
+                touching = down;
+                ++edges;
+                int64_t lateness = now - (startUs + edges * halfPeriodUs);
+                ok = ok && down == (edges % 2 == 0) && lateness >= 0 && lateness < 1000;
+            }
+            ok = ok && edges == 39;
+            
+            app.ReplayKeyEvent('5', false);
+            ok = ok && CountActiveTouches(touches) == 0;
+        }
+    }
+    DeleteFileA(path.c_str());
+    return ok;
+}
+
+// With frame pacing, touch changes wait for the next flush point (lead before
+// a refresh) and go out there together: a key-down mid-frame is flushed
+// exactly at that point, and two key-downs in one frame share one flush
+bool CheckFramePacingOnBoundaries() {
+    std::string path = WriteReplayConfig("pacing", "frame_pacing_lead_us=2000\n87 400 300 W\n65 500 300 A\n");
+    bool ok = false;
+    {
+        ScopedQuietOutput quiet;
+        SimulatedClock clock;
+        Application app(path, &clock);
+        if (app.Initialize() && app.GetFramePacer() != nullptr) {
+            const TouchInjector& touches = app.GetTouchInjector();
+            const FramePacer& pacer = *app.GetFramePacer();
+            app.OnControlCommand("mode mapping");
+            
+            // Flush points lie lead before each refresh of the grid starting at 0
+            const int64_t periodUs = pacer.GetRefreshPeriodUs();
+            const int64_t flushUs = periodUs - pacer.GetLeadUs();
+            uint64_t flushes = pacer.GetFlushCount();
+            
+            app.RunUntil(3000);
+            app.ReplayKeyEvent('W', true);
+            app.RunUntil(flushUs - 1);
+            ok = touches.HasPendingFrames() && pacer.GetFlushCount() == flushes;
+            app.RunUntil(flushUs);
+            ok = ok && !touches.HasPendingFrames() && pacer.GetFlushCount() == flushes + 1;
+            
+            app.RunUntil(flushUs + periodUs + 500);
+            app.ReplayKeyEvent('A', true);
+            app.RunUntil(flushUs + periodUs + 1500);
+            app.ReplayKeyEvent('W', false);
+            app.RunUntil(flushUs + 2 * periodUs - 1);
+            ok = ok && touches.HasPendingFrames() && pacer.GetFlushCount() == flushes + 1;
+            app.RunUntil(flushUs + 2 * periodUs);
+            ok = ok && !touches.HasPendingFrames() && pacer.GetFlushCount() == flushes + 2 &&
+                 CountActiveTouches(touches) == 1;
+            
+            app.ReplayKeyEvent('A', false);
+            app.RunUntil(flushUs + 3 * periodUs);
+            ok = ok && pacer.GetFlushCount() == flushes + 3 &&
+                 pacer.GetMaxPhaseErrorUs() == 0 && pacer.GetLateFlushCount() == 0;
+        }
+    }
+    DeleteFileA(path.c_str());
+    return ok;
+}
+
+// Write count records numbered on from written (in x)
+void WriteNumberedEvents(EventStream& stream, int& written, int count) {
+    for (int i = 0; i < count; ++i) {
+        ++written;
+        stream.Write(EVENT_KEY_DOWN, written & 0xFF, 0, written, 0);
+    }
+}
+
+// Read every record a reader can still get from the stream; returns how many
+// were read, or -1 if one was not the record that follows the previous one
+int DrainEventStream(const EventStream& stream, uint64_t& cursor, uint64_t& lost) {
+    EventRecord record;
+    int count = 0;
+    int32_t previous = 0;
+    while (EventStream::ReadNext(stream.GetData(), cursor, record, lost)) {
+        if (count > 0 && record.x != previous + 1) {
+            return -1;
+        }
+        previous = record.x;
+        ++count;
+    }
+    return count;
+}
+
+// A reader lapped by the writer loses exactly the records that were
+// overwritten before it read them, and gets the rest in order; one that is
+// exactly a ring length behind loses nothing
+bool CheckEventStreamLostCount() {
+    EventStream stream;
+    SimulatedClock clock;
+    if (!stream.Create(nullptr)) {
+        return false;
+    }
+    stream.SetClock(&clock);
+    
+    int written = 0;
+    uint64_t cursor = 0;
+    uint64_t lost = 0;
+    WriteNumberedEvents(stream, written, 100);
+    bool ok = DrainEventStream(stream, cursor, lost) == 100 && lost == 0;
+    
+    // A full ring behind: nothing is overwritten yet
+    WriteNumberedEvents(stream, written, EVENT_STREAM_CAPACITY);
+    ok = ok && DrainEventStream(stream, cursor, lost) == EVENT_STREAM_CAPACITY && lost == 0;
+    
+    // 37 records past a full ring: the 37 oldest unread ones are gone
+    WriteNumberedEvents(stream, written, EVENT_STREAM_CAPACITY + 37);
+    EventRecord record;
+    ok = ok && EventStream::ReadNext(stream.GetData(), cursor, record, lost) && lost == 37 &&
+         record.x == written - EVENT_STREAM_CAPACITY + 1;
+    ok = ok && DrainEventStream(stream, cursor, lost) == EVENT_STREAM_CAPACITY - 1 && lost == 37;
+    
+    // A new reader starts at the oldest record and has lost nothing
+    uint64_t newCursor = 0;
+    uint64_t newLost = 0;
+    ok = ok && DrainEventStream(stream, newCursor, newLost) == EVENT_STREAM_CAPACITY && newLost == 0;
+    
+    stream.Close();
+    return ok;
+}
+
+// Check that a grid query returns exactly the expected ids (in any order)
+bool QueryMatches(const SpatialGrid& grid, int x, int y, std::initializer_list<int> expected) {
+    int count = 0;
+    const int* items = grid.Query(x, y, count);
+    if (count != static_cast<int>(expected.size())) {
+        return false;
+    }
+    std::vector<int> found(items, items + count);
+    std::vector<int> wanted(expected);
+    std::sort(found.begin(), found.end());
+    std::sort(wanted.begin(), wanted.end());
+    return found == wanted;
+}
+
+// Grid queries on both sides of cell edges: items are listed in exactly the
+// cells their (right/bottom exclusive) bounds overlap, parts outside the
+// covered area are dropped, and points outside it find nothing
+bool CheckSpatialGridCellEdges() {
+    SpatialGrid grid;
+    grid.Reset(1000, 600, 100);
+    const RECT bounds[] = {
+        {0, 0, 100, 100},      // 1: exactly cell (0,0)
+        {100, 0, 200, 100},    // 2: exactly cell (1,0)
+        {50, 50, 150, 150},    // 3: four cells around the (100,100) corner
+        {195, 95, 205, 105},   // 4: four cells around the (200,100) corner
+        {-50, 550, 20, 650},   // 5: clipped to cell (0,5)
+        {1200, 0, 1300, 100},  // 6: outside the area
+    };
+    const int ids[] = {1, 2, 3, 4, 5, 6};
+    grid.Build(bounds, ids, 6);
+    
+    int count = -1;
+    grid.Query(1000, 0, count);
+    bool outside = count == 0;
+    grid.Query(-1, 0, count);
+    outside = outside && count == 0;
+    grid.Query(0, 600, count);
+    outside = outside && count == 0;
+    
+    return outside &&
+           QueryMatches(grid, 0, 0, {1, 3}) &&
+           QueryMatches(grid, 99, 99, {1, 3}) &&
+           QueryMatches(grid, 100, 99, {2, 3, 4}) &&
+           QueryMatches(grid, 99, 100, {3}) &&
+           QueryMatches(grid, 100, 100, {3, 4}) &&
+           QueryMatches(grid, 199, 0, {2, 3, 4}) &&
+           QueryMatches(grid, 200, 0, {4}) &&
+           QueryMatches(grid, 200, 100, {4}) &&
+           QueryMatches(grid, 250, 250, {}) &&
+           QueryMatches(grid, 0, 599, {5}) &&
+           QueryMatches(grid, 999, 599, {});
+}
+
+// Check that a key's contact is prebuilt at a screen position
+bool MappingPlacedAt(const ConfigManager& config, int virtualKey, int x, int y) {
+    const KeyMapping* mapping = config.GetMapping(virtualKey);
+    return mapping != nullptr && mapping->screenX == x && mapping->screenY == y &&
+           mapping->contact.pointerInfo.ptPixelLocation.x == x &&
+           mapping->contact.pointerInfo.ptPixelLocation.y == y;
+}
+
+// Positions anchored to a target window follow its client area: moved with
+// it, scaled with a resize, and left in place when it closes. A key held
+// across a move keeps its touch until its key-up.
+bool CheckTargetWindowFollowsMove() {
+    std::string path = WriteReplayConfig("window", "target_window=600 300 Game\n87 200 100 W\n");
+    bool ok = false;
+    {
+        ScopedQuietOutput quiet;
+        SimulatedClock clock;
+        Application app(path, &clock);
+        if (app.Initialize()) {
+            const ConfigManager& config = app.GetConfig();
+            const TouchInjector& touches = app.GetTouchInjector();
+            app.OnControlCommand("mode mapping");
+            ok = MappingPlacedAt(config, 'W', 200, 100);
+            
+            RECT client = {100, 50, 700, 350};
+            app.ReplayWindowPlacement(client);
+            ok = ok && MappingPlacedAt(config, 'W', 300, 150);
+            
+            app.ReplayKeyEvent('W', true);
+            RECT moved = {300, 200, 900, 500};
+            app.ReplayWindowPlacement(moved);
+            ok = ok && MappingPlacedAt(config, 'W', 500, 300) && CountActiveTouches(touches) == 1;
+            app.ReplayKeyEvent('W', false);
+            ok = ok && CountActiveTouches(touches) == 0;
+            
+            RECT resized = {0, 0, 1200, 600};
+            app.ReplayWindowPlacement(resized);
+            ok = ok && MappingPlacedAt(config, 'W', 400, 200);
+            
+            RECT closed = {0, 0, 0, 0};
+            app.ReplayWindowPlacement(closed);
+            ok = ok && MappingPlacedAt(config, 'W', 400, 200);
+        }
+    }
+    DeleteFileA(path.c_str());
+    return ok;
+}
+
+const ReplayCheck g_replayChecks[] = {
+    {"ConsumedKeyHeldAcrossWatchdog", CheckConsumedKeyHeldAcrossWatchdog},
+    {"ModifierBindingFires", CheckModifierBindingFires},
+    {"UnmodifiedBoundKeyPasses", CheckUnmodifiedBoundKeyPasses},
+    {"ProfileSwitchResetsOptions", CheckProfileSwitchResetsOptions},
+    {"ModeSwitchReleasesTouches", CheckModeSwitchReleasesTouches},
+    {"HotkeyUsesReplayedModifiers", CheckHotkeyUsesReplayedModifiers},
+    {"MouseLookKeepsOwnTouch", CheckMouseLookKeepsOwnTouch},
+    {"StickKeepsOwnTouch", CheckStickKeepsOwnTouch},
+    {"ChordResolveWindow", CheckChordResolveWindow},
+    {"LayersResolve", CheckLayersResolve},
+    {"TurboEdgesOnPeriod", CheckTurboEdgesOnPeriod},
+    {"FramePacingOnBoundaries", CheckFramePacingOnBoundaries},
+    {"EventStreamLostCount", CheckEventStreamLostCount},
+    {"SpatialGridCellEdges", CheckSpatialGridCellEdges},
+    {"TargetWindowFollowsMove", CheckTargetWindowFollowsMove},
+};
+
+// Run every replay check; returns the number that failed
+int CheckReplays() {
+    int failures = 0;
+    for (const ReplayCheck& check : g_replayChecks) {
+        if (check.proc()) {
+            fprintf(stderr, "%-32s ok\n", check.name);
+        } else {
+            fprintf(stderr, "%-32s FAILED\n", check.name);
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+// ---------------------------------------------------------------------------
+
+std::string JsonEscape(const std::string& value) {
+    std::string out;
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+void WriteJson(std::ostream& out, const std::vector<BenchResult>& results) {
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    
+    out << "{\n";
+    out << "  \"context\": {\n";
+    out << "    \"executable\": \"kmm_microbench\",\n";
+    out << "    \"num_cpus\": " << systemInfo.dwNumberOfProcessors << ",\n";
+#ifdef NDEBUG
+    out << "    \"library_build_type\": \"release\"\n";
+#else
+    out << "    \"library_build_type\": \"debug\"\n";
+#endif
+    out << "  },\n";
+    out << "  \"benchmarks\": [\n";
+    
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        out << "    {\n";
+        out << "      \"name\": \"" << JsonEscape(r.name) << "\",\n";
+        out << "      \"run_type\": \"iteration\",\n";
+        out << "      \"iterations\": " << r.iterations << ",\n";
+        out << "      \"real_time\": " << r.nsPerIteration << ",\n";
+        out << "      \"cpu_time\": " << r.cpuNsPerIteration << ",\n";
+        out << "      \"time_unit\": \"ns\"";
+        if (r.bytesPerSecond > 0.0) {
+            out << ",\n      \"bytes_per_second\": " << r.bytesPerSecond;
+        }
+        if (r.itemsPerSecond > 0.0) {
+            out << ",\n      \"items_per_second\": " << r.itemsPerSecond;
+        }
+        if (r.allocsPerIteration >= 0.0) {
+            out << ",\n      \"allocs_per_iteration\": " << r.allocsPerIteration;
+        }
+        out << "\n    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    
+    out << "  ]\n";
+    out << "}\n";
+}
+
+void Register(std::vector<BenchDef>& defs, const char* name, BenchProc proc, std::initializer_list<int> args,
+              bool noAlloc = false) {
+    for (int arg : args) {
+        BenchDef def;
+        def.name = std::string(name) + "/" + std::to_string(arg);
+        def.proc = proc;
+        def.arg = arg;
+        def.noAlloc = noAlloc;
+        defs.push_back(def);
+    }
+}
+
+// Run each allocation-free benchmark briefly; returns the number that allocated
+int CheckAllocations(const std::vector<BenchDef>& defs) {
+    int failures = 0;
+    for (const auto& def : defs) {
+        if (!def.noAlloc) {
+            continue;
+        }
+        BenchState state = {CHECK_ALLOCS_ITERATIONS, 0, 0, -1, -1};
+        def.proc(state, def.arg);
+        if (state.allocations != 0) {
+            fprintf(stderr, "%-28s FAILED: %lld allocations in steady state\n",
+                    def.name.c_str(), (long long)state.allocations);
+            ++failures;
+        } else {
+            fprintf(stderr, "%-28s ok\n", def.name.c_str());
+        }
+    }
+    return failures;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string filter;
+    std::string outFile;
+    double minTime = DEFAULT_MIN_TIME_S;
+    bool checkAllocs = false;
+    bool checkReplays = false;
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.find("--filter=") == 0) {
+            filter = arg.substr(9);
+        } else if (arg.find("--min_time=") == 0) {
+            minTime = atof(arg.substr(11).c_str());
+        } else if (arg.find("--out=") == 0) {
+            outFile = arg.substr(6);
+        } else if (arg == "--check_allocs") {
+            checkAllocs = true;
+        } else if (arg == "--check_replays") {
+            checkReplays = true;
+        } else {
+            std::cerr << "Usage: kmm_microbench [--filter=SUBSTRING] [--min_time=SECONDS] [--out=FILE] [--check_allocs] [--check_replays]" << std::endl;
+            return 1;
+        }
+    }
+    
+    std::vector<BenchDef> defs;
+    Register(defs, "BM_ConfigParse", BM_ConfigParse, {0, 7, 31});
+    Register(defs, "BM_MappingLookup", BM_MappingLookup, {0, 8}, true);
+    Register(defs, "BM_BindingLookup", BM_BindingLookup, {16, 1024}, true);
+    Register(defs, "BM_UsageRecord", BM_UsageRecord, {1, 16}, true);
+    Register(defs, "BM_ContactFrameBuild", BM_ContactFrameBuild, {1, 2, 5, 10}, true);
+    Register(defs, "BM_ContactFromTemplate", BM_ContactFromTemplate, {1, 2, 5, 10}, true);
+    Register(defs, "BM_HookDispatch", BM_HookDispatch, {4, 26}, true);
+    Register(defs, "BM_ChordMatch", BM_ChordMatch, {16, 256}, true);
+    Register(defs, "BM_OverlayRender", BM_OverlayRender, {10, 60, 120}, true);
+    Register(defs, "BM_EventStream", BM_EventStream, {0, 1, 4}, true);
+    Register(defs, "BM_TraceSpan", BM_TraceSpan, {0, 1}, true);
+    Register(defs, "BM_PluginDispatch", BM_PluginDispatch, {1, 16}, true);
+    Register(defs, "BM_KeyToTouch", BM_KeyToTouch, {0, 8}, true);
+    Register(defs, "BM_SimulatedTurbo", BM_SimulatedTurbo, {1, 10}, true);
+    
+    if (checkAllocs || checkReplays) {
+        int failures = 0;
+        if (checkAllocs) {
+            failures += CheckAllocations(defs);
+        }
+        if (checkReplays) {
+            failures += CheckReplays();
+        }
+        return failures == 0 ? 0 : 1;
+    }
+    
+    std::vector<BenchResult> results;
+    for (const auto& def : defs) {
+        if (!filter.empty() && def.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        BenchResult result = RunBenchmark(def, minTime);
+        fprintf(stderr, "%-28s %12.1f ns %14lld iterations\n",
+                result.name.c_str(), result.nsPerIteration, (long long)result.iterations);
+        results.push_back(result);
+    }
+    
+    if (outFile.empty()) {
+        WriteJson(std::cout, results);
+    } else {
+        std::ofstream out(outFile, std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "Failed to open output file: " << outFile << std::endl;
+            return 1;
+        }
+        WriteJson(out, results);
+    }
+    
+    return 0;
+}
@@ -1,21 +1,93 @@
 #include "Application.h"
 #include <iostream>
 #include <iomanip>
+#include <sstream>
+#include <algorithm>
 
 // Application constants
 #define MAX_SIMULTANEOUS_TOUCHES 10
-#define TOUCH_UPDATE_TIMER_ID 1
-#define TOUCH_UPDATE_INTERVAL_MS 500  // Update every 500ms to keep touch alive
+#define TOUCH_UPDATE_INTERVAL_US 500000  // Update every 500ms to keep touch alive
 
-// Static instance pointer for timer callback
-static Application* s_appInstance = nullptr;
+// Shortest time between stats page updates (microseconds)
+#define STATS_PUBLISH_INTERVAL_US 100000
 
-Application::Application()
-    : m_mode(AppMode::IDLE)
+// Keyboard hook health check interval while keys are held, and otherwise
+// (a hook dropped while nothing is typed must still be re-installed) (microseconds)
+#define HOOK_WATCHDOG_INTERVAL_US 250000
+#define HOOK_IDLE_WATCHDOG_INTERVAL_US 5000000
+
+// Usage snapshot interval, and heatmap refresh interval while it is shown (microseconds)
+#define USAGE_SNAPSHOT_INTERVAL_US 60000000
+#define HEATMAP_REFRESH_INTERVAL_US 1000000
+
+// Stick/trigger contacts use the top touch IDs (axis 0 -> ID 9)
+#define ANALOG_TOUCH_ID(axis) (MAX_SIMULTANEOUS_TOUCHES - 1 - (axis))
+
+// The mouse look contact takes the next ID below them
+#define MOUSE_LOOK_TOUCH_ID ANALOG_TOUCH_ID(GAMEPAD_AXIS_COUNT)
+
+// Key, chord and turbo contacts take free IDs from the rest (AcquireKeyTouchId)
+
+// Without frame pacing, mouse motion moves the contact at most once per interval (microseconds)
+#define MOUSE_LOOK_INTERVAL_US 4000
+
+// How often a target window that is not open yet is looked for (microseconds, not while idle)
+#define WINDOW_SEARCH_INTERVAL_US 1000000
+
+// Refresh period simulated runs pace frames to (60 Hz, vblank at startup):
+// a replay must not depend on the display of the machine running it
+#define SIMULATED_REFRESH_PERIOD_US 16667
+
+// Microseconds since boot (QPC), usable before the scheduler exists.
+// Startup and handling times are always measured in real time.
+static int64_t QpcNowUs() {
+    return SystemClock::Instance().Now();
+}
+
+Application::Application(const std::string& configFile, SimulatedClock* clock)
+    : m_configFile(configFile)
+    , m_simulatedClock(clock)
+    , m_mode(AppMode::IDLE)
     , m_running(false)
     , m_displayEnabled(false)
-    , m_touchUpdateTimer(0) {
-    s_appInstance = this;
+    , m_keyTouchMask(0)
+    , m_reservedTouchIds(0)
+    , m_activeChordCount(0)
+    , m_frameFlushTask(0)
+    , m_frameFlushTarget(0)
+    , m_keyEventCount(0)
+    , m_mappedKeyDownCount(0)
+    , m_controlCommandCount(0)
+    , m_statsPublishTask(0)
+    , m_lastStatsPublish(0)
+    , m_wakeupCount(0)
+    , m_timerWakeupCount(0)
+    , m_gamepadPollTask(0)
+    , m_touchUpdateTask(0)
+    , m_chordResolveTask(0)
+    , m_hookWatchdogTask(0)
+    , m_hookWatchdogDue(0)
+    , m_heatmapEnabled(false)
+    , m_usageTask(0)
+    , m_usageSnapshotTime(0)
+    , m_usageDirty(false)
+    , m_mouseLookActive(false)
+    , m_mouseLookTouching(false)
+    , m_mouseLookX(0.0f)
+    , m_mouseLookY(0.0f)
+    , m_mouseLookDx(0)
+    , m_mouseLookDy(0)
+    , m_mouseLookTask(0)
+    , m_lastMouseLookUs(0)
+    , m_mouseMotionCount(0)
+    , m_mouseLookMoveCount(0)
+    , m_windowSearchTask(0)
+    , m_pluginTouches(0) {
+    for (int& touchId : m_keyTouchIds) {
+        touchId = -1;
+    }
+    memset(m_turbo, 0, sizeof(m_turbo));
+    memset(m_analogTouching, 0, sizeof(m_analogTouching));
 }
 
 Application::~Application() {
@@ -23,49 +95,164 @@ Application::~Application() {
 }
 
 bool Application::Initialize() {
-    std::cout << "========================================" << std::endl;
-    std::cout << "  Keyboard to Touch Mapping Application" << std::endl;
-    std::cout << "========================================" << std::endl;
-    std::cout << std::endl;
+    int64_t startTime = QpcNowUs();
+    
+    // Critical path first: mapping table, then the hook, then touch injection.
+    // Everything a first mapped key press does not need comes after.
+    m_config = std::make_unique<ConfigManager>(m_configFile);
+    RebuildChords();
+    UpdateReservedTouchIds();
+    int64_t configTime = QpcNowUs();
     
-    // Create components
-    m_config = std::make_unique<ConfigManager>();
+    // Install keyboard hook (a simulated run hooks nothing: events come through ReplayKeyEvent)
     m_keyboardHook = std::make_unique<KeyboardHook>();
-    m_touchInjector = std::make_unique<TouchInjector>();
-    m_overlay = std::make_unique<DisplayOverlay>();
+    if (m_simulatedClock != nullptr) {
+        m_keyboardHook->SetClock(m_simulatedClock);
+    } else if (!m_keyboardHook->Install()) {
+        std::cerr << "Failed to install keyboard hook." << std::endl;
+        return false;
+    }
+    
+    // Set keyboard handler and the keys it needs
+    m_keyboardHook->SetKeyHandler<Application, &Application::OnKeyEvent>(this);
+    UpdateKeyFilter();
+    int64_t hookTime = QpcNowUs();
     
     // Initialize touch injector
-    if (!m_touchInjector->Initialize()) {
+    m_touchInjector = std::make_unique<TouchInjector>();
+    if (!m_touchInjector->Initialize(m_simulatedClock == nullptr)) {
         std::cerr << "Failed to initialize touch injector." << std::endl;
+        m_keyboardHook->Uninstall();
         return false;
     }
+    int64_t touchTime = QpcNowUs();
     
-    // Create overlay window
-    if (!m_overlay->Create()) {
-        std::cerr << "Failed to create overlay window." << std::endl;
-        return false;
+    // Per-device mappings need raw input to tell keyboards apart
+    if (m_config->GetDeviceCount() > 0 && m_simulatedClock == nullptr) {
+        m_rawInput = std::make_unique<RawInputRouter>();
+        if (m_rawInput->Initialize()) {
+            std::vector<std::string> patterns;
+            for (int device = 1; device <= m_config->GetDeviceCount(); ++device) {
+                patterns.push_back(m_config->GetDevice(device).pattern);
+            }
+            m_rawInput->SetDevicePatterns(patterns);
+            m_rawInput->SetKeyHandler<Application, &Application::OnDeviceKeyEvent>(this);
+            UpdateKeyFilter();
+        } else {
+            std::cerr << "Warning: Raw input unavailable. Device-specific mappings are ignored." << std::endl;
+            m_rawInput.reset();
+        }
     }
     
-    // Install keyboard hook
-    if (!m_keyboardHook->Install()) {
-        std::cerr << "Failed to install keyboard hook." << std::endl;
-        return false;
+    // Scheduler drives turbo taps, tap holds and keepalives; without it turbo
+    // keys fall back to single taps and held touches may time out
+    m_scheduler = (m_simulatedClock != nullptr) ? std::make_unique<Scheduler>(m_simulatedClock)
+                                                 : std::make_unique<Scheduler>();
+    if (!m_scheduler->Initialize()) {
+        std::cerr << "Warning: Failed to initialize scheduler. Turbo keys will not repeat." << std::endl;
+    } else {
+        m_touchInjector->SetScheduler(m_scheduler.get());
+    }
+    
+    // Frame pacing: queue touch changes and send them just before each display refresh
+    if (m_config->GetFramePacingLeadUs() > 0 && m_touchInjector->IsSupported() &&
+        m_scheduler->CanRunTasks()) {
+        m_framePacer = std::make_unique<FramePacer>();
+        if (m_simulatedClock != nullptr) {
+            m_framePacer->SetTiming(m_scheduler->Now(), SIMULATED_REFRESH_PERIOD_US);
+        } else {
+            m_framePacer->Initialize(m_scheduler->Now());
+        }
+        m_framePacer->SetLeadUs(m_config->GetFramePacingLeadUs());
+        m_touchInjector->SetFrameBatching(true);
+    }
+    
+    // Gamepad buttons go through the key path; polling starts with mapping/recording mode
+    if (m_config->IsGamepadEnabled()) {
+        m_gamepad = std::make_unique<GamepadSource>();
+        if (m_scheduler->GetWaitHandle() != nullptr && m_gamepad->Initialize()) {
+            m_gamepad->SetButtonHandler<Application, &Application::OnKeyEvent>(this);
+            m_gamepad->SetAxisHandler<Application, &Application::OnGamepadAxis>(this);
+        } else {
+            std::cerr << "Warning: Gamepad input unavailable." << std::endl;
+            m_gamepad.reset();
+        }
+    }
+    
+    // Control pipe and stats page for external tools
+    if (m_config->IsControlIpcEnabled() && m_simulatedClock == nullptr) {
+        m_control = std::make_unique<ControlServer>();
+        if (m_control->Initialize()) {
+            m_control->SetCommandHandler<Application, &Application::OnControlCommand>(this);
+        } else {
+            std::cerr << "Warning: Control pipe unavailable." << std::endl;
+            m_control.reset();
+        }
+        
+        m_statsPage = std::make_unique<StatsPage>();
+        if (m_scheduler->GetWaitHandle() != nullptr && m_statsPage->Create()) {
+            m_statsPublishTask = m_scheduler->Schedule(m_scheduler->Now(), StatsPublishTaskProc, this, 0, false);
+        } else {
+            std::cerr << "Warning: Stats page unavailable." << std::endl;
+            m_statsPage.reset();
+        }
+    }
+    
+    // Key and contact records for stream overlays and visualizers
+    if (m_config->IsEventStreamEnabled()) {
+        m_eventStream = std::make_unique<EventStream>();
+        if (m_eventStream->Create((m_simulatedClock != nullptr) ? nullptr : EVENT_STREAM_NAME)) {
+            m_eventStream->SetClock(&m_scheduler->GetClock());
+            m_touchInjector->SetEventStream(m_eventStream.get());
+        } else {
+            std::cerr << "Warning: Event stream unavailable." << std::endl;
+            m_eventStream.reset();
+        }
+    }
+    
+    // Custom actions from plugin DLLs
+    UpdatePlugins(true);
+    
+    // Positions anchored to a window follow it from here on
+    UpdateTargetWindow();
+    
+    // The overlay window is created on first use (display toggle)
+    m_overlay = std::make_unique<DisplayOverlay>();
+    m_overlay->SetEditHandler<Application, &Application::OnOverlayEdit>(this);
+    
+    // Press counts and hold times per key, written out after use
+    if (m_config->IsUsageStatsEnabled() && m_scheduler->CanRunTasks()) {
+        m_usage = std::make_unique<UsageCounters>();
+        m_usageSnapshotTime = m_scheduler->Now();
     }
     
-    // Set keyboard callback
-    m_keyboardHook->SetKeyCallback([this](int vk, bool isDown) {
-        this->OnKeyEvent(vk, isDown);
-    });
+    // Pipeline spans for a trace viewer, written on Ctrl+Shift+P and on exit
+    Tracer::SetEnabled(m_config->IsTraceEnabled());
     
-    // Create timer for touch updates (keeps touches alive)
-    // Using NULL hwnd creates a thread timer that posts WM_TIMER to the message queue
-    // This is processed by our message loop in Run()
-    m_touchUpdateTimer = SetTimer(NULL, TOUCH_UPDATE_TIMER_ID, TOUCH_UPDATE_INTERVAL_MS, TouchUpdateTimerProc);
-    if (m_touchUpdateTimer == 0) {
-        std::cerr << "Warning: Failed to create touch update timer. Held touches may timeout." << std::endl;
+    // The touch keepalive, stats and usage snapshots are armed by input and stop
+    // once it has been handled. Only the hook watchdog keeps running without
+    // input, at a low rate: a hook dropped while no key is typed is otherwise
+    // never re-installed.
+    ArmHookWatchdog(HOOK_IDLE_WATCHDOG_INTERVAL_US);
+    if (!m_scheduler->CanRunTasks()) {
+        std::cerr << "Warning: No scheduler timer. Held touches may timeout." << std::endl;
     }
+    int64_t readyTime = QpcNowUs();
     
     m_running = true;
+    
+    std::cout << "========================================" << std::endl;
+    std::cout << "  Keyboard to Touch Mapping Application" << std::endl;
+    std::cout << "========================================" << std::endl;
+    std::cout << std::endl;
+    std::cout << std::fixed << std::setprecision(2)
+              << "Startup: config " << (configTime - startTime) / 1000.0 << " ms, hook "
+              << (hookTime - configTime) / 1000.0 << " ms, touch "
+              << (touchTime - hookTime) / 1000.0 << " ms, ready in "
+              << (readyTime - startTime) / 1000.0 << " ms" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+    
     PrintHelp();
     PrintStatus();
     
@@ -74,33 +261,142 @@ bool Application::Initialize() {
 
 void Application::Run() {
     MSG msg;
-    while (m_running && GetMessage(&msg, nullptr, 0, 0)) {
-        TranslateMessage(&msg);
-        DispatchMessage(&msg);
+    HANDLE handles[2];
+    DWORD handleCount = 0;
+    if (m_scheduler->GetWaitHandle() != nullptr) {
+        handles[handleCount++] = m_scheduler->GetWaitHandle();
+    }
+    if (m_control) {
+        handles[handleCount++] = m_control->GetWaitHandle();
+    }
+    
+    while (m_running) {
+        // Sleep until a message arrives (keyboard hook calls included), a task is due or pipe I/O completes
+        DWORD result = MsgWaitForMultipleObjectsEx(handleCount, handles, INFINITE,
+                                                   QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+        if (result == WAIT_FAILED) {
+            std::cerr << "Message wait failed. Error: " << GetLastError() << std::endl;
+            break;
+        }
+        
+        // Every return from the wait is a wake-up; timer ones should only follow input
+        ++m_wakeupCount;
+        if (m_scheduler->GetWaitHandle() != nullptr && result == WAIT_OBJECT_0) {
+            ++m_timerWakeupCount;
+        }
+        
+        while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT) {
+                m_running = false;
+                break;
+            }
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+        
+        m_scheduler->RunDueTasks();
+        if (m_control) {
+            m_control->Poll();
+        }
+        ScheduleFrameFlush();
     }
 }
 
 void Application::Shutdown() {
     m_running = false;
     
-    // Kill the touch update timer
-    if (m_touchUpdateTimer != 0) {
-        KillTimer(NULL, m_touchUpdateTimer);
-        m_touchUpdateTimer = 0;
+    // Cancel the touch update and chord resolve tasks
+    if (m_touchUpdateTask != 0 && m_scheduler) {
+        m_scheduler->Cancel(m_touchUpdateTask);
+        m_touchUpdateTask = 0;
+    }
+    
+    if (m_chordResolveTask != 0 && m_scheduler) {
+        m_scheduler->Cancel(m_chordResolveTask);
+        m_chordResolveTask = 0;
+    }
+    
+    if (m_hookWatchdogTask != 0 && m_scheduler) {
+        m_scheduler->Cancel(m_hookWatchdogTask);
+        m_hookWatchdogTask = 0;
+    }
+    
+    if (m_usageTask != 0 && m_scheduler) {
+        m_scheduler->Cancel(m_usageTask);
+        m_usageTask = 0;
+    }
+    if (m_usage && m_config) {
+        WriteUsageSnapshot();
+    }
+    if (Tracer::IsEnabled() && m_config) {
+        Tracer::SetEnabled(false);
+        WriteTrace();
     }
     
     // Release any active touches before shutting down
+    if (m_mouseLookActive) {
+        SetMouseLook(false);
+    }
+    StopAllTurbo();
     if (m_touchInjector) {
         m_touchInjector->ReleaseAllTouches();
+        m_touchInjector->SetScheduler(nullptr);
+        m_touchInjector->SetFrameBatching(false);
+    }
+    if (m_frameFlushTask != 0 && m_scheduler) {
+        m_scheduler->Cancel(m_frameFlushTask);
+        m_frameFlushTask = 0;
+    }
+    if (m_statsPublishTask != 0 && m_scheduler) {
+        m_scheduler->Cancel(m_statsPublishTask);
+        m_statsPublishTask = 0;
+    }
+    if (m_gamepadPollTask != 0 && m_scheduler) {
+        m_scheduler->Cancel(m_gamepadPollTask);
+        m_gamepadPollTask = 0;
     }
+    if (m_windowSearchTask != 0 && m_scheduler) {
+        m_scheduler->Cancel(m_windowSearchTask);
+        m_windowSearchTask = 0;
+    }
+    m_windowTracker.reset();
+    memset(m_analogTouching, 0, sizeof(m_analogTouching));
+    
+    // Plugins go after their touches are lifted
+    m_pluginTouches = 0;
+    m_plugins.reset();
     
     // Clear key states
-    m_keyStates.clear();
+    m_heldKeys.Reset();
+    for (int& touchId : m_keyTouchIds) {
+        touchId = -1;
+    }
+    m_keyTouchMask = 0;
+    m_activeChordCount = 0;
+    m_pendingKeys.Reset();
+    m_pressedKeys.Reset();
     
     if (m_keyboardHook) {
         m_keyboardHook->Uninstall();
     }
     
+    if (m_rawInput) {
+        m_rawInput->Shutdown();
+    }
+    
+    if (m_control) {
+        m_control->Shutdown();
+    }
+    if (m_statsPage) {
+        m_statsPage->Close();
+    }
+    if (m_eventStream) {
+        if (m_touchInjector) {
+            m_touchInjector->SetEventStream(nullptr);
+        }
+        m_eventStream->Close();
+    }
+    
     if (m_overlay) {
         m_overlay->Destroy();
     }
@@ -108,11 +404,75 @@ void Application::Shutdown() {
     std::cout << "Application shutdown complete." << std::endl;
 }
 
+bool Application::ReplayKeyEvent(int virtualKey, bool isDown, int scanCode, bool extended) {
+    // Queued touches go out at the next flush point, as after a message in Run
+    bool consumed = m_keyboardHook->Dispatch(virtualKey & 0xFF, isDown, scanCode, extended);
+    ScheduleFrameFlush();
+    return consumed;
+}
+
+void Application::ReplayMouseMotion(int dx, int dy) {
+    OnMouseMotion(dx, dy);
+    ScheduleFrameFlush();
+}
+
+void Application::ReplayGamepadAxis(int axis, float x, float y) {
+    OnGamepadAxis(axis, x, y);
+    ScheduleFrameFlush();
+}
+
+void Application::ReplayWindowPlacement(const RECT& client) {
+    OnWindowPlacement(client);
+}
+
+void Application::RunUntil(int64_t timeUs) {
+    m_scheduler->RunUntil(timeUs);
+    ScheduleFrameFlush();
+}
+
+const ConfigManager& Application::GetConfig() const {
+    return *m_config;
+}
+
+const KeyboardHook& Application::GetKeyboardHook() const {
+    return *m_keyboardHook;
+}
+
+const TouchInjector& Application::GetTouchInjector() const {
+    return *m_touchInjector;
+}
+
+const FramePacer* Application::GetFramePacer() const {
+    return m_framePacer.get();
+}
+
 void Application::OnKeyEvent(int virtualKey, bool isDown) {
+    int64_t start = QpcNowUs();
+    
+    // Device-routed keys are reported with their device by OnDeviceKeyEvent
+    if (m_eventStream && !m_deviceRoutedKeys.Test(virtualKey)) {
+        m_eventStream->Write(isDown ? EVENT_KEY_DOWN : EVENT_KEY_UP, virtualKey, 0, 0, 0);
+    }
+    HandleKeyEvent(virtualKey, isDown);
+    m_keyLatency.Record(QpcNowUs() - start);
+    ++m_keyEventCount;
+    
+    // Watch the hook closely while keys are held, and once soon after each event
+    ArmHookWatchdog(HOOK_WATCHDOG_INTERVAL_US);
+    RequestStatsPublish();
+}
+
+void Application::HandleKeyEvent(int virtualKey, bool isDown) {
+    // Track the pressed key set in every mode so chords see keys held across mode switches
+    bool isRepeat = isDown && m_pressedKeys.Test(virtualKey);
+    UpdatePressedKeys(virtualKey, isDown);
+    
     // Handle control keys (check Ctrl+Shift combinations) - only on key down
     if (isDown) {
-        bool ctrlPressed = (GetAsyncKeyState(VK_CONTROL) & 0x8000) != 0;
-        bool shiftPressed = (GetAsyncKeyState(VK_SHIFT) & 0x8000) != 0;
+        // Modifiers are usually filtered out of the hook, so ask it for the key state
+        // (on a simulated clock that is the replayed state, not this machine's keyboard)
+        bool ctrlPressed = m_keyboardHook->IsKeyHeld(VK_CONTROL);
+        bool shiftPressed = m_keyboardHook->IsKeyHeld(VK_SHIFT);
         
         // Ctrl+Shift+R: Recording mode
         if (ctrlPressed && shiftPressed && virtualKey == 'R') {
@@ -135,15 +495,79 @@ void Application::OnKeyEvent(int virtualKey, bool isDown) {
         // Ctrl+Shift+D: Toggle display
         if (ctrlPressed && shiftPressed && virtualKey == 'D') {
             m_displayEnabled = !m_displayEnabled;
+            RefreshOverlay();
+            if (!m_displayEnabled) {
+                m_overlay->SetEditMode(false);
+            }
             m_overlay->SetVisible(m_displayEnabled);
+            
+            // The heatmap refresh stops while the overlay is hidden
+            if (m_heatmapEnabled && m_displayEnabled && m_usageTask == 0) {
+                m_usageTask = m_scheduler->Schedule(m_scheduler->Now(), UsageTaskProc, this, 0, false);
+            }
             std::cout << "Display overlay: " << (m_displayEnabled ? "ON" : "OFF") << std::endl;
             return;
         }
         
+        // Ctrl+Shift+E: Toggle overlay edit mode (drag and delete indicators with the mouse)
+        if (ctrlPressed && shiftPressed && virtualKey == 'E') {
+            bool editMode = !m_overlay->IsEditMode();
+            
+            // Touches injected in mapping mode would land on the overlay
+            if (editMode && m_mode == AppMode::MAPPING) {
+                std::cout << "Leave mapping mode to edit the overlay." << std::endl;
+                return;
+            }
+            if (editMode && !m_displayEnabled) {
+                m_displayEnabled = true;
+                RefreshOverlay();
+                m_overlay->SetVisible(true);
+            }
+            m_overlay->SetEditMode(editMode);
+            std::cout << "Overlay edit mode: " << (editMode ? "ON (drag to move, right-click to delete)" : "OFF") << std::endl;
+            return;
+        }
+        
+        // Ctrl+Shift+L: Toggle mouse look (mouse motion drags a touch)
+        if (ctrlPressed && shiftPressed && virtualKey == 'L') {
+            SetMouseLook(!m_mouseLookActive);
+            return;
+        }
+        
+        // Ctrl+Shift+U: Toggle usage heatmap on the overlay
+        if (ctrlPressed && shiftPressed && virtualKey == 'U') {
+            if (!m_usage) {
+                std::cout << "Usage stats are off (set usage_stats=1 in the config)." << std::endl;
+                return;
+            }
+            m_heatmapEnabled = !m_heatmapEnabled;
+            m_overlay->SetUsage(m_heatmapEnabled ? m_usage.get() : nullptr);
+            
+            // Refresh the heatmap more often while it is shown
+            if (m_usageTask != 0) {
+                m_scheduler->Cancel(m_usageTask);
+            }
+            m_usageTask = m_scheduler->Schedule(m_scheduler->Now(), UsageTaskProc, this, 0, false);
+            std::cout << "Usage heatmap: " << (m_heatmapEnabled ? "ON" : "OFF") << std::endl;
+            return;
+        }
+        
+        // Ctrl+Shift+P: Write the trace recorded so far (tracing keeps running)
+        if (ctrlPressed && shiftPressed && virtualKey == 'P') {
+            if (!Tracer::IsEnabled()) {
+                std::cout << "Tracing is off (set trace=1 in the config)." << std::endl;
+                return;
+            }
+            WriteTrace();
+            return;
+        }
+        
         // Ctrl+Shift+C: Clear all mappings
         if (ctrlPressed && shiftPressed && virtualKey == 'C') {
             m_config->ClearMappings();
-            m_overlay->UpdateMappings(m_config->GetAllMappings());
+            RebuildChords();
+            UpdateKeyFilter();
+            RefreshOverlay();
             std::cout << "All mappings cleared." << std::endl;
             return;
         }
@@ -177,6 +601,11 @@ void Application::OnKeyEvent(int virtualKey, bool isDown) {
         }
     }
     
+    // Layer keys switch layers while recording and mapping
+    if (m_mode != AppMode::IDLE && HandleLayerKey(virtualKey, isDown, isRepeat)) {
+        return;
+    }
+    
     // Handle mode-specific key events
     switch (m_mode) {
         case AppMode::RECORDING: {
@@ -187,71 +616,64 @@ void Application::OnKeyEvent(int virtualKey, bool isDown) {
             
             // Ignore modifier keys
             if (virtualKey == VK_CONTROL || virtualKey == VK_SHIFT || 
-                virtualKey == VK_MENU || virtualKey == VK_LWIN || virtualKey == VK_RWIN) {
+                virtualKey == VK_MENU || virtualKey == VK_LWIN || virtualKey == VK_RWIN ||
+                (virtualKey >= VK_LSHIFT && virtualKey <= VK_RMENU)) {
                 return;
             }
             
-            // Get current mouse position
+            // Get current mouse position (relative to the target window, if any)
             POINT cursorPos;
             GetCursorPos(&cursorPos);
+            int x = cursorPos.x;
+            int y = cursorPos.y;
+            m_config->FromScreen(x, y);
             
-            // Save mapping
-            char keyName[256];
-            UINT scanCode = MapVirtualKeyA(virtualKey, MAPVK_VK_TO_VSC);
-            if (GetKeyNameTextA(scanCode << 16, keyName, sizeof(keyName)) > 0) {
-                m_config->SaveMapping(virtualKey, cursorPos.x, cursorPos.y, keyName);
-                std::cout << "Mapped key [" << keyName << "] to position (" 
-                         << cursorPos.x << ", " << cursorPos.y << ")" << std::endl;
-                
-                // Update overlay
-                m_overlay->UpdateMappings(m_config->GetAllMappings());
+            // Key pressed with Shift/Ctrl/Alt held: record a chord
+            std::vector<int> chordKeys;
+            for (int modifier : { VK_SHIFT, VK_CONTROL, VK_MENU }) {
+                if (m_pressedKeys.Test(modifier)) {
+                    chordKeys.push_back(modifier);
+                }
+            }
+            if (!chordKeys.empty()) {
+                chordKeys.push_back(virtualKey);
+                if (m_config->SaveChord(chordKeys, x, y, "")) {
+                    RebuildChords();
+                    std::cout << "Mapped chord [" << m_config->GetAllChords().back().keyName
+                             << "] to position (" << x << ", " << y << ")" << std::endl;
+                }
+                break;
             }
+            
+            // Save mapping (gamepad buttons have no key name text)
+            std::string keyName = ConfigManager::GetKeyName(virtualKey);
+            m_config->SaveMapping(virtualKey, x, y, keyName);
+            std::cout << "Mapped key [" << keyName << "] to position (" 
+                     << x << ", " << y << ")" << std::endl;
+            
+            // Update overlay
+            RefreshOverlay();
             break;
         }
         
         case AppMode::MAPPING: {
-            // Check if this key has a mapping
-            KeyMapping mapping;
-            if (m_config->GetMapping(virtualKey, mapping)) {
-                // Use modulo to cycle through available touch IDs
-                int touchId = virtualKey % MAX_SIMULTANEOUS_TOUCHES;
-                
-                if (m_config->GetHoldTriggersContinuousTap()) {
-                    // Old behavior: trigger tap on every key down event (high frequency clicks)
-                    if (isDown) {
-                        if (m_touchInjector->TouchTap(mapping.x, mapping.y, touchId)) {
-                            std::cout << "Touch tap for [" << mapping.keyName << "] at (" 
-                                     << mapping.x << ", " << mapping.y << ")" << std::endl;
-                        }
-                    }
-                } else {
-                    // New default behavior: hold maintains touch
-                    if (isDown) {
-                        // Check if this is a new key press (not a repeat)
-                        auto it = m_keyStates.find(virtualKey);
-                        if (it == m_keyStates.end()) {
-                            // First press - touch down and add to map
-                            m_keyStates.emplace(virtualKey, true);
-                            if (m_touchInjector->TouchDown(mapping.x, mapping.y, touchId)) {
-                                std::cout << "Touch down for [" << mapping.keyName << "] at (" 
-                                         << mapping.x << ", " << mapping.y << ")" << std::endl;
-                            }
-                        }
-                        // Ignore repeat key down events while holding (entry exists in map)
-                    } else {
-                        // Key up - touch up
-                        auto it = m_keyStates.find(virtualKey);
-                        if (it != m_keyStates.end()) {
-                            if (m_touchInjector->TouchUp(touchId)) {
-                                std::cout << "Touch up for [" << mapping.keyName << "]" << std::endl;
-                            }
-                            // Use iterator-based erase to prevent memory growth
-                            // Iterator remains valid and erase is O(1) for the found element
-                            m_keyStates.erase(it);
-                        }
-                    }
-                }
+            // Keys with device-specific mappings arrive through raw input instead
+            if (m_deviceRoutedKeys.Test(virtualKey)) {
+                break;
+            }
+            
+            // Plugin actions come first; an action that declines falls through to the mappings
+            if (m_plugins && m_plugins->GetActionKeys().Test(virtualKey) &&
+                HandlePluginAction(virtualKey, isDown, isRepeat)) {
+                break;
+            }
+            
+            // Chords take priority over single-key mappings
+            if (HandleChordEvent(virtualKey, isDown, isRepeat)) {
+                break;
             }
+            
+            HandleMappedKey(virtualKey, isDown, isRepeat);
             break;
         }
         
@@ -261,70 +683,1498 @@ void Application::OnKeyEvent(int virtualKey, bool isDown) {
     }
 }
 
-void Application::SetMode(AppMode mode) {
-    m_mode = mode;
-    PrintStatus();
+void Application::OnDeviceKeyEvent(int device, int virtualKey, bool isDown) {
+    // The router already drops repeats; key-ups always release what the key-down started
+    if (m_mode != AppMode::MAPPING || (isDown && !m_deviceRoutedKeys.Test(virtualKey))) {
+        return;
+    }
+    if (m_eventStream) {
+        m_eventStream->Write(isDown ? EVENT_KEY_DOWN : EVENT_KEY_UP, virtualKey, device, 0, 0);
+    }
+    HandleMappedKey(virtualKey, isDown, false, device);
+    RequestStatsPublish();
 }
 
-void Application::PrintStatus() {
-    std::cout << "\n--- Current Status ---" << std::endl;
-    std::cout << "Mode: ";
-    switch (m_mode) {
-        case AppMode::RECORDING:
-            std::cout << "RECORDING - Press keys to record their positions" << std::endl;
+void Application::UpdatePressedKeys(int virtualKey, bool isDown) {
+    if (virtualKey < 0 || virtualKey > 255) {
+        return;
+    }
+    
+    if (isDown) {
+        m_pressedKeys.Set(virtualKey);
+    } else {
+        m_pressedKeys.Clear(virtualKey);
+    }
+    
+    // The hook reports left/right modifier keys; chords use the generic codes
+    int genericKey = 0;
+    int leftKey = 0;
+    int rightKey = 0;
+    switch (virtualKey) {
+        case VK_LSHIFT: case VK_RSHIFT:
+            genericKey = VK_SHIFT; leftKey = VK_LSHIFT; rightKey = VK_RSHIFT;
             break;
-        case AppMode::MAPPING:
-            std::cout << "MAPPING - Press keys to trigger touch events" << std::endl;
+        case VK_LCONTROL: case VK_RCONTROL:
+            genericKey = VK_CONTROL; leftKey = VK_LCONTROL; rightKey = VK_RCONTROL;
             break;
-        case AppMode::IDLE:
-            std::cout << "IDLE - No action on key press" << std::endl;
+        case VK_LMENU: case VK_RMENU:
+            genericKey = VK_MENU; leftKey = VK_LMENU; rightKey = VK_RMENU;
             break;
+        default:
+            return;
     }
     
-    std::cout << "Display: " << (m_displayEnabled ? "ON" : "OFF") << std::endl;
-    std::cout << "Hold behavior: " << (m_config->GetHoldTriggersContinuousTap() ? "Continuous Tap" : "Maintain Touch") << std::endl;
-    std::cout << "Mappings: " << m_config->GetAllMappings().size() << " keys configured" << std::endl;
-    
-    if (m_touchInjector && m_touchInjector->IsSupported()) {
-        std::cout << "Touch: Multi-point touch injection supported" << std::endl;
+    if (m_pressedKeys.Test(leftKey) || m_pressedKeys.Test(rightKey)) {
+        m_pressedKeys.Set(genericKey);
     } else {
-        std::cout << "Touch: Using mouse simulation fallback" << std::endl;
+        m_pressedKeys.Clear(genericKey);
     }
-    
-    std::cout << "----------------------\n" << std::endl;
 }
 
-void Application::PrintHelp() {
-    std::cout << "\n=== Keyboard Shortcuts ===" << std::endl;
-    std::cout << "Ctrl+Shift+R : Enter RECORDING mode" << std::endl;
-    std::cout << "Ctrl+Shift+M : Enter MAPPING mode" << std::endl;
-    std::cout << "Ctrl+Shift+I : Enter IDLE mode" << std::endl;
-    std::cout << "Ctrl+Shift+D : Toggle display overlay" << std::endl;
-    std::cout << "Ctrl+Shift+T : Toggle hold behavior (hold touch vs repeated taps)" << std::endl;
-    std::cout << "Ctrl+Shift+C : Clear all mappings" << std::endl;
-    std::cout << "Ctrl+Shift+H : Show this help" << std::endl;
-    std::cout << "Ctrl+Shift+Q : Quit application" << std::endl;
-    std::cout << "==========================\n" << std::endl;
+bool Application::HandleChordEvent(int virtualKey, bool isDown, bool isRepeat) {
+    if (m_chordMatcher.IsEmpty()) {
+        return false;
+    }
+    
+    const std::vector<ChordMapping>& chords = m_config->GetAllChords();
+    bool continuousTap = m_config->GetHoldTriggersContinuousTap();
+    
+    if (isDown) {
+        // Still waiting for the rest of a chord
+        if (isRepeat && m_pendingKeys.Test(virtualKey)) {
+            return true;
+        }
+        
+        int chordId = m_chordMatcher.Match(m_pressedKeys, virtualKey);
+        if (chordId >= 0) {
+            const ChordMapping& chord = chords[chordId];
+            
+            // Keys resolved into this chord must not also fire on their own
+            for (int i = 0; i < 4; ++i) {
+                m_pendingKeys.words[i] &= ~chord.keys.words[i];
+            }
+            for (int memberKey = 0; memberKey < 256; ++memberKey) {
+                if (!chord.keys.Test(memberKey)) continue;
+                if (m_heldKeys.Test(memberKey)) {
+                    m_touchInjector->TouchUp(m_keyTouchIds[memberKey]);
+                    ReleaseKeyTouchId(memberKey);
+                    m_heldKeys.Clear(memberKey);
+                }
+                if (m_turbo[memberKey].active) {
+                    StopTurbo(memberKey);
+                }
+            }
+            
+            for (int i = 0; i < m_activeChordCount; ++i) {
+                if (m_activeChords[i].chordId == chordId) {
+                    // Already held (auto-repeat of one of its keys)
+                    return true;
+                }
+            }
+            if (m_activeChordCount == MAX_TOUCH_CONTACTS) {
+                return true;
+            }
+            int touchId = AcquireKeyTouchId(virtualKey);
+            if (touchId < 0) {
+                return true;
+            }
+            
+            m_activeChords[m_activeChordCount].chordId = chordId;
+            m_activeChords[m_activeChordCount].triggerKey = virtualKey;
+            ++m_activeChordCount;
+            if (continuousTap) {
+                StartTurbo(virtualKey, chord.contact, touchId,
+                           m_config->GetDefaultTurboRateHz(), m_config->GetDefaultTurboDutyPercent());
+                if (m_config->IsTouchLogEnabled()) {
+                    std::cout << "Turbo on for chord [" << chord.keyName << "] at ("
+                             << chord.x << ", " << chord.y << ")" << std::endl;
+                }
+            } else if (m_touchInjector->TouchDown(chord.contact, touchId)) {
+                if (m_config->IsTouchLogEnabled()) {
+                    std::cout << "Touch down for chord [" << chord.keyName << "] at ("
+                             << chord.x << ", " << chord.y << ")" << std::endl;
+                }
+                ArmTouchUpdates();
+            }
+            return true;
+        }
+        
+        // A chord member with its own mapping: give the rest of the chord a moment to arrive
+        int resolveWindowMs = m_config->GetChordResolveWindowMs();
+        if (!isRepeat && resolveWindowMs > 0 && m_chordMatcher.IsMember(virtualKey) &&
+            m_config->GetMapping(virtualKey) != nullptr) {
+            m_pendingKeys.Set(virtualKey);
+            if (m_chordResolveTask == 0) {
+                m_chordResolveTask = m_scheduler->Schedule(m_scheduler->Now() + resolveWindowMs * 1000,
+                                                           ChordResolveTaskProc, this, 0, false);
+            }
+            return true;
+        }
+        
+        return false;
+    }
+    
+    bool consumed = false;
+    
+    // Released before the chord resolved: it was a plain tap of this key
+    if (m_pendingKeys.Test(virtualKey)) {
+        m_pendingKeys.Clear(virtualKey);
+        const KeyMapping* mapping = m_config->GetMapping(virtualKey);
+        if (mapping != nullptr) {
+            // The ID is busy until the injector lifts the tap, so it can go back right away
+            int touchId = AcquireKeyTouchId(virtualKey);
+            if (touchId >= 0 && m_touchInjector->TouchTap(mapping->contact, touchId) &&
+                m_config->IsTouchLogEnabled()) {
+                std::cout << "Touch tap for [" << mapping->keyName << "] at ("
+                         << mapping->x << ", " << mapping->y << ")" << std::endl;
+            }
+            ReleaseKeyTouchId(virtualKey);
+        }
+        consumed = true;
+    }
+    
+    // Releasing any key of a held chord lifts the chord touch
+    for (int i = 0; i < m_activeChordCount;) {
+        const ChordMapping& chord = chords[m_activeChords[i].chordId];
+        if (chord.keys.Test(virtualKey)) {
+            int triggerKey = m_activeChords[i].triggerKey;
+            if (m_turbo[triggerKey].active) {
+                StopTurbo(triggerKey);
+                if (m_config->IsTouchLogEnabled()) {
+                    std::cout << "Turbo off for chord [" << chord.keyName << "]" << std::endl;
+                }
+            } else if (m_touchInjector->TouchUp(m_keyTouchIds[triggerKey]) &&
+                       m_config->IsTouchLogEnabled()) {
+                std::cout << "Touch up for chord [" << chord.keyName << "]" << std::endl;
+            }
+            ReleaseKeyTouchId(triggerKey);
+            // Order does not matter: move the last entry into the hole
+            m_activeChords[i] = m_activeChords[--m_activeChordCount];
+        } else {
+            ++i;
+        }
+    }
+    
+    if (m_pendingKeys.Empty() && m_chordResolveTask != 0) {
+        m_scheduler->Cancel(m_chordResolveTask);
+        m_chordResolveTask = 0;
+    }
+    
+    return consumed;
 }
 
-void CALLBACK Application::TouchUpdateTimerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime) {
-    if (s_appInstance) {
-        s_appInstance->UpdateActiveTouches();
+bool Application::HandleLayerKey(int virtualKey, bool isDown, bool isRepeat) {
+    int layer = m_config->GetLayerForKey(virtualKey);
+    if (layer < 0) {
+        return false;
     }
+    
+    if (isRepeat) {
+        return true;
+    }
+    
+    bool wasActive = m_config->IsLayerActive(layer);
+    if (m_config->GetLayer(layer).activation == LayerActivation::HOLD) {
+        m_config->SetLayerActive(layer, isDown);
+    } else if (isDown) {
+        m_config->SetLayerActive(layer, !wasActive);
+    }
+    
+    if (m_config->IsLayerActive(layer) != wasActive) {
+        std::cout << "Layer [" << m_config->GetLayer(layer).name << "]: "
+                 << (wasActive ? "OFF" : "ON") << std::endl;
+        RefreshOverlay();
+    }
+    return true;
 }
 
-void Application::UpdateActiveTouches() {
-    // Only update touches in MAPPING mode when hold behavior is active
-    if (m_mode != AppMode::MAPPING || m_config->GetHoldTriggersContinuousTap()) {
-        return;
+void Application::HandleMappedKey(int virtualKey, bool isDown, bool isRepeat, int device) {
+    // A binding qualified by modifiers, extended flag or scancode wins over the plain mapping
+    int64_t traceBegin = Tracer::Begin();
+    const KeyMapping* mapping = nullptr;
+    if (isDown && !isRepeat && device == 0) {
+        mapping = FindBinding(virtualKey);
+        
+        // Bound keys pass the hook unless their modifiers are held: swallow just this keystroke
+        if (mapping != nullptr && m_config->IsConsumeMappedKeysEnabled()) {
+            m_keyboardHook->ConsumeKeyDown(virtualKey);
+        }
+    }
+    if (mapping == nullptr) {
+        mapping = m_config->GetMapping(virtualKey, device);
+    }
+    Tracer::End(TRACE_MAPPING_RESOLVE, traceBegin, virtualKey);
+    
+    if (!isDown) {
+        if (m_usage) {
+            m_usage->RecordRelease(virtualKey, m_scheduler->Now());
+        }
+        
+        if (m_turbo[virtualKey].active) {
+            StopTurbo(virtualKey);
+            if (m_config->IsTouchLogEnabled()) {
+                if (mapping != nullptr) {
+                    std::cout << "Turbo off for [" << mapping->keyName << "]" << std::endl;
+                } else {
+                    std::cout << "Turbo off for [" << virtualKey << "]" << std::endl;
+                }
+            }
+        }
+        
+        // Key up - touch up, even if a layer change has since unmapped the key
+        if (m_heldKeys.Test(virtualKey)) {
+            m_heldKeys.Clear(virtualKey);
+            int touchId = m_keyTouchIds[virtualKey];
+            ReleaseKeyTouchId(virtualKey);
+            if (m_touchInjector->TouchUp(touchId) && m_config->IsTouchLogEnabled()) {
+                if (mapping != nullptr) {
+                    std::cout << "Touch up for [" << mapping->keyName << "]" << std::endl;
+                } else {
+                    std::cout << "Touch up for [" << virtualKey << "]" << std::endl;
+                }
+            }
+        }
+        return;
+    }
+    
+    // OS auto-repeat never drives taps; turbo keys run on the scheduler instead
+    if (isRepeat || mapping == nullptr) {
+        return;
+    }
+    ++m_mappedKeyDownCount;
+    
+    // Per-mapping turbo, or continuous tap mode's default rate
+    int rateHz = mapping->turboRateHz;
+    int dutyPercent = mapping->turboDutyPercent;
+    if (rateHz == 0 && m_config->GetHoldTriggersContinuousTap()) {
+        rateHz = m_config->GetDefaultTurboRateHz();
+        dutyPercent = m_config->GetDefaultTurboDutyPercent();
+    }
+    
+    if (m_usage) {
+        m_usage->RecordPress(virtualKey, m_scheduler->Now());
+        
+        // Snapshot a full interval after the first unsaved press (no file I/O on the key path)
+        m_usageDirty = true;
+        if (m_usageTask == 0) {
+            m_usageTask = m_scheduler->Schedule(m_scheduler->Now() + USAGE_SNAPSHOT_INTERVAL_US,
+                                                UsageTaskProc, this, 0, false);
+        }
+    }
+    
+    // Every touch ID in use: the press has no contact to drive
+    int touchId = AcquireKeyTouchId(virtualKey);
+    if (touchId < 0) {
+        return;
+    }
+    
+    if (rateHz > 0) {
+        StartTurbo(virtualKey, mapping->contact, touchId, rateHz, dutyPercent);
+        if (m_config->IsTouchLogEnabled()) {
+            std::cout << "Turbo on for [" << mapping->keyName << "] at (" 
+                     << mapping->x << ", " << mapping->y << "), " << rateHz << " taps/s" << std::endl;
+        }
+        return;
+    }
+    
+    // Hold maintains touch
+    if (!m_heldKeys.Test(virtualKey)) {
+        // First press - touch down and mark the key held
+        m_heldKeys.Set(virtualKey);
+        if (m_touchInjector->TouchDown(mapping->contact, touchId) && m_config->IsTouchLogEnabled()) {
+            std::cout << "Touch down for [" << mapping->keyName << "] at (" 
+                     << mapping->x << ", " << mapping->y << ")" << std::endl;
+        }
+        ArmTouchUpdates();
+    }
+}
+
+bool Application::HandlePluginAction(int virtualKey, bool isDown, bool isRepeat) {
+    // The event is built on the stack and the key state is passed as a view of the live sets
+    const KeyMapping* mapping = m_config->GetMapping(virtualKey);
+    KmmKeyEvent event;
+    event.size = sizeof(event);
+    event.virtualKey = virtualKey;
+    event.isDown = isDown ? 1 : 0;
+    event.isRepeat = isRepeat ? 1 : 0;
+    event.scanCode = m_keyboardHook->GetScanCode(virtualKey);
+    event.extended = m_keyboardHook->IsExtended(virtualKey) ? 1 : 0;
+    event.x = (mapping != nullptr) ? mapping->screenX : -1;
+    event.y = (mapping != nullptr) ? mapping->screenY : -1;
+    event.timeUs = m_scheduler->Now();
+    
+    KmmKeyState keys;
+    keys.size = sizeof(keys);
+    keys.pressed = m_pressedKeys.words;
+    keys.touching = m_heldKeys.words;
+    
+    KmmContactBuffer out;
+    out.contacts = m_pluginContacts;
+    out.capacity = MAX_TOUCH_CONTACTS;
+    out.count = 0;
+    bool handled = m_plugins->Dispatch(event, keys, out);
+    
+    // Sent in order; with frame pacing they join the pending frame. A plugin
+    // only moves and lifts its own contacts, and only puts one down on an ID
+    // no key, stick, trigger or mouse look contact holds or may take.
+    for (uint32_t i = 0; i < out.count; ++i) {
+        const KmmContact& contact = m_pluginContacts[i];
+        if (contact.touchId < 0 || contact.touchId >= MAX_SIMULTANEOUS_TOUCHES) {
+            continue;
+        }
+        int touchBit = 1 << contact.touchId;
+        bool owned = (m_pluginTouches & touchBit) != 0;
+        switch (contact.action) {
+            case KMM_CONTACT_DOWN:
+                if (!owned && (((m_keyTouchMask | m_reservedTouchIds) & touchBit) != 0 ||
+                               m_touchInjector->IsTouchActive(contact.touchId))) {
+                    break;
+                }
+                if (m_touchInjector->TouchDown(contact.x, contact.y, contact.touchId)) {
+                    m_pluginTouches |= touchBit;
+                }
+                break;
+            case KMM_CONTACT_MOVE:
+                if (owned) {
+                    m_touchInjector->TouchMove(contact.x, contact.y, contact.touchId);
+                }
+                break;
+            case KMM_CONTACT_UP:
+                if (owned) {
+                    m_touchInjector->TouchUp(contact.touchId);
+                    m_pluginTouches &= ~touchBit;
+                }
+                break;
+        }
+    }
+    ArmTouchUpdates();
+    
+    if (handled && isDown && !isRepeat) {
+        ++m_mappedKeyDownCount;
+    }
+    return handled;
+}
+
+void Application::UpdatePlugins(bool loadNew) {
+    const std::vector<std::string>& paths = m_config->GetPluginPaths();
+    if (!m_plugins && paths.empty() && m_config->GetActionBindings().empty()) {
+        return;
+    }
+    if (!m_plugins) {
+        m_plugins = std::make_unique<PluginHost>();
+    }
+    
+    // DLLs are never unloaded while running: another profile may bind their actions again
+    for (const auto& path : paths) {
+        if (loadNew) {
+            m_plugins->Load(path);
+        } else if (!m_plugins->IsLoaded(path)) {
+            std::cerr << "Not loading plugin " << path
+                      << ": plugins load only from the startup config." << std::endl;
+        }
+    }
+    m_plugins->BindKeys(m_config->GetActionBindings());
+    UpdateKeyFilter();
+}
+
+void Application::ReleasePluginTouches() {
+    for (int touchId = 0; touchId < MAX_SIMULTANEOUS_TOUCHES; ++touchId) {
+        if (m_pluginTouches & (1 << touchId)) {
+            m_touchInjector->TouchUp(touchId);
+        }
+    }
+    m_pluginTouches = 0;
+}
+
+const KeyMapping* Application::FindBinding(int virtualKey) const {
+    uint32_t qualifiers = 0;
+    if (m_pressedKeys.Test(VK_CONTROL)) qualifiers |= BINDING_MOD_CTRL;
+    if (m_pressedKeys.Test(VK_SHIFT)) qualifiers |= BINDING_MOD_SHIFT;
+    if (m_pressedKeys.Test(VK_MENU)) qualifiers |= BINDING_MOD_ALT;
+    if (m_pressedKeys.Test(VK_LWIN) || m_pressedKeys.Test(VK_RWIN)) qualifiers |= BINDING_MOD_WIN;
+    if (m_keyboardHook->IsExtended(virtualKey)) qualifiers |= BINDING_EXTENDED;
+    
+    // Physical key (scancode) first, then the layout's virtual key
+    const KeyMapping* mapping = m_config->FindBinding(
+        qualifiers | BINDING_SCANCODE | static_cast<uint32_t>(m_keyboardHook->GetScanCode(virtualKey)));
+    if (mapping == nullptr) {
+        mapping = m_config->FindBinding(qualifiers | static_cast<uint32_t>(virtualKey));
+    }
+    return mapping;
+}
+
+void Application::StartTurbo(int virtualKey, const POINTER_TOUCH_INFO& contact, int touchId, int rateHz, int dutyPercent) {
+    TurboState& turbo = m_turbo[virtualKey];
+    if (turbo.active || rateHz <= 0) {
+        return;
+    }
+    
+    turbo.active = true;
+    turbo.touching = false;
+    turbo.contact = contact;
+    turbo.touchId = touchId;
+    turbo.periodUs = 1000000 / rateHz;
+    turbo.downUs = turbo.periodUs * dutyPercent / 100;
+    turbo.phaseStart = m_scheduler->Now();
+    turbo.taskId = 0;
+    
+    // First tap goes down immediately
+    OnTurboTask(virtualKey);
+}
+
+void Application::StopTurbo(int virtualKey) {
+    TurboState& turbo = m_turbo[virtualKey];
+    if (!turbo.active) {
+        return;
+    }
+    
+    if (turbo.taskId != 0) {
+        m_scheduler->Cancel(turbo.taskId);
+    }
+    if (turbo.touching) {
+        m_touchInjector->TouchUp(turbo.touchId);
+    }
+    turbo.active = false;
+    turbo.touching = false;
+    turbo.taskId = 0;
+    ReleaseKeyTouchId(virtualKey);
+}
+
+void Application::StopAllTurbo() {
+    for (int virtualKey = 0; virtualKey < 256; ++virtualKey) {
+        StopTurbo(virtualKey);
+    }
+}
+
+void Application::OnTurboTask(int virtualKey) {
+    TurboState& turbo = m_turbo[virtualKey];
+    turbo.taskId = 0;
+    if (!turbo.active) {
+        return;
+    }
+    
+    int64_t nextEdge;
+    if (!m_touchInjector->IsSupported()) {
+        // Mouse fallback has no separate down/up; one simulated click per period
+        m_touchInjector->TouchTap(turbo.contact, turbo.touchId);
+        turbo.phaseStart += turbo.periodUs;
+        nextEdge = turbo.phaseStart;
+    } else if (!turbo.touching) {
+        turbo.touching = m_touchInjector->TouchDown(turbo.contact, turbo.touchId);
+        nextEdge = turbo.phaseStart + turbo.downUs;
+    } else {
+        m_touchInjector->TouchUp(turbo.touchId);
+        turbo.touching = false;
+        turbo.phaseStart += turbo.periodUs;
+        nextEdge = turbo.phaseStart;
+    }
+    
+    // Edges are scheduled on an absolute grid so the rate does not drift;
+    // after a stall, skip the missed taps instead of bursting to catch up
+    int64_t now = m_scheduler->Now();
+    if (nextEdge + turbo.periodUs < now) {
+        turbo.phaseStart = now;
+        nextEdge = now;
+    }
+    
+    turbo.taskId = m_scheduler->Schedule(nextEdge, TurboTaskProc, this, virtualKey);
+}
+
+void Application::TurboTaskProc(void* context, int param) {
+    static_cast<Application*>(context)->OnTurboTask(param);
+}
+
+void Application::OnGamepadAxis(int axis, float x, float y) {
+    const AnalogMapping& analog = m_config->GetAnalogMapping(axis);
+    int touchId = ANALOG_TOUCH_ID(axis);
+    
+    // Back at rest (or nothing to drive): lift the contact
+    if (m_mode != AppMode::MAPPING || !analog.enabled || (x == 0.0f && y == 0.0f)) {
+        if (m_analogTouching[axis]) {
+            m_touchInjector->TouchUp(touchId);
+            m_analogTouching[axis] = false;
+        }
+        return;
+    }
+    
+    int targetX, targetY;
+    if (axis == GAMEPAD_LEFT_STICK || axis == GAMEPAD_RIGHT_STICK) {
+        // Stick y points up, screen y points down
+        targetX = analog.x + static_cast<int>(x * analog.radius);
+        targetY = analog.y - static_cast<int>(y * analog.radius);
+    } else {
+        targetX = analog.x + static_cast<int>(x * (analog.endX - analog.x));
+        targetY = analog.y + static_cast<int>(x * (analog.endY - analog.y));
+    }
+    
+    // The drag starts at the rest position, like a finger placed on a virtual stick
+    if (!m_analogTouching[axis]) {
+        m_analogTouching[axis] = m_touchInjector->TouchDown(analog.x, analog.y, touchId);
+        if (!m_analogTouching[axis]) {
+            return;
+        }
+        ArmTouchUpdates();
+    }
+    m_touchInjector->TouchMove(targetX, targetY, touchId);
+}
+
+void Application::ReleaseAnalogTouches() {
+    for (int axis = 0; axis < GAMEPAD_AXIS_COUNT; ++axis) {
+        if (m_analogTouching[axis]) {
+            m_touchInjector->TouchUp(ANALOG_TOUCH_ID(axis));
+            m_analogTouching[axis] = false;
+        }
+    }
+}
+
+void Application::SetMouseLook(bool active) {
+    if (!active) {
+        ReleaseMouseLook();
+        if (m_rawInput) {
+            m_rawInput->SetMouseEnabled(false);
+        }
+        if (m_mouseLookActive) {
+            if (m_simulatedClock == nullptr) {
+                ClipCursor(nullptr);
+            }
+            std::cout << "Mouse look: OFF" << std::endl;
+        }
+        m_mouseLookActive = false;
+        return;
+    }
+    
+    if (!m_config->GetMouseLookMapping().enabled) {
+        std::cout << "No mouse look region (set mouselook=LEFT TOP RIGHT BOTTOM SENSITIVITY in the config)." << std::endl;
+        return;
+    }
+    if (m_mode != AppMode::MAPPING) {
+        std::cout << "Mouse look works in mapping mode only." << std::endl;
+        return;
+    }
+    
+    // A simulated run gets its motion from ReplayMouseMotion and leaves the cursor alone
+    if (m_simulatedClock == nullptr) {
+        // Raw input is set up for the mouse alone if no device needed it for keys
+        if (!m_rawInput) {
+            m_rawInput = std::make_unique<RawInputRouter>();
+            if (!m_rawInput->Initialize(false)) {
+                m_rawInput.reset();
+                return;
+            }
+        }
+        m_rawInput->SetMouseHandler<Application, &Application::OnMouseMotion>(this);
+        if (!m_rawInput->SetMouseEnabled(true)) {
+            return;
+        }
+        
+        // Hold the cursor in place: raw motion still arrives, but nothing gets clicked by accident
+        POINT cursorPos;
+        GetCursorPos(&cursorPos);
+        RECT lockRect = { cursorPos.x, cursorPos.y, cursorPos.x + 1, cursorPos.y + 1 };
+        ClipCursor(&lockRect);
+    }
+    
+    m_mouseLookActive = true;
+    std::cout << "Mouse look: ON (Ctrl+Shift+L to release the mouse)" << std::endl;
+}
+
+void Application::OnMouseMotion(int dx, int dy) {
+    if (!m_mouseLookActive) {
+        return;
+    }
+    ++m_mouseMotionCount;
+    m_mouseLookDx += dx;
+    m_mouseLookDy += dy;
+    
+    // Motion is summed until the next move. With frame pacing the injector already
+    // merges moves into one frame, so they are applied as they come; otherwise at
+    // most once per interval, however fast the mouse reports.
+    if (m_mouseLookTask == 0) {
+        int64_t interval = m_framePacer ? 0 : MOUSE_LOOK_INTERVAL_US;
+        int64_t due = std::max(m_lastMouseLookUs + interval, m_scheduler->Now());
+        m_mouseLookTask = m_scheduler->Schedule(due, MouseLookTaskProc, this, 0, false);
+    }
+}
+
+void Application::OnMouseLookTask() {
+    m_mouseLookTask = 0;
+    m_lastMouseLookUs = m_scheduler->Now();
+    
+    int dx = m_mouseLookDx;
+    int dy = m_mouseLookDy;
+    m_mouseLookDx = 0;
+    m_mouseLookDy = 0;
+    if (!m_mouseLookActive || (dx == 0 && dy == 0)) {
+        return;
+    }
+    ++m_mouseLookMoveCount;
+    
+    // The finger goes down at the center of the region
+    const MouseLookMapping& region = m_config->GetMouseLookMapping();
+    if (!m_mouseLookTouching) {
+        m_mouseLookX = static_cast<float>(region.left + region.right) / 2.0f;
+        m_mouseLookY = static_cast<float>(region.top + region.bottom) / 2.0f;
+        m_mouseLookTouching = m_touchInjector->TouchDown(static_cast<int>(m_mouseLookX),
+                                                         static_cast<int>(m_mouseLookY), MOUSE_LOOK_TOUCH_ID);
+        if (!m_mouseLookTouching) {
+            return;
+        }
+        ArmTouchUpdates();
+    }
+    
+    float scale = region.sensitivityPercent / 100.0f;
+    m_mouseLookX += dx * scale;
+    m_mouseLookY += dy * scale;
+    
+    // At an edge the finger lifts; the next motion puts it down at the center again
+    bool atEdge = (m_mouseLookX < region.left || m_mouseLookX >= region.right ||
+                   m_mouseLookY < region.top || m_mouseLookY >= region.bottom);
+    if (atEdge) {
+        m_mouseLookX = std::min(std::max(m_mouseLookX, static_cast<float>(region.left)),
+                                static_cast<float>(region.right - 1));
+        m_mouseLookY = std::min(std::max(m_mouseLookY, static_cast<float>(region.top)),
+                                static_cast<float>(region.bottom - 1));
+    }
+    m_touchInjector->TouchMove(static_cast<int>(m_mouseLookX), static_cast<int>(m_mouseLookY), MOUSE_LOOK_TOUCH_ID);
+    if (atEdge) {
+        m_touchInjector->TouchUp(MOUSE_LOOK_TOUCH_ID);
+        m_mouseLookTouching = false;
+    }
+}
+
+void Application::MouseLookTaskProc(void* context, int param) {
+    static_cast<Application*>(context)->OnMouseLookTask();
+}
+
+void Application::ReleaseMouseLook() {
+    if (m_mouseLookTask != 0) {
+        m_scheduler->Cancel(m_mouseLookTask);
+        m_mouseLookTask = 0;
+    }
+    m_mouseLookDx = 0;
+    m_mouseLookDy = 0;
+    if (m_mouseLookTouching) {
+        m_touchInjector->TouchUp(MOUSE_LOOK_TOUCH_ID);
+        m_mouseLookTouching = false;
+    }
+}
+
+void Application::UpdateGamepadPolling() {
+    if (!m_gamepad) {
+        return;
+    }
+    
+    // Idle mode ignores every gamepad input, so the controller is not read at all
+    bool wanted = (m_mode != AppMode::IDLE);
+    if (wanted && m_gamepadPollTask == 0) {
+        m_gamepadPollTask = m_scheduler->Schedule(m_scheduler->Now(), GamepadPollTaskProc, this, 0, false);
+    } else if (!wanted && m_gamepadPollTask != 0) {
+        m_scheduler->Cancel(m_gamepadPollTask);
+        m_gamepadPollTask = 0;
+    }
+}
+
+void Application::OnGamepadPoll() {
+    m_gamepadPollTask = 0;
+    
+    int64_t now = m_scheduler->Now();
+    int64_t interval = m_gamepad->Poll(now);
+    
+    // Polling is timing-tolerant: skipping the spin keeps a 1 kHz poll cheap
+    if (m_mode != AppMode::IDLE && m_gamepadPollTask == 0) {
+        m_gamepadPollTask = m_scheduler->Schedule(now + interval, GamepadPollTaskProc, this, 0, false);
+    }
+}
+
+void Application::GamepadPollTaskProc(void* context, int param) {
+    static_cast<Application*>(context)->OnGamepadPoll();
+}
+
+std::string Application::OnControlCommand(const std::string& command) {
+    ++m_controlCommandCount;
+    RequestStatsPublish();
+    
+    std::istringstream iss(command);
+    std::string verb;
+    iss >> verb;
+    
+    if (verb == "mode") {
+        std::string mode;
+        iss >> mode;
+        if (mode == "recording") {
+            SetMode(AppMode::RECORDING);
+        } else if (mode == "mapping") {
+            SetMode(AppMode::MAPPING);
+        } else if (mode == "idle") {
+            SetMode(AppMode::IDLE);
+        } else {
+            return "ERR mode must be recording, mapping or idle";
+        }
+        return "OK";
+    }
+    
+    if (verb == "map") {
+        int virtualKey, x, y;
+        if (!(iss >> virtualKey >> x >> y) || virtualKey < 0 || virtualKey > 255) {
+            return "ERR usage: map VK X Y [NAME]";
+        }
+        std::string keyName;
+        std::getline(iss >> std::ws, keyName);
+        if (keyName.empty()) {
+            keyName = "VK_" + std::to_string(virtualKey);
+        }
+        if (!m_config->SaveMapping(virtualKey, x, y, keyName)) {
+            return "ERR mapping not saved";
+        }
+        UpdateKeyFilter();
+        RefreshOverlay();
+        return "OK";
+    }
+    
+    if (verb == "unmap") {
+        int virtualKey;
+        if (!(iss >> virtualKey) || virtualKey < 0 || virtualKey > 255) {
+            return "ERR usage: unmap VK";
+        }
+        // A held key still gets its touch up through m_heldKeys
+        if (!m_config->RemoveMapping(virtualKey)) {
+            return "ERR key not mapped";
+        }
+        UpdateKeyFilter();
+        RefreshOverlay();
+        return "OK";
+    }
+    
+    if (verb == "layer") {
+        std::string name, state;
+        iss >> name >> state;
+        for (int layer = 1; layer < m_config->GetLayerCount(); ++layer) {
+            if (m_config->GetLayer(layer).name == name) {
+                m_config->SetLayerActive(layer, state != "off");
+                RefreshOverlay();
+                return "OK";
+            }
+        }
+        return "ERR no such layer";
+    }
+    
+    if (verb == "profile") {
+        std::string configFile;
+        std::getline(iss >> std::ws, configFile);
+        if (configFile.empty()) {
+            return "OK " + m_config->GetConfigFile();
+        }
+        return SwitchProfile(configFile) ? "OK" : "ERR profile not loaded";
+    }
+    
+    if (verb == "reload") {
+        return SwitchProfile(m_config->GetConfigFile()) ? "OK" : "ERR profile not loaded";
+    }
+    
+    if (verb == "status") {
+        std::ostringstream reply;
+        reply << "OK mode=" << (m_mode == AppMode::RECORDING ? "recording" :
+                                m_mode == AppMode::MAPPING ? "mapping" : "idle")
+              << " profile=" << m_config->GetConfigFile()
+              << " mappings=" << m_config->GetActiveMappings().size()
+              << " keys=" << m_keyEventCount
+              << " p99_us=" << m_keyLatency.Percentile(0.99);
+        return reply.str();
+    }
+    
+    if (verb == "quit") {
+        m_running = false;
+        PostQuitMessage(0);
+        return "OK";
+    }
+    
+    return "ERR commands: mode, map, unmap, layer, profile, reload, status, quit";
+}
+
+bool Application::SwitchProfile(const std::string& configFile) {
+    // Mappings held now may not exist in the new profile
+    StopAllTurbo();
+    ReleaseAnalogTouches();
+    ReleasePluginTouches();
+    if (m_mouseLookActive) {
+        SetMouseLook(false);
+    }
+    ReleaseHeldKeyTouches();
+    m_touchInjector->ReleaseAllTouches();
+    
+    // Usage belongs to the profile it was counted in
+    if (m_usage) {
+        WriteUsageSnapshot();
+    }
+    
+    if (!m_config->SetConfigFile(configFile)) {
+        return false;
+    }
+    if (m_usage) {
+        m_usage->Reset();
+    }
+    
+    // Per-key options apply from the next event. Device sections, frame pacing and
+    // the gamepad, pipe, event stream and usage settings take effect on the next start.
+    Tracer::SetEnabled(m_config->IsTraceEnabled());
+    RebuildChords();
+    UpdateReservedTouchIds();
+    UpdatePlugins(false);
+    UpdateKeyFilter();
+    UpdateTargetWindow();
+    RefreshOverlay();
+    std::cout << "Loaded profile: " << configFile << std::endl;
+    return true;
+}
+
+void Application::OnStatsPublish() {
+    StatsPageData data;
+    memset(&data, 0, sizeof(data));
+    
+    data.publishTimeUs = m_scheduler->Now();
+    data.mode = static_cast<uint32_t>(m_mode);
+    for (int layer = 0; layer < m_config->GetLayerCount(); ++layer) {
+        if (m_config->IsLayerActive(layer)) {
+            data.activeLayers |= 1u << layer;
+        }
+    }
+    data.mappingCount = static_cast<uint32_t>(m_config->GetAllMappings().size());
+    
+    data.keyEvents = m_keyEventCount;
+    data.mappedKeyDowns = m_mappedKeyDownCount;
+    data.controlCommands = m_controlCommandCount;
+    if (m_framePacer) {
+        data.frameFlushes = m_framePacer->GetFlushCount();
+        data.lateFrames = m_framePacer->GetLateFlushCount();
+    }
+    data.schedulerMaxLatenessUs = m_scheduler->GetMaxLatenessUs();
+    
+    data.latencyCount = m_keyLatency.GetCount();
+    data.latencyP50Us = m_keyLatency.Percentile(0.5);
+    data.latencyP99Us = m_keyLatency.Percentile(0.99);
+    data.latencyP999Us = m_keyLatency.Percentile(0.999);
+    data.latencyMaxUs = m_keyLatency.GetMaxUs();
+    memcpy(data.latencyBuckets, m_keyLatency.GetBuckets(), sizeof(data.latencyBuckets));
+    
+    const HookHealth& health = m_keyboardHook->GetHealth();
+    data.hookCallbacks = health.callbacks;
+    data.hookSlowCallbacks = health.slowCallbacks;
+    data.hookMaxCallbackUs = health.maxCallbackUs;
+    data.hookReinstalls = health.reinstalls;
+    data.hookOrphanedKeys = health.orphanedKeys;
+    
+    data.wakeups = m_wakeupCount;
+    data.timerWakeups = m_timerWakeupCount;
+    
+    m_statsPage->Publish(data);
+    m_lastStatsPublish = data.publishTimeUs;
+}
+
+void Application::RequestStatsPublish() {
+    if (!m_statsPage || m_statsPublishTask != 0) {
+        return;
+    }
+    
+    // At most one update per interval; the last change is always published
+    int64_t due = m_lastStatsPublish + STATS_PUBLISH_INTERVAL_US;
+    m_statsPublishTask = m_scheduler->Schedule(std::max(due, m_scheduler->Now()),
+                                               StatsPublishTaskProc, this, 0, false);
+}
+
+void Application::StatsPublishTaskProc(void* context, int param) {
+    Application* app = static_cast<Application*>(context);
+    app->m_statsPublishTask = 0;
+    app->OnStatsPublish();
+}
+
+void Application::OnHookWatchdog() {
+    // Orphaned keys get their key-up through OnKeyEvent, which lifts their
+    // touches and stops their turbo and chords like a real release
+    m_hookWatchdogTask = 0;
+    if (m_keyboardHook->CheckHealth() > 0) {
+        RequestStatsPublish();
+    }
+    
+    // Check often while the hook holds keys (their key-ups could be lost), rarely otherwise
+    ArmHookWatchdog(m_keyboardHook->HasHeldKeys() ? HOOK_WATCHDOG_INTERVAL_US : HOOK_IDLE_WATCHDOG_INTERVAL_US);
+}
+
+void Application::ArmHookWatchdog(int64_t intervalUs) {
+    if (!m_scheduler->CanRunTasks()) {
+        return;
+    }
+    
+    // An earlier pending check already covers this one
+    int64_t due = m_scheduler->Now() + intervalUs;
+    if (m_hookWatchdogTask != 0) {
+        if (m_hookWatchdogDue <= due) {
+            return;
+        }
+        m_scheduler->Cancel(m_hookWatchdogTask);
+    }
+    m_hookWatchdogDue = due;
+    m_hookWatchdogTask = m_scheduler->Schedule(due, HookWatchdogTaskProc, this, 0, false);
+}
+
+void Application::HookWatchdogTaskProc(void* context, int param) {
+    static_cast<Application*>(context)->OnHookWatchdog();
+}
+
+void Application::OnUsageTask() {
+    int64_t now = m_scheduler->Now();
+    m_usageTask = 0;
+    
+    bool heatmapShown = m_heatmapEnabled && m_overlay->IsVisible();
+    if (heatmapShown) {
+        m_overlay->Redraw();
+    }
+    if (m_usageDirty && now - m_usageSnapshotTime >= USAGE_SNAPSHOT_INTERVAL_US) {
+        WriteUsageSnapshot();
+        m_usageSnapshotTime = now;
+        m_usageDirty = false;
+    }
+    
+    // The shown heatmap refreshes every second; otherwise only unsaved counts need a run
+    if (heatmapShown) {
+        m_usageTask = m_scheduler->Schedule(now + HEATMAP_REFRESH_INTERVAL_US, UsageTaskProc, this, 0, false);
+    } else if (m_usageDirty) {
+        m_usageTask = m_scheduler->Schedule(m_usageSnapshotTime + USAGE_SNAPSHOT_INTERVAL_US,
+                                            UsageTaskProc, this, 0, false);
+    }
+}
+
+void Application::UsageTaskProc(void* context, int param) {
+    static_cast<Application*>(context)->OnUsageTask();
+}
+
+void Application::WriteUsageSnapshot() {
+    m_usage->WriteSnapshot(GetConfigSidecarPath("_usage.txt"), m_config->GetResolvedMappings());
+    m_usageDirty = false;
+}
+
+void Application::WriteTrace() {
+    Tracer::WriteChromeTrace(GetConfigSidecarPath("_trace.json"));
+}
+
+std::string Application::GetConfigSidecarPath(const char* suffix) const {
+    std::string path = m_config->GetConfigFile();
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("\\/");
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) {
+        path.erase(dot);
+    }
+    return path + suffix;
+}
+
+void Application::ScheduleFrameFlush() {
+    if (!m_framePacer || m_frameFlushTask != 0 || !m_touchInjector->HasPendingFrames()) {
+        return;
+    }
+    
+    m_frameFlushTarget = m_framePacer->NextFlushTime(m_scheduler->Now());
+    m_frameFlushTask = m_scheduler->Schedule(m_frameFlushTarget, FrameFlushTaskProc, this, 0);
+}
+
+void Application::OnFrameFlush() {
+    m_frameFlushTask = 0;
+    
+    int64_t now = m_scheduler->Now();
+    m_touchInjector->FlushFrame();
+    m_framePacer->RecordFlush(m_frameFlushTarget, now);
+    m_framePacer->Resync(now);
+    
+    // Remaining frames go out one per refresh
+    ScheduleFrameFlush();
+}
+
+void Application::FrameFlushTaskProc(void* context, int param) {
+    static_cast<Application*>(context)->OnFrameFlush();
+}
+
+void Application::ResolvePendingKeys() {
+    if (m_chordResolveTask != 0) {
+        m_scheduler->Cancel(m_chordResolveTask);
+        m_chordResolveTask = 0;
+    }
+    
+    KeyBitset pending = m_pendingKeys;
+    m_pendingKeys.Reset();
+    
+    if (m_mode != AppMode::MAPPING) {
+        return;
+    }
+    
+    // No chord completed in time: the held keys act on their own
+    for (int virtualKey = 0; virtualKey < 256; ++virtualKey) {
+        if (pending.Test(virtualKey) && m_pressedKeys.Test(virtualKey)) {
+            HandleMappedKey(virtualKey, true, false);
+        }
+    }
+}
+
+void Application::UpdateKeyFilter() {
+    KeyBitset keys;
+    
+    if (m_mode == AppMode::RECORDING) {
+        // Any key can be recorded
+        keys.SetAll();
+    } else {
+        // Control hotkeys work in every mode
+        static const int hotkeys[] = { 'R', 'M', 'I', 'D', 'C', 'Q', 'H', 'T', 'U', 'E', 'L', 'P', VK_DELETE };
+        for (int hotkey : hotkeys) {
+            keys.Set(hotkey);
+        }
+        
+        if (m_mode == AppMode::MAPPING) {
+            // Every layer, not just the active ones, so layer switches need no update
+            keys.Merge(m_config->GetMappedKeys());
+            keys.Merge(m_config->GetBindingKeys());
+            keys.Merge(m_chordMatcher.GetMembers());
+            if (m_plugins) {
+                keys.Merge(m_plugins->GetActionKeys());
+            }
+            
+            // Bindings need their modifiers seen (FindBinding reads the pressed
+            // set) and chords use generic modifier codes; the hook reports left/right ones
+            if (keys.Test(VK_SHIFT)) { keys.Set(VK_LSHIFT); keys.Set(VK_RSHIFT); }
+            if (keys.Test(VK_CONTROL)) { keys.Set(VK_LCONTROL); keys.Set(VK_RCONTROL); }
+            if (keys.Test(VK_MENU)) { keys.Set(VK_LMENU); keys.Set(VK_RMENU); }
+        }
+    }
+    
+    m_keyboardHook->SetKeyFilter(keys);
+    
+    // Device-specific keys are only routed by device while mapping
+    m_deviceRoutedKeys.Reset();
+    if (m_rawInput && m_mode == AppMode::MAPPING) {
+        m_deviceRoutedKeys = m_config->GetDeviceMappedKeys();
+    }
+    
+    // While mapping, mapped keys are swallowed by the hook so the focused
+    // application only sees the touches (bound keys only when a binding
+    // fires, see HandleMappedKey)
+    KeyBitset consume;
+    if (m_mode == AppMode::MAPPING && m_config->IsConsumeMappedKeysEnabled()) {
+        consume.Merge(m_config->GetMappedKeys());
+        consume.Merge(m_chordMatcher.GetMembers());
+        if (m_plugins) {
+            consume.Merge(m_plugins->GetActionKeys());
+        }
+        
+        // Modifiers always pass (system shortcuts and the control hotkeys need them)
+        static const int modifiers[] = {
+            VK_SHIFT, VK_LSHIFT, VK_RSHIFT, VK_CONTROL, VK_LCONTROL, VK_RCONTROL,
+            VK_MENU, VK_LMENU, VK_RMENU, VK_LWIN, VK_RWIN
+        };
+        for (int modifier : modifiers) {
+            consume.Clear(modifier);
+        }
+        
+        // Swallowing in the hook would also hide device-routed keys from raw input
+        consume.Remove(m_deviceRoutedKeys);
+    }
+    m_keyboardHook->SetConsumeKeys(consume);
+    if (m_rawInput) {
+        m_rawInput->SetKeyFilter(m_deviceRoutedKeys);
+    }
+}
+
+void Application::RebuildChords() {
+    // Chord IDs change on rebuild, so release anything still held
+    ReleaseChordTouches();
+    m_pendingKeys.Reset();
+    
+    std::vector<KeyBitset> masks;
+    for (const auto& chord : m_config->GetAllChords()) {
+        masks.push_back(chord.keys);
+    }
+    m_chordMatcher.Build(masks);
+}
+
+void Application::ReleaseHeldKeyTouches() {
+    for (int virtualKey = 0; virtualKey < 256; ++virtualKey) {
+        if (m_heldKeys.Test(virtualKey)) {
+            m_touchInjector->TouchUp(m_keyTouchIds[virtualKey]);
+            ReleaseKeyTouchId(virtualKey);
+        }
+    }
+    m_heldKeys.Reset();
+}
+
+void Application::ReleaseChordTouches() {
+    for (int i = 0; i < m_activeChordCount; ++i) {
+        int triggerKey = m_activeChords[i].triggerKey;
+        if (m_turbo[triggerKey].active) {
+            StopTurbo(triggerKey);
+        } else {
+            m_touchInjector->TouchUp(m_keyTouchIds[triggerKey]);
+            ReleaseKeyTouchId(triggerKey);
+        }
+    }
+    m_activeChordCount = 0;
+}
+
+int Application::AcquireKeyTouchId(int virtualKey) {
+    if (m_keyTouchIds[virtualKey] >= 0) {
+        return m_keyTouchIds[virtualKey];
+    }
+    
+    // Skip IDs held by other keys, reserved or plugin contacts, and taps not lifted yet
+    int busy = m_keyTouchMask | m_reservedTouchIds | m_pluginTouches;
+    for (int touchId = 0; touchId < MAX_SIMULTANEOUS_TOUCHES; ++touchId) {
+        if (!(busy & (1 << touchId)) && !m_touchInjector->IsTouchActive(touchId)) {
+            m_keyTouchIds[virtualKey] = touchId;
+            m_keyTouchMask |= 1 << touchId;
+            return touchId;
+        }
+    }
+    return -1;
+}
+
+void Application::ReleaseKeyTouchId(int virtualKey) {
+    int touchId = m_keyTouchIds[virtualKey];
+    if (touchId >= 0) {
+        m_keyTouchMask &= ~(1 << touchId);
+        m_keyTouchIds[virtualKey] = -1;
+    }
+}
+
+void Application::UpdateReservedTouchIds() {
+    m_reservedTouchIds = 0;
+    for (int axis = 0; axis < GAMEPAD_AXIS_COUNT; ++axis) {
+        if (m_config->GetAnalogMapping(axis).enabled) {
+            m_reservedTouchIds |= 1 << ANALOG_TOUCH_ID(axis);
+        }
+    }
+    if (m_config->GetMouseLookMapping().enabled) {
+        m_reservedTouchIds |= 1 << MOUSE_LOOK_TOUCH_ID;
+    }
+}
+
+void Application::ChordResolveTaskProc(void* context, int param) {
+    Application* app = static_cast<Application*>(context);
+    app->m_chordResolveTask = 0;
+    app->ResolvePendingKeys();
+}
+
+void Application::SetMode(AppMode mode) {
+    m_mode = mode;
+    if (mode == AppMode::MAPPING && m_overlay && m_overlay->IsEditMode()) {
+        m_overlay->SetEditMode(false);
+        std::cout << "Overlay edit mode: OFF" << std::endl;
+    }
+    m_pendingKeys.Reset();
+    UpdateKeyFilter();
+    
+    // Touches must not outlive mapping mode: keys released after the switch
+    // are not mapped any more, and turbo keeps tapping on its own
+    if (mode != AppMode::MAPPING) {
+        ReleaseChordTouches();
+        ReleaseHeldKeyTouches();
+        StopAllTurbo();
+        ReleaseAnalogTouches();
+        ReleasePluginTouches();
+        if (m_mouseLookActive) {
+            SetMouseLook(false);
+        }
+    }
+    UpdateGamepadPolling();
+    if (m_windowTracker && !m_windowTracker->IsAttached()) {
+        UpdateTargetWindow();
+    }
+    ArmTouchUpdates();
+    RequestStatsPublish();
+    PrintStatus();
+}
+
+void Application::PrintStatus() {
+    std::cout << "\n--- Current Status ---" << std::endl;
+    std::cout << "Mode: ";
+    switch (m_mode) {
+        case AppMode::RECORDING:
+            std::cout << "RECORDING - Press keys to record their positions" << std::endl;
+            break;
+        case AppMode::MAPPING:
+            std::cout << "MAPPING - Press keys to trigger touch events" << std::endl;
+            break;
+        case AppMode::IDLE:
+            std::cout << "IDLE - No action on key press" << std::endl;
+            break;
+    }
+    
+    std::cout << "Display: " << (m_displayEnabled ? "ON" : "OFF") << std::endl;
+    std::cout << "Hold behavior: " << (m_config->GetHoldTriggersContinuousTap() ? "Continuous Tap" : "Maintain Touch") << std::endl;
+    std::cout << "Mappings: " << m_config->GetAllMappings().size() << " keys configured" << std::endl;
+    std::cout << "Chords: " << m_config->GetAllChords().size() << " configured" << std::endl;
+    
+    if (m_config->GetLayerCount() > 1) {
+        std::cout << "Layers:";
+        for (int layer = 1; layer < m_config->GetLayerCount(); ++layer) {
+            std::cout << " " << m_config->GetLayer(layer).name
+                      << (m_config->IsLayerActive(layer) ? "(ON)" : "(off)");
+        }
+        std::cout << std::endl;
+    }
+    
+    if (m_config->GetDeviceCount() > 0) {
+        std::cout << "Devices:";
+        for (int device = 1; device <= m_config->GetDeviceCount(); ++device) {
+            std::cout << " " << m_config->GetDevice(device).alias << "("
+                      << m_config->GetDevice(device).mappings.size() << " keys, "
+                      << (m_rawInput && m_rawInput->IsDeviceConnected(device) ? "seen" : "not seen") << ")";
+        }
+        std::cout << std::endl;
+    }
+    
+    if (m_touchInjector && m_touchInjector->IsSupported()) {
+        std::cout << "Touch: Multi-point touch injection supported" << std::endl;
+    } else {
+        std::cout << "Touch: Using mouse simulation fallback" << std::endl;
+    }
+    
+    if (m_control || m_statsPage) {
+        std::cout << "Control: " << (m_control ? CONTROL_PIPE_NAME : "no pipe") << ", "
+                  << (m_statsPage ? STATS_PAGE_NAME : "no stats page") << std::endl;
+    }
+    
+    if (m_eventStream) {
+        std::cout << "Event stream: " << EVENT_STREAM_NAME << ", "
+                  << m_eventStream->GetData()->header.writeSequence - 1 << " records written" << std::endl;
+    }
+    
+    if (!m_config->GetTargetWindowTitle().empty()) {
+        std::cout << "Target window: \"" << m_config->GetTargetWindowTitle() << "\" "
+                  << (m_windowTracker && m_windowTracker->IsAttached() ? "followed" : "not found") << std::endl;
+    }
+    
+    if (m_config->GetMouseLookMapping().enabled) {
+        std::cout << "Mouse look: " << (m_mouseLookActive ? "ON" : "OFF") << ", " << m_mouseMotionCount
+                  << " motion reports in " << m_mouseLookMoveCount << " moves" << std::endl;
+    }
+    
+    if (m_usage) {
+        std::cout << "Usage stats: ON, heatmap " << (m_heatmapEnabled ? "ON" : "OFF") << std::endl;
+    }
+    
+    if (m_plugins) {
+        std::cout << "Plugins: " << m_plugins->GetPluginCount() << " loaded, "
+                  << m_plugins->GetActionKeys().Count() << " keys bound" << std::endl;
+        for (int action = 0; action < m_plugins->GetActionCount(); ++action) {
+            const PluginActionStats& stats = m_plugins->GetActionStats(action);
+            std::cout << "  " << m_plugins->GetActionName(action) << ": " << stats.calls << " calls";
+            if (stats.calls > 0) {
+                std::cout << ", avg " << stats.totalUs / static_cast<int64_t>(stats.calls)
+                          << " us, max " << stats.maxUs << " us";
+            }
+            std::cout << std::endl;
+        }
+    }
+    
+    if (Tracer::IsEnabled()) {
+        std::cout << "Tracing: " << Tracer::GetSpanCount() << " spans";
+        if (Tracer::GetDroppedCount() > 0) {
+            std::cout << ", " << Tracer::GetDroppedCount() << " dropped";
+        }
+        std::cout << " (Ctrl+Shift+P writes " << GetConfigSidecarPath("_trace.json") << ")" << std::endl;
+    }
+    
+    if (m_gamepad) {
+        std::cout << "Gamepad: " << (m_gamepad->IsConnected() ? "connected" : "not connected")
+                  << ", " << m_gamepad->GetPollCount() << " polls" << std::endl;
+    }
+    
+    std::cout << "Wake-ups: " << m_wakeupCount << " (" << m_timerWakeupCount << " timer)" << std::endl;
+    
+    if (m_framePacer) {
+        std::cout << "Frame pacing: " << m_framePacer->GetRefreshPeriodUs() << " us refresh, "
+                  << m_framePacer->GetLeadUs() << " us lead, phase error mean "
+                  << m_framePacer->GetMeanPhaseErrorUs() << " us / max "
+                  << m_framePacer->GetMaxPhaseErrorUs() << " us, "
+                  << m_framePacer->GetLateFlushCount() << " of "
+                  << m_framePacer->GetFlushCount() << " frames late, max vblank drift "
+                  << m_framePacer->GetMaxDriftUs() << " us" << std::endl;
+    }
+    
+    std::cout << "----------------------\n" << std::endl;
+}
+
+void Application::PrintHelp() {
+    std::cout << "\n=== Keyboard Shortcuts ===" << std::endl;
+    std::cout << "Ctrl+Shift+R : Enter RECORDING mode" << std::endl;
+    std::cout << "Ctrl+Shift+M : Enter MAPPING mode" << std::endl;
+    std::cout << "Ctrl+Shift+I : Enter IDLE mode" << std::endl;
+    std::cout << "Ctrl+Shift+D : Toggle display overlay" << std::endl;
+    std::cout << "Ctrl+Shift+T : Toggle hold behavior (hold touch vs repeated taps)" << std::endl;
+    std::cout << "Ctrl+Shift+U : Toggle usage heatmap on the overlay" << std::endl;
+    std::cout << "Ctrl+Shift+L : Toggle mouse look (mouse drags a touch, mapping mode)" << std::endl;
+    std::cout << "Ctrl+Shift+E : Toggle overlay edit mode (drag to move, right-click to delete)" << std::endl;
+    std::cout << "Ctrl+Shift+P : Write the input trace (trace=1 in the config)" << std::endl;
+    std::cout << "Ctrl+Shift+C : Clear all mappings" << std::endl;
+    std::cout << "Ctrl+Shift+H : Show this help" << std::endl;
+    std::cout << "Ctrl+Shift+Q : Quit application" << std::endl;
+    std::cout << "==========================\n" << std::endl;
+}
+
+void Application::OnOverlayEdit(int virtualKey, int x, int y, bool remove) {
+    // Committed once per drop or delete, so the config file is written once per edit
+    m_config->FromScreen(x, y);
+    const KeyMapping* mapping = m_config->GetMapping(virtualKey);
+    std::string keyName = (mapping != nullptr) ? mapping->keyName : ConfigManager::GetKeyName(virtualKey);
+    if (remove) {
+        if (m_config->RemoveMapping(virtualKey)) {
+            UpdateKeyFilter();
+            std::cout << "Removed mapping [" << keyName << "]" << std::endl;
+        }
+    } else if (m_config->MoveMapping(virtualKey, x, y)) {
+        std::cout << "Moved key [" << keyName << "] to position (" << x << ", " << y << ")" << std::endl;
+    }
+    RefreshOverlay();
+}
+
+void Application::UpdateTargetWindow() {
+    if (m_windowSearchTask != 0) {
+        m_scheduler->Cancel(m_windowSearchTask);
+        m_windowSearchTask = 0;
+    }
+    
+    // A simulated run has no windows to follow: placements come from ReplayWindowPlacement
+    const std::string& title = m_config->GetTargetWindowTitle();
+    if (title.empty() || m_simulatedClock != nullptr) {
+        m_windowTracker.reset();
+        return;
+    }
+    if (!m_windowTracker) {
+        m_windowTracker = std::make_unique<WindowTracker>();
+        m_windowTracker->SetPlacementHandler<Application, &Application::OnWindowPlacement>(this);
+    }
+    
+    // Still following the same window: a reloaded profile starts unplaced, so place it again
+    if (m_windowTracker->IsAttached() && m_windowTracker->GetTitlePart() == title) {
+        OnWindowPlacement(m_windowTracker->GetClientArea());
+        return;
+    }
+    
+    if (m_windowTracker->Attach(title)) {
+        const RECT& client = m_windowTracker->GetClientArea();
+        std::cout << "Target window \"" << title << "\" at (" << client.left << ", " << client.top << "), "
+                  << client.right - client.left << " x " << client.bottom - client.top << std::endl;
+        return;
+    }
+    
+    // Not open yet: look again while recording or mapping (idle stays free of timers)
+    std::cout << "Target window \"" << title << "\" not found; positions stay on screen until it opens." << std::endl;
+    if (m_mode != AppMode::IDLE && m_scheduler->GetWaitHandle() != nullptr) {
+        m_windowSearchTask = m_scheduler->Schedule(m_scheduler->Now() + WINDOW_SEARCH_INTERVAL_US,
+                                                   WindowSearchTaskProc, this, 0, false);
+    }
+}
+
+void Application::OnWindowPlacement(const RECT& client) {
+    // The window closed: look for it again
+    if (IsRectEmpty(&client)) {
+        if (m_mode != AppMode::IDLE && m_windowSearchTask == 0 && m_scheduler->GetWaitHandle() != nullptr) {
+            m_windowSearchTask = m_scheduler->Schedule(m_scheduler->Now() + WINDOW_SEARCH_INTERVAL_US,
+                                                       WindowSearchTaskProc, this, 0, false);
+        }
+        return;
+    }
+    
+    // Contacts are rebuilt once per move or resize; touches keep reading them as before
+    m_config->SetTargetWindowRect(client);
+    RefreshOverlay();
+}
+
+void Application::WindowSearchTaskProc(void* context, int param) {
+    Application* app = static_cast<Application*>(context);
+    app->m_windowSearchTask = 0;
+    if (app->m_mode == AppMode::IDLE) {
+        return;
+    }
+    if (!app->m_windowTracker->Attach(app->m_config->GetTargetWindowTitle())) {
+        app->m_windowSearchTask = app->m_scheduler->Schedule(app->m_scheduler->Now() + WINDOW_SEARCH_INTERVAL_US,
+                                                             WindowSearchTaskProc, app, 0, false);
+        return;
+    }
+    std::cout << "Target window found." << std::endl;
+}
+
+void Application::RefreshOverlay() {
+    // A hidden overlay is brought up to date when it is shown
+    if (m_displayEnabled) {
+        m_overlay->SetMappings(m_config->GetResolvedMappings());
+    }
+}
+
+void Application::TouchUpdateTaskProc(void* context, int param) {
+    Application* app = static_cast<Application*>(context);
+    app->m_touchUpdateTask = 0;
+    app->UpdateActiveTouches();
+    app->ArmTouchUpdates();
+}
+
+void Application::ArmTouchUpdates() {
+    if (m_touchUpdateTask != 0 || !m_scheduler->CanRunTasks() || !HasHeldTouches()) {
+        return;
+    }
+    m_touchUpdateTask = m_scheduler->Schedule(m_scheduler->Now() + TOUCH_UPDATE_INTERVAL_US,
+                                              TouchUpdateTaskProc, this, 0, false);
+}
+
+bool Application::HasHeldTouches() const {
+    // Turbo touches are too short to need updates
+    if (m_mode != AppMode::MAPPING) {
+        return false;
+    }
+    if (!m_heldKeys.Empty()) {
+        return true;
+    }
+    for (int i = 0; i < m_activeChordCount; ++i) {
+        if (!m_turbo[m_activeChords[i].triggerKey].active) {
+            return true;
+        }
+    }
+    for (int axis = 0; axis < GAMEPAD_AXIS_COUNT; ++axis) {
+        if (m_analogTouching[axis]) {
+            return true;
+        }
+    }
+    return m_mouseLookTouching || m_pluginTouches != 0;
+}
+
+void Application::UpdateActiveTouches() {
+    // Only update touches in MAPPING mode (turbo touches are too short to need it)
+    if (m_mode != AppMode::MAPPING) {
+        return;
+    }
+    
+    // Send update events for all held keys to keep touches alive.
+    // The injector remembers each touch position, so no mapping lookup is
+    // needed (the key may have been unmapped by a layer switch since).
+    for (int virtualKey = 0; virtualKey < 256; ++virtualKey) {
+        if (m_heldKeys.Test(virtualKey)) {
+            m_touchInjector->TouchUpdate(m_keyTouchIds[virtualKey]);
+        }
+    }
+    
+    for (int i = 0; i < m_activeChordCount; ++i) {
+        int triggerKey = m_activeChords[i].triggerKey;
+        if (!m_turbo[triggerKey].active) {
+            m_touchInjector->TouchUpdate(m_keyTouchIds[triggerKey]);
+        }
+    }
+    
+    for (int axis = 0; axis < GAMEPAD_AXIS_COUNT; ++axis) {
+        if (m_analogTouching[axis]) {
+            m_touchInjector->TouchUpdate(ANALOG_TOUCH_ID(axis));
+        }
+    }
+    
+    if (m_mouseLookTouching) {
+        m_touchInjector->TouchUpdate(MOUSE_LOOK_TOUCH_ID);
     }
     
-    // Send update events for all held keys to keep touches alive
-    for (const auto& keyState : m_keyStates) {
-        int virtualKey = keyState.first;
-        KeyMapping mapping;
-        if (m_config->GetMapping(virtualKey, mapping)) {
-            int touchId = virtualKey % MAX_SIMULTANEOUS_TOUCHES;
+    for (int touchId = 0; touchId < MAX_SIMULTANEOUS_TOUCHES; ++touchId) {
+        if (m_pluginTouches & (1 << touchId)) {
             m_touchInjector->TouchUpdate(touchId);
         }
     }
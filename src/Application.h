@@ -5,8 +5,20 @@
 #include "KeyboardHook.h"
 #include "TouchInjector.h"
 #include "DisplayOverlay.h"
+#include "ChordMatcher.h"
+#include "Scheduler.h"
+#include "FramePacer.h"
+#include "RawInputRouter.h"
+#include "GamepadSource.h"
+#include "ControlServer.h"
+#include "StatsPage.h"
+#include "EventStream.h"
+#include "KeyState.h"
+#include "UsageCounters.h"
+#include "WindowTracker.h"
+#include "Tracer.h"
+#include "PluginHost.h"
 #include <memory>
-#include <map>
 
 enum class AppMode {
     RECORDING,
@@ -16,7 +28,11 @@ enum class AppMode {
 
 class Application {
 public:
-    Application();
+    // Real time, or a simulated clock (must outlive the application): a
+    // simulated run installs nothing in the system (no hook, touch device,
+    // windows or pipes); keys come through ReplayKeyEvent and time only moves
+    // with RunUntil, so recorded input replays through the real core
+    explicit Application(const std::string& configFile = "keymap_config.txt", SimulatedClock* clock = nullptr);
     ~Application();
     
     // Initialize the application
@@ -28,27 +44,306 @@ public:
     // Shutdown the application
     void Shutdown();
     
+    // Simulated run: send a key event through the hook as if it was typed;
+    // returns true if the hook swallowed it
+    bool ReplayKeyEvent(int virtualKey, bool isDown, int scanCode = 0, bool extended = false);
+    
+    // Simulated run: report raw mouse motion as if the mouse moved (mouse look)
+    void ReplayMouseMotion(int dx, int dy);
+    
+    // Simulated run: report a gamepad stick or trigger position (GAMEPAD_* axis)
+    void ReplayGamepadAxis(int axis, float x, float y);
+    
+    // Simulated run: report the target window's client area as if it moved or
+    // resized there (an empty rectangle: it closed)
+    void ReplayWindowPlacement(const RECT& client);
+    
+    // Simulated run: run every task due up to timeUs, moving the clock along
+    void RunUntil(int64_t timeUs);
+    
+    // Run one control pipe command; returns the reply line
+    std::string OnControlCommand(const std::string& command);
+    
+    // Components as they are now, for checks after a simulated run
+    const ConfigManager& GetConfig() const;
+    const KeyboardHook& GetKeyboardHook() const;
+    const TouchInjector& GetTouchInjector() const;
+    const FramePacer* GetFramePacer() const;  // Null without frame pacing
+
 private:
+    std::string m_configFile;
+    SimulatedClock* m_simulatedClock;  // Null in real time
+    
     std::unique_ptr<ConfigManager> m_config;
     std::unique_ptr<KeyboardHook> m_keyboardHook;
     std::unique_ptr<TouchInjector> m_touchInjector;
     std::unique_ptr<DisplayOverlay> m_overlay;
+    std::unique_ptr<Scheduler> m_scheduler;
+    std::unique_ptr<FramePacer> m_framePacer;  // Null unless frame pacing is on
+    std::unique_ptr<RawInputRouter> m_rawInput;  // Null unless devices are configured
+    std::unique_ptr<GamepadSource> m_gamepad;  // Null unless the gamepad is enabled
+    std::unique_ptr<ControlServer> m_control;  // Null unless control IPC is enabled
+    std::unique_ptr<StatsPage> m_statsPage;    // Null unless control IPC is enabled
+    std::unique_ptr<EventStream> m_eventStream;  // Null unless the event stream is enabled
+    std::unique_ptr<UsageCounters> m_usage;      // Null unless usage stats are enabled
+    std::unique_ptr<WindowTracker> m_windowTracker;  // Null unless the profile targets a window
+    std::unique_ptr<PluginHost> m_plugins;       // Null unless a profile loads plugins
     
     AppMode m_mode;
     bool m_running;
     bool m_displayEnabled;
     
-    // Track which keys are currently pressed (for hold behavior)
-    std::map<int, bool> m_keyStates;
+    // Keys whose mapped touch is currently held down (for hold behavior)
+    KeyBitset m_heldKeys;
+    
+    // Touch ID each key's contact holds (-1 if none: held keys, chord triggers
+    // and turbo keys hold one), and those IDs as bits. Keys take the lowest ID
+    // that is free and not reserved, so two contacts never share an ID.
+    int m_keyTouchIds[256];
+    int m_keyTouchMask;
+    
+    // IDs (bits) kept for the fixed contacts the profile uses (sticks, triggers, mouse look)
+    int m_reservedTouchIds;
+    
+    // Every key physically held right now (generic Shift/Ctrl/Alt included)
+    KeyBitset m_pressedKeys;
+    
+    // Chord matching over the pressed key set
+    ChordMatcher m_chordMatcher;
+    
+    // Chords whose touch is currently held, with the key that completed each
+    // (fixed pool: each held chord owns one of the touch contacts)
+    struct ActiveChord {
+        int chordId;
+        int triggerKey;
+    };
+    ActiveChord m_activeChords[MAX_TOUCH_CONTACTS];
+    int m_activeChordCount;
+    
+    // Chord member keys waiting for the resolve window to expire
+    KeyBitset m_pendingKeys;
+    
+    // Keys dispatched per device from raw input instead of the hook (mapping mode only)
+    KeyBitset m_deviceRoutedKeys;
+    
+    // Turbo (rapid-fire) state of a held key, driven by the scheduler
+    struct TurboState {
+        bool active;
+        bool touching;
+        POINTER_TOUCH_INFO contact;  // Copy of the mapping's prebuilt contact
+        int touchId;
+        int64_t periodUs;
+        int64_t downUs;
+        int64_t phaseStart;
+        int taskId;
+    };
+    TurboState m_turbo[256];
+    
+    // Pending frame flush task and the time it was planned for
+    int m_frameFlushTask;
+    int64_t m_frameFlushTarget;
+    
+    // Counters published on the stats page
+    uint64_t m_keyEventCount;
+    uint64_t m_mappedKeyDownCount;
+    uint64_t m_controlCommandCount;
+    LatencyHistogram m_keyLatency;
+    int m_statsPublishTask;
+    int64_t m_lastStatsPublish;
+    
+    // Returns from the message wait, and those caused by the scheduler timer
+    uint64_t m_wakeupCount;
+    uint64_t m_timerWakeupCount;
     
-    // Timer for touch updates
-    UINT_PTR m_touchUpdateTimer;
+    // Pending gamepad poll task (only while not idle)
+    int m_gamepadPollTask;
     
-    // Callback for keyboard events
+    // Sticks/triggers whose drag contact is currently down
+    bool m_analogTouching[GAMEPAD_AXIS_COUNT];
+    
+    // Pending touch keepalive task (only while touches are held)
+    int m_touchUpdateTask;
+    
+    // Pending end of the chord resolve window
+    int m_chordResolveTask;
+    
+    // Pending keyboard hook health check and its due time (soon after key events
+    // and while keys are held, every few seconds otherwise)
+    int m_hookWatchdogTask;
+    int64_t m_hookWatchdogDue;
+    
+    // Usage heatmap on the overlay, pending usage task, time of the last snapshot
+    // and whether presses were counted since
+    bool m_heatmapEnabled;
+    int m_usageTask;
+    int64_t m_usageSnapshotTime;
+    bool m_usageDirty;
+    
+    // Mouse look: on (Ctrl+Shift+L), contact down and its position, motion not
+    // applied yet, the pending move task and when motion was last applied
+    bool m_mouseLookActive;
+    bool m_mouseLookTouching;
+    float m_mouseLookX;
+    float m_mouseLookY;
+    int m_mouseLookDx;
+    int m_mouseLookDy;
+    int m_mouseLookTask;
+    int64_t m_lastMouseLookUs;
+    
+    // Raw motion reports, and the contact moves they were coalesced into
+    uint64_t m_mouseMotionCount;
+    uint64_t m_mouseLookMoveCount;
+    
+    // Pending search for a target window that is not open (only while not idle)
+    int m_windowSearchTask;
+    
+    // Contact buffer plugin actions write into, and the touch IDs (bits) their contacts hold down
+    KmmContact m_pluginContacts[MAX_TOUCH_CONTACTS];
+    int m_pluginTouches;
+    
+    // Callback for keyboard events (times HandleKeyEvent for the stats page)
     void OnKeyEvent(int virtualKey, bool isDown);
     
-    // Timer callback for touch updates
-    static void CALLBACK TouchUpdateTimerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
+    // Handle a key event in the current mode
+    void HandleKeyEvent(int virtualKey, bool isDown);
+    
+    // Callback for key events of device-routed keys (from raw input)
+    void OnDeviceKeyEvent(int device, int virtualKey, bool isDown);
+    
+    // Track the pressed key set
+    void UpdatePressedKeys(int virtualKey, bool isDown);
+    
+    // Handle chord matching; returns true if the event was consumed
+    bool HandleChordEvent(int virtualKey, bool isDown, bool isRepeat);
+    
+    // Handle layer activation keys; returns true if the event was consumed
+    bool HandleLayerKey(int virtualKey, bool isDown, bool isRepeat);
+    
+    // Trigger the single-key mapping for a key (as mapped for the given device)
+    void HandleMappedKey(int virtualKey, bool isDown, bool isRepeat, int device = 0);
+    
+    // Run the plugin action bound to a key and send the contacts it emitted;
+    // returns true if the action handled the event
+    bool HandlePluginAction(int virtualKey, bool isDown, bool isRepeat);
+    
+    // Load the profile's plugins (loaded ones stay) and bind their actions to keys.
+    // New DLLs load only from the startup config: a profile switched to later
+    // (possibly over the control pipe) can only bind actions of loaded plugins.
+    void UpdatePlugins(bool loadNew);
+    
+    // Lift every contact a plugin action holds down
+    void ReleasePluginTouches();
+    
+    // Get the qualified binding for a key press with the modifiers held now, or null
+    const KeyMapping* FindBinding(int virtualKey) const;
+    
+    // Start/stop tapping at a fixed rate while a key is held
+    void StartTurbo(int virtualKey, const POINTER_TOUCH_INFO& contact, int touchId, int rateHz, int dutyPercent);
+    void StopTurbo(int virtualKey);
+    void StopAllTurbo();
+    
+    // Advance a key's turbo cycle (touch down or up) and schedule the next edge
+    void OnTurboTask(int virtualKey);
+    static void TurboTaskProc(void* context, int param);
+    
+    // Drag a stick's or trigger's contact to follow the axis (mapping mode only)
+    void OnGamepadAxis(int axis, float x, float y);
+    
+    // Lift every stick/trigger contact
+    void ReleaseAnalogTouches();
+    
+    // Turn mouse look on (mapping mode, region configured) or off; off lifts its contact
+    void SetMouseLook(bool active);
+    
+    // Callback for raw mouse motion: sum it and schedule one move for the frame
+    void OnMouseMotion(int dx, int dy);
+    
+    // Move the mouse look contact by the summed motion (lift at the region edge)
+    void OnMouseLookTask();
+    static void MouseLookTaskProc(void* context, int param);
+    
+    // Lift the mouse look contact and drop pending motion
+    void ReleaseMouseLook();
+    
+    // Start or stop gamepad polling to match the mode
+    void UpdateGamepadPolling();
+    
+    // Poll the gamepad and schedule the next poll at the interval it asks for
+    void OnGamepadPoll();
+    static void GamepadPollTaskProc(void* context, int param);
+    
+    // Switch to another config file (profile), releasing everything held
+    bool SwitchProfile(const std::string& configFile);
+    
+    // Copy the counters to the stats page
+    void OnStatsPublish();
+    static void StatsPublishTaskProc(void* context, int param);
+    
+    // Publish the stats page soon (rate limited; nothing is published while idle)
+    void RequestStatsPublish();
+    
+    // Check the keyboard hook, release stuck keys and schedule the next check
+    void OnHookWatchdog();
+    static void HookWatchdogTaskProc(void* context, int param);
+    
+    // Check the hook within intervalUs (a pending earlier check is kept)
+    void ArmHookWatchdog(int64_t intervalUs);
+    
+    // Refresh the shown heatmap, write a usage snapshot when due and schedule
+    // the next run only if one of them is still needed
+    void OnUsageTask();
+    static void UsageTaskProc(void* context, int param);
+    
+    // Write the usage counters next to the config file
+    void WriteUsageSnapshot();
+    
+    // Write the recorded trace spans next to the config file
+    void WriteTrace();
+    
+    // Path of a file kept next to the config: keymap_config.txt -> keymap_config<suffix>
+    std::string GetConfigSidecarPath(const char* suffix) const;
+    
+    // Schedule a flush of queued touch frames at the next pacing point
+    void ScheduleFrameFlush();
+    
+    // Send the oldest queued touch frame and record its phase error
+    void OnFrameFlush();
+    static void FrameFlushTaskProc(void* context, int param);
+    
+    // Fire single-key mappings whose chord did not complete in time
+    void ResolvePendingKeys();
+    
+    // Rebuild chord matcher from config
+    void RebuildChords();
+    
+    // Take a touch ID for a key's contact (the one it holds, if any); -1 if all are in use
+    int AcquireKeyTouchId(int virtualKey);
+    
+    // Return a key's touch ID (if it holds one) to the free IDs
+    void ReleaseKeyTouchId(int virtualKey);
+    
+    // Reserve the fixed IDs of the contacts the profile configures
+    void UpdateReservedTouchIds();
+    
+    // Lift the contacts of held mapped keys and held chords, and forget them
+    // (their key-ups then lift nothing)
+    void ReleaseHeldKeyTouches();
+    void ReleaseChordTouches();
+    
+    // Tell the hook which keys the current mode needs to see
+    void UpdateKeyFilter();
+    
+    // Scheduler task for the end of the chord resolve window
+    static void ChordResolveTaskProc(void* context, int param);
+    
+    // Scheduler task for touch updates (reschedules itself while touches are held)
+    static void TouchUpdateTaskProc(void* context, int param);
+    
+    // Schedule touch updates if touches are held and none are pending
+    void ArmTouchUpdates();
+    
+    // Check if any touch needs keepalive updates
+    bool HasHeldTouches() const;
     
     // Update all active touches
     void UpdateActiveTouches();
@@ -56,6 +351,19 @@ private:
     // Handle mode switching
     void SetMode(AppMode mode);
     
+    // Push the active mappings to the overlay while it is shown
+    void RefreshOverlay();
+    
+    // Follow the profile's target window, or look for it until it opens
+    void UpdateTargetWindow();
+    
+    // Callback for target window moves/resizes: re-place every position
+    void OnWindowPlacement(const RECT& client);
+    static void WindowSearchTaskProc(void* context, int param);
+    
+    // Commit an indicator dropped or deleted in overlay edit mode
+    void OnOverlayEdit(int virtualKey, int x, int y, bool remove);
+    
     // Print current status
     void PrintStatus();
     
@@ -0,0 +1,115 @@
+#include "BindingTable.h"
+#include <algorithm>
+
+// Average keys per bucket (more means fewer seeds but a longer build)
+#define BINDING_KEYS_PER_BUCKET 2
+
+// Seeds tried per bucket before the build gives up
+#define BINDING_MAX_SEED_ATTEMPTS (1 << 20)
+
+BindingTable::BindingTable() {
+}
+
+BindingTable::~BindingTable() {
+}
+
+bool BindingTable::Build(const std::vector<uint32_t>& keys) {
+    Clear();
+    if (keys.empty()) {
+        return true;
+    }
+    
+    const uint32_t count = static_cast<uint32_t>(keys.size());
+    const uint32_t bucketCount = (count + BINDING_KEYS_PER_BUCKET - 1) / BINDING_KEYS_PER_BUCKET;
+    
+    std::vector<std::vector<int>> buckets(bucketCount);
+    for (uint32_t i = 0; i < count; ++i) {
+        buckets[Reduce(Hash(keys[i], 0), bucketCount)].push_back(static_cast<int>(i));
+    }
+    
+    // Place the largest buckets first, while most slots are still free
+    std::vector<uint32_t> order(bucketCount);
+    for (uint32_t b = 0; b < bucketCount; ++b) {
+        order[b] = b;
+    }
+    std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t a, uint32_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+    
+    m_seeds.assign(bucketCount, 0);
+    m_keys.assign(count, 0);
+    m_ids.assign(count, -1);
+    
+    std::vector<uint32_t> slots;
+    for (uint32_t bucket : order) {
+        const std::vector<int>& members = buckets[bucket];
+        if (members.empty()) {
+            break;
+        }
+        
+        bool placed = false;
+        for (uint32_t seed = 1; seed <= BINDING_MAX_SEED_ATTEMPTS && !placed; ++seed) {
+            slots.clear();
+            placed = true;
+            for (int id : members) {
+                uint32_t slot = Reduce(Hash(keys[id], seed), count);
+                if (m_ids[slot] >= 0 || std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+                    placed = false;
+                    break;
+                }
+                slots.push_back(slot);
+            }
+            
+            if (placed) {
+                m_seeds[bucket] = seed;
+                for (size_t i = 0; i < members.size(); ++i) {
+                    m_keys[slots[i]] = keys[members[i]];
+                    m_ids[slots[i]] = members[i];
+                }
+            }
+        }
+        
+        // Only duplicate keys (always colliding) get here in practice
+        if (!placed) {
+            Clear();
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+void BindingTable::Clear() {
+    m_seeds.clear();
+    m_keys.clear();
+    m_ids.clear();
+}
+
+int BindingTable::Find(uint32_t key) const {
+    if (m_keys.empty()) {
+        return -1;
+    }
+    
+    uint32_t seed = m_seeds[Reduce(Hash(key, 0), static_cast<uint32_t>(m_seeds.size()))];
+    uint32_t slot = Reduce(Hash(key, seed), static_cast<uint32_t>(m_keys.size()));
+    return (m_keys[slot] == key) ? m_ids[slot] : -1;
+}
+
+bool BindingTable::IsEmpty() const {
+    return m_keys.empty();
+}
+
+uint32_t BindingTable::Hash(uint32_t key, uint32_t seed) {
+    // Murmur3 finalizer over the seeded key
+    uint32_t h = key ^ (seed * 0x9E3779B9u);
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+uint32_t BindingTable::Reduce(uint32_t hash, uint32_t count) {
+    return static_cast<uint32_t>((static_cast<uint64_t>(hash) * count) >> 32);
+}
@@ -0,0 +1,52 @@
+#ifndef BINDING_TABLE_H
+#define BINDING_TABLE_H
+
+#include <cstdint>
+#include <vector>
+
+// Packed binding key (32 bits): the key code, how to read it, and the
+// modifiers that must be held
+#define BINDING_CODE_MASK   0x000000FF  // Virtual key, or scancode with BINDING_SCANCODE
+#define BINDING_SCANCODE    0x00000100  // Code is a hardware scancode, not a virtual key
+#define BINDING_EXTENDED    0x00000200  // Extended key (E0 prefix), e.g. numpad Enter
+#define BINDING_MOD_CTRL    0x00010000
+#define BINDING_MOD_SHIFT   0x00020000
+#define BINDING_MOD_ALT     0x00040000
+#define BINDING_MOD_WIN     0x00080000
+#define BINDING_MOD_MASK    0x000F0000
+
+// Maps packed binding keys to binding IDs through a minimal perfect hash
+// built once per profile load (hash and displace): keys are hashed into
+// buckets, and each bucket gets a seed that sends all of its keys to free
+// slots. A lookup is two hashes, two loads and one compare, however many
+// bindings there are.
+class BindingTable {
+public:
+    BindingTable();
+    ~BindingTable();
+    
+    // Replace all keys (index in 'keys' is the binding ID; keys must be unique).
+    // Returns false if no perfect hash was found; the table is then empty.
+    bool Build(const std::vector<uint32_t>& keys);
+    
+    // Remove all keys
+    void Clear();
+    
+    // Get the binding ID of a key, or -1 if the key is not bound
+    int Find(uint32_t key) const;
+    
+    // Check if any keys are bound
+    bool IsEmpty() const;
+
+private:
+    std::vector<uint32_t> m_seeds;  // Per bucket
+    std::vector<uint32_t> m_keys;   // Per slot
+    std::vector<int> m_ids;         // Per slot
+    
+    static uint32_t Hash(uint32_t key, uint32_t seed);
+    
+    // Map a hash onto [0, count) without a division
+    static uint32_t Reduce(uint32_t hash, uint32_t count);
+};
+
+#endif // BINDING_TABLE_H
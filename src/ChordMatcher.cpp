@@ -0,0 +1,78 @@
+#include "ChordMatcher.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CHORD_MATCHER_SSE2 1
+#endif
+
+ChordMatcher::ChordMatcher() {
+}
+
+ChordMatcher::~ChordMatcher() {
+}
+
+void ChordMatcher::Build(const std::vector<KeyBitset>& chords) {
+    m_masks = chords;
+    m_keyCounts.clear();
+    m_members.Reset();
+    
+    for (const auto& mask : m_masks) {
+        m_keyCounts.push_back(mask.Count());
+        m_members.Merge(mask);
+    }
+}
+
+void ChordMatcher::Clear() {
+    m_masks.clear();
+    m_keyCounts.clear();
+    m_members.Reset();
+}
+
+int ChordMatcher::Match(const KeyBitset& pressed, int triggerKey) const {
+    int best = -1;
+    int bestCount = 0;
+    const size_t count = m_masks.size();
+
+#ifdef CHORD_MATCHER_SSE2
+    const __m128i pressedLo = _mm_load_si128(reinterpret_cast<const __m128i*>(&pressed.words[0]));
+    const __m128i pressedHi = _mm_load_si128(reinterpret_cast<const __m128i*>(&pressed.words[2]));
+    
+    for (size_t i = 0; i < count; ++i) {
+        const __m128i maskLo = _mm_load_si128(reinterpret_cast<const __m128i*>(&m_masks[i].words[0]));
+        const __m128i maskHi = _mm_load_si128(reinterpret_cast<const __m128i*>(&m_masks[i].words[2]));
+        
+        // (pressed & mask) == mask for both halves
+        __m128i eq = _mm_and_si128(
+            _mm_cmpeq_epi32(_mm_and_si128(pressedLo, maskLo), maskLo),
+            _mm_cmpeq_epi32(_mm_and_si128(pressedHi, maskHi), maskHi));
+        
+        if (_mm_movemask_epi8(eq) == 0xFFFF &&
+            m_keyCounts[i] > bestCount && m_masks[i].Test(triggerKey)) {
+            best = static_cast<int>(i);
+            bestCount = m_keyCounts[i];
+        }
+    }
+#else
+    for (size_t i = 0; i < count; ++i) {
+        if (pressed.Contains(m_masks[i]) &&
+            m_keyCounts[i] > bestCount && m_masks[i].Test(triggerKey)) {
+            best = static_cast<int>(i);
+            bestCount = m_keyCounts[i];
+        }
+    }
+#endif
+    
+    return best;
+}
+
+bool ChordMatcher::IsMember(int virtualKey) const {
+    return m_members.Test(virtualKey);
+}
+
+bool ChordMatcher::IsEmpty() const {
+    return m_masks.empty();
+}
+
+const KeyBitset& ChordMatcher::GetMembers() const {
+    return m_members;
+}
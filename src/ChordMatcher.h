@@ -0,0 +1,40 @@
+#ifndef CHORD_MATCHER_H
+#define CHORD_MATCHER_H
+
+#include "KeyState.h"
+#include <vector>
+
+// Matches the set of currently pressed keys against all chord definitions.
+// Chord masks are stored contiguously and compared with SIMD AND/compare,
+// so a lookup is a single branch-light pass over every candidate.
+class ChordMatcher {
+public:
+    ChordMatcher();
+    ~ChordMatcher();
+    
+    // Replace all chord definitions (index in 'chords' is the chord ID)
+    void Build(const std::vector<KeyBitset>& chords);
+    
+    // Remove all chord definitions
+    void Clear();
+    
+    // Find the most specific chord that is fully pressed and contains triggerKey.
+    // Returns the chord ID, or -1 if none matches.
+    int Match(const KeyBitset& pressed, int triggerKey) const;
+    
+    // Check if a key takes part in any chord
+    bool IsMember(int virtualKey) const;
+    
+    // Check if any chords are defined
+    bool IsEmpty() const;
+    
+    // Get every key that takes part in some chord
+    const KeyBitset& GetMembers() const;
+
+private:
+    std::vector<KeyBitset> m_masks;
+    std::vector<int> m_keyCounts;
+    KeyBitset m_members;
+};
+
+#endif // CHORD_MATCHER_H
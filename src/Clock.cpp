@@ -0,0 +1,48 @@
+#include "Clock.h"
+
+SystemClock::SystemClock()
+    : m_frequency(1) {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    m_frequency = frequency.QuadPart;
+}
+
+int64_t SystemClock::Now() const {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (counter.QuadPart / m_frequency) * 1000000 +
+           (counter.QuadPart % m_frequency) * 1000000 / m_frequency;
+}
+
+bool SystemClock::IsSimulated() const {
+    return false;
+}
+
+SystemClock& SystemClock::Instance() {
+    static SystemClock instance;
+    return instance;
+}
+
+SimulatedClock::SimulatedClock(int64_t startUs)
+    : m_nowUs(startUs) {
+}
+
+int64_t SimulatedClock::Now() const {
+    return m_nowUs;
+}
+
+bool SimulatedClock::IsSimulated() const {
+    return true;
+}
+
+void SimulatedClock::AdvanceTo(int64_t timeUs) {
+    if (timeUs > m_nowUs) {
+        m_nowUs = timeUs;
+    }
+}
+
+void SimulatedClock::AdvanceBy(int64_t deltaUs) {
+    if (deltaUs > 0) {
+        m_nowUs += deltaUs;
+    }
+}
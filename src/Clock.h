@@ -0,0 +1,53 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <windows.h>
+#include <cstdint>
+
+// Time source for everything that schedules or timestamps input.
+// The core reads time only through a Clock, so a simulated clock can stand
+// in for the real one and hours of timed behavior (turbo taps, keepalives,
+// tap holds) run in milliseconds with reproducible results.
+class Clock {
+public:
+    virtual ~Clock() {}
+    
+    // Current time in microseconds
+    virtual int64_t Now() const = 0;
+    
+    // True if time only moves when advanced (nothing may wait or spin on it)
+    virtual bool IsSimulated() const = 0;
+};
+
+// Real time: the performance counter in microseconds since boot
+class SystemClock : public Clock {
+public:
+    SystemClock();
+    
+    int64_t Now() const override;
+    bool IsSimulated() const override;
+    
+    // Shared instance for components that are not given a clock
+    static SystemClock& Instance();
+
+private:
+    int64_t m_frequency;
+};
+
+// Simulated time: starts at a given time and moves only when advanced
+class SimulatedClock : public Clock {
+public:
+    explicit SimulatedClock(int64_t startUs = 0);
+    
+    int64_t Now() const override;
+    bool IsSimulated() const override;
+    
+    // Move time forward (never backward)
+    void AdvanceTo(int64_t timeUs);
+    void AdvanceBy(int64_t deltaUs);
+
+private:
+    int64_t m_nowUs;
+};
+
+#endif // CLOCK_H
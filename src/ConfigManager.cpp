@@ -1,13 +1,59 @@
 #include "ConfigManager.h"
+#include "TouchInjector.h"
+#include "Tracer.h"
 #include <sstream>
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <cctype>
+
+// Chord resolve window bounds (milliseconds)
+#define DEFAULT_CHORD_RESOLVE_WINDOW_MS 30
+#define MAX_CHORD_RESOLVE_WINDOW_MS     500
+
+// Turbo limits; the defaults drive continuous tap mode
+#define DEFAULT_TURBO_RATE_HZ      15
+#define DEFAULT_TURBO_DUTY_PERCENT 50
+#define MAX_TURBO_RATE_HZ          100
+#define MIN_TURBO_DUTY_PERCENT     5
+#define MAX_TURBO_DUTY_PERCENT     95
+
+// Contact shape limits (pressure is InjectTouchInput's 0..1024 scale)
+#define MAX_CONTACT_RADIUS   100
+#define MAX_CONTACT_PRESSURE 1024
+
+// Frame pacing flush lead before vblank (microseconds, 0 = pacing off)
+#define MAX_FRAME_PACING_LEAD_US 8000
+
+// Layer limits (one bit per layer in the active set)
+#define MAX_LAYERS 32
+#define BASE_LAYER 0
 
 ConfigManager::ConfigManager(const std::string& configFile)
     : m_configFile(configFile)
-    , m_holdTriggersContinuousTap(false) {  // Default: hold maintains touch
+    , m_activeLayers(1u << BASE_LAYER)
+    , m_targetWidth(0)
+    , m_targetHeight(0) {
+    SetRectEmpty(&m_targetClient);
     LoadMappings();
 }
 
+void ConfigManager::ResetOptions() {
+    m_holdTriggersContinuousTap = false;  // Default: hold maintains touch
+    m_chordResolveWindowMs = DEFAULT_CHORD_RESOLVE_WINDOW_MS;
+    m_defaultTurboRateHz = DEFAULT_TURBO_RATE_HZ;
+    m_defaultTurboDutyPercent = DEFAULT_TURBO_DUTY_PERCENT;
+    m_framePacingLeadUs = 0;
+    m_gamepadEnabled = false;
+    m_controlIpcEnabled = false;
+    m_eventStreamEnabled = false;
+    m_consumeMappedKeys = true;
+    m_usageStatsEnabled = false;
+    m_traceEnabled = false;
+    m_touchLogEnabled = false;
+}
+
 ConfigManager::~ConfigManager() {
     SaveMappings();
 }
@@ -16,73 +62,720 @@ std::string ConfigManager::GetKeyName(int virtualKey) {
     // Get the scan code
     UINT scanCode = MapVirtualKeyA(virtualKey, MAPVK_VK_TO_VSC);
     
-    // Get key name
-    char keyName[256];
-    if (GetKeyNameTextA(scanCode << 16, keyName, sizeof(keyName)) > 0) {
-        return std::string(keyName);
+    std::string keyName = GetScanCodeName(scanCode, false);
+    if (!keyName.empty()) {
+        return keyName;
     }
     
     // Fallback to VK code
     return "VK_" + std::to_string(virtualKey);
 }
 
-bool ConfigManager::SaveMapping(int virtualKey, int x, int y, const std::string& keyName) {
-    // Validate virtual key code
-    if (virtualKey < 0 || virtualKey > 255) {
-        std::cerr << "Invalid virtual key code: " << virtualKey << std::endl;
-        return false;
+std::string ConfigManager::GetScanCodeName(int scanCode, bool extended) {
+    // Get key name (wide, so non-ASCII names survive; stored as UTF-8)
+    wchar_t keyName[256];
+    LONG keyParam = (scanCode << 16) | (extended ? (1 << 24) : 0);
+    int length = GetKeyNameTextW(keyParam, keyName, 256);
+    if (length > 0) {
+        char utf8Name[256 * 3];
+        int size = WideCharToMultiByte(CP_UTF8, 0, keyName, length, utf8Name, sizeof(utf8Name), nullptr, nullptr);
+        if (size > 0) {
+            return std::string(utf8Name, size);
+        }
     }
-    
+    return "";
+}
+
+void ConfigManager::ClampToScreen(int& x, int& y) {
     // Get screen dimensions for validation
     int screenWidth = GetSystemMetrics(SM_CXSCREEN);
     int screenHeight = GetSystemMetrics(SM_CYSCREEN);
     
-    // Clamp coordinates to valid screen bounds
     if (x < 0) x = 0;
     if (x > screenWidth) x = screenWidth;
     if (y < 0) y = 0;
     if (y > screenHeight) y = screenHeight;
+}
+
+bool ConfigManager::SaveMapping(int virtualKey, int x, int y, const std::string& keyName) {
+    // Validate virtual key code
+    if (virtualKey < 0 || virtualKey > 255) {
+        std::cerr << "Invalid virtual key code: " << virtualKey << std::endl;
+        return false;
+    }
     
-    KeyMapping mapping;
+    // Clamp coordinates to valid screen bounds
+    ClampToScreen(x, y);
+    
+    // Re-recording a key moves it but keeps its per-mapping options
+    std::map<int, KeyMapping>& layerMappings = m_layers[GetTopActiveLayer()].mappings;
+    auto existing = layerMappings.find(virtualKey);
+    KeyMapping mapping = (existing != layerMappings.end()) ? existing->second : KeyMapping();
     mapping.x = x;
     mapping.y = y;
     mapping.keyName = keyName.empty() ? GetKeyName(virtualKey) : keyName;
+    BuildContact(mapping);
     
-    m_mappings[virtualKey] = mapping;
+    layerMappings[virtualKey] = mapping;
+    ResolveLayers();
     return SaveMappings();
 }
 
-bool ConfigManager::GetMapping(int virtualKey, KeyMapping& mapping) {
-    auto it = m_mappings.find(virtualKey);
-    if (it != m_mappings.end()) {
-        mapping = it->second;
-        return true;
+bool ConfigManager::SaveChord(const std::vector<int>& virtualKeys, int x, int y, const std::string& keyName) {
+    if (virtualKeys.size() < 2) {
+        std::cerr << "A chord needs at least two keys." << std::endl;
+        return false;
     }
-    return false;
+    
+    ChordMapping chord;
+    std::string defaultName;
+    for (int virtualKey : virtualKeys) {
+        // Validate virtual key code
+        if (virtualKey < 0 || virtualKey > 255) {
+            std::cerr << "Invalid virtual key code: " << virtualKey << std::endl;
+            return false;
+        }
+        chord.keys.Set(virtualKey);
+        if (!defaultName.empty()) defaultName += "+";
+        defaultName += GetKeyName(virtualKey);
+    }
+    
+    ClampToScreen(x, y);
+    chord.x = x;
+    chord.y = y;
+    chord.keyName = keyName.empty() ? defaultName : keyName;
+    BuildChordContact(chord);
+    
+    // Replace an existing chord with the same key set
+    for (auto& existing : m_chords) {
+        if (existing.keys.Contains(chord.keys) && chord.keys.Contains(existing.keys)) {
+            existing = chord;
+            return SaveMappings();
+        }
+    }
+    
+    m_chords.push_back(chord);
+    return SaveMappings();
+}
+
+const KeyMapping* ConfigManager::GetMapping(int virtualKey, int device) const {
+    if (virtualKey < 0 || virtualKey > 255 || device < 0 || device > MAX_KEY_DEVICES) {
+        return nullptr;
+    }
+    return m_resolved[device][virtualKey];
 }
 
 bool ConfigManager::RemoveMapping(int virtualKey) {
-    auto it = m_mappings.find(virtualKey);
-    if (it != m_mappings.end()) {
-        m_mappings.erase(it);
-        return SaveMappings();
+    for (int layer = GetTopActiveLayer(); layer >= BASE_LAYER; --layer) {
+        if (!IsLayerActive(layer)) continue;
+        
+        auto it = m_layers[layer].mappings.find(virtualKey);
+        if (it != m_layers[layer].mappings.end()) {
+            m_layers[layer].mappings.erase(it);
+            ResolveLayers();
+            return SaveMappings();
+        }
+    }
+    return false;
+}
+
+bool ConfigManager::MoveMapping(int virtualKey, int x, int y) {
+    ClampToScreen(x, y);
+    
+    for (int layer = GetTopActiveLayer(); layer >= BASE_LAYER; --layer) {
+        if (!IsLayerActive(layer)) continue;
+        
+        auto it = m_layers[layer].mappings.find(virtualKey);
+        if (it != m_layers[layer].mappings.end()) {
+            it->second.x = x;
+            it->second.y = y;
+            BuildContact(it->second);
+            ResolveLayers();
+            return SaveMappings();
+        }
     }
     return false;
 }
 
+bool ConfigManager::ParseBinding(const std::string& value) {
+    std::istringstream iss(value);
+    std::string keyText;
+    int x, y;
+    if (!(iss >> keyText >> x >> y)) {
+        return false;
+    }
+    
+    uint32_t bindingKey;
+    if (!ParseBindingKey(keyText, bindingKey)) {
+        std::cerr << "Invalid binding key: " << keyText << std::endl;
+        return false;
+    }
+    
+    ClampToScreen(x, y);
+    
+    std::string keyName;
+    std::getline(iss, keyName);
+    size_t pos = keyName.find_first_not_of(" \t");
+    keyName = (pos != std::string::npos) ? keyName.substr(pos) : "";
+    
+    KeyMapping mapping;
+    mapping.x = x;
+    mapping.y = y;
+    mapping.keyName = keyName.empty() ? GetBindingName(bindingKey) : keyName;
+    BuildContact(mapping);
+    m_bindings[bindingKey] = mapping;
+    return true;
+}
+
+bool ConfigManager::ParseBindingKey(const std::string& text, uint32_t& bindingKey) {
+    static const struct { const char* name; uint32_t flag; } qualifiers[] = {
+        { "ctrl", BINDING_MOD_CTRL }, { "shift", BINDING_MOD_SHIFT },
+        { "alt", BINDING_MOD_ALT }, { "win", BINDING_MOD_WIN },
+        { "ext", BINDING_EXTENDED },
+    };
+    
+    bindingKey = 0;
+    std::istringstream tokens(text);
+    std::string token;
+    std::vector<std::string> parts;
+    while (std::getline(tokens, token, '+')) {
+        std::transform(token.begin(), token.end(), token.begin(), ::tolower);
+        parts.push_back(token);
+    }
+    if (parts.empty()) {
+        return false;
+    }
+    
+    // Qualifiers first, the key code last
+    for (size_t i = 0; i + 1 < parts.size(); ++i) {
+        bool known = false;
+        for (const auto& qualifier : qualifiers) {
+            if (parts[i] == qualifier.name) {
+                bindingKey |= qualifier.flag;
+                known = true;
+            }
+        }
+        if (!known) {
+            return false;
+        }
+    }
+    
+    // "scNN" is a scancode, anything else a virtual key code (decimal or 0x hex)
+    std::string code = parts.back();
+    if (code.compare(0, 2, "sc") == 0) {
+        bindingKey |= BINDING_SCANCODE;
+        code = code.substr(2);
+    }
+    int value;
+    try {
+        size_t used = 0;
+        int base = (code.compare(0, 2, "0x") == 0) ? 16 : 10;
+        value = std::stoi(code, &used, base);
+        if (used != code.length()) {
+            return false;
+        }
+    } catch (...) {
+        return false;
+    }
+    if (value <= 0 || value > 255) {
+        return false;
+    }
+    
+    bindingKey |= static_cast<uint32_t>(value);
+    return true;
+}
+
+std::string ConfigManager::FormatBindingKey(uint32_t bindingKey) {
+    std::string text;
+    if (bindingKey & BINDING_MOD_CTRL) text += "Ctrl+";
+    if (bindingKey & BINDING_MOD_SHIFT) text += "Shift+";
+    if (bindingKey & BINDING_MOD_ALT) text += "Alt+";
+    if (bindingKey & BINDING_MOD_WIN) text += "Win+";
+    if (bindingKey & BINDING_EXTENDED) text += "Ext+";
+    if (bindingKey & BINDING_SCANCODE) text += "sc";
+    text += std::to_string(bindingKey & BINDING_CODE_MASK);
+    return text;
+}
+
+std::string ConfigManager::GetBindingName(uint32_t bindingKey) {
+    std::string name;
+    if (bindingKey & BINDING_MOD_CTRL) name += "Ctrl+";
+    if (bindingKey & BINDING_MOD_SHIFT) name += "Shift+";
+    if (bindingKey & BINDING_MOD_ALT) name += "Alt+";
+    if (bindingKey & BINDING_MOD_WIN) name += "Win+";
+    
+    int code = bindingKey & BINDING_CODE_MASK;
+    bool extended = (bindingKey & BINDING_EXTENDED) != 0;
+    int scanCode = (bindingKey & BINDING_SCANCODE) ? code : MapVirtualKeyA(code, MAPVK_VK_TO_VSC);
+    std::string keyName = GetScanCodeName(scanCode, extended);
+    if (keyName.empty()) {
+        keyName = ((bindingKey & BINDING_SCANCODE) ? "SC_" : "VK_") + std::to_string(code);
+    }
+    return name + keyName;
+}
+
+int ConfigManager::GetBindingVirtualKey(uint32_t bindingKey) {
+    int code = bindingKey & BINDING_CODE_MASK;
+    if (!(bindingKey & BINDING_SCANCODE)) {
+        return code;
+    }
+    int scanCode = (bindingKey & BINDING_EXTENDED) ? (0xE000 | code) : code;
+    return MapVirtualKeyA(scanCode, MAPVK_VSC_TO_VK_EX) & 0xFF;
+}
+
+void ConfigManager::BuildBindings() {
+    std::vector<uint32_t> keys;
+    m_bindingList.clear();
+    for (const auto& pair : m_bindings) {
+        keys.push_back(pair.first);
+        m_bindingList.push_back(&pair.second);
+    }
+    
+    if (!m_bindingTable.Build(keys)) {
+        std::cerr << "Failed to build the binding table; qualified bindings are disabled." << std::endl;
+        m_bindingList.clear();
+    }
+}
+
+const KeyMapping* ConfigManager::FindBinding(uint32_t bindingKey) const {
+    int id = m_bindingTable.Find(bindingKey);
+    return (id >= 0) ? m_bindingList[id] : nullptr;
+}
+
+const std::map<uint32_t, KeyMapping>& ConfigManager::GetAllBindings() const {
+    return m_bindings;
+}
+
+bool ConfigManager::ParseChord(const std::string& value) {
+    std::istringstream iss(value);
+    std::string keys;
+    int x, y;
+    if (!(iss >> keys >> x >> y)) {
+        return false;
+    }
+    
+    ChordMapping chord;
+    int keyCount = 0;
+    std::string defaultName;
+    std::istringstream keyStream(keys);
+    std::string token;
+    while (std::getline(keyStream, token, '+')) {
+        int virtualKey;
+        try {
+            virtualKey = std::stoi(token);
+        } catch (...) {
+            return false;
+        }
+        if (virtualKey < 0 || virtualKey > 255) {
+            std::cerr << "Invalid virtual key code in chord: " << virtualKey << std::endl;
+            return false;
+        }
+        if (!chord.keys.Test(virtualKey)) {
+            chord.keys.Set(virtualKey);
+            ++keyCount;
+            if (!defaultName.empty()) defaultName += "+";
+            defaultName += GetKeyName(virtualKey);
+        }
+    }
+    
+    if (keyCount < 2) {
+        std::cerr << "A chord needs at least two keys: " << keys << std::endl;
+        return false;
+    }
+    
+    ClampToScreen(x, y);
+    
+    std::string keyName;
+    std::getline(iss, keyName);
+    size_t pos = keyName.find_first_not_of(" \t");
+    keyName = (pos != std::string::npos) ? keyName.substr(pos) : "";
+    
+    chord.x = x;
+    chord.y = y;
+    chord.keyName = keyName.empty() ? defaultName : keyName;
+    BuildChordContact(chord);
+    m_chords.push_back(chord);
+    return true;
+}
+
+bool ConfigManager::ParseTurboSettings(std::istream& in, int& rateHz, int& dutyPercent) {
+    if (!(in >> rateHz)) {
+        return false;
+    }
+    if (!(in >> dutyPercent)) {
+        dutyPercent = DEFAULT_TURBO_DUTY_PERCENT;
+    }
+    
+    if (rateHz < 0) rateHz = 0;
+    if (rateHz > MAX_TURBO_RATE_HZ) rateHz = MAX_TURBO_RATE_HZ;
+    if (dutyPercent < MIN_TURBO_DUTY_PERCENT) dutyPercent = MIN_TURBO_DUTY_PERCENT;
+    if (dutyPercent > MAX_TURBO_DUTY_PERCENT) dutyPercent = MAX_TURBO_DUTY_PERCENT;
+    return true;
+}
+
+bool ConfigManager::ParseTurbo(const std::string& value, std::map<int, KeyMapping>& mappings) {
+    std::istringstream iss(value);
+    int virtualKey, rateHz, dutyPercent;
+    if (!(iss >> virtualKey) || !ParseTurboSettings(iss, rateHz, dutyPercent)) {
+        return false;
+    }
+    
+    // Turbo applies to a mapping defined earlier in the same section
+    auto it = mappings.find(virtualKey);
+    if (it == mappings.end()) {
+        std::cerr << "Turbo for unmapped key " << virtualKey
+                  << " (define the mapping first)" << std::endl;
+        return false;
+    }
+    
+    it->second.turboRateHz = rateHz;
+    it->second.turboDutyPercent = dutyPercent;
+    return true;
+}
+
+bool ConfigManager::ParseContact(const std::string& value, std::map<int, KeyMapping>& mappings) {
+    std::istringstream iss(value);
+    int virtualKey, radius, pressure, orientation;
+    if (!(iss >> virtualKey >> radius >> pressure >> orientation)) {
+        return false;
+    }
+    
+    // Like turbo, the shape applies to a mapping defined earlier in the same section
+    auto it = mappings.find(virtualKey);
+    if (it == mappings.end()) {
+        std::cerr << "Contact shape for unmapped key " << virtualKey
+                  << " (define the mapping first)" << std::endl;
+        return false;
+    }
+    
+    if (radius < 1) radius = 1;
+    if (radius > MAX_CONTACT_RADIUS) radius = MAX_CONTACT_RADIUS;
+    if (pressure < 1) pressure = 1;
+    if (pressure > MAX_CONTACT_PRESSURE) pressure = MAX_CONTACT_PRESSURE;
+    orientation = ((orientation % 360) + 360) % 360;
+    
+    it->second.contactRadius = radius;
+    it->second.contactPressure = pressure;
+    it->second.contactOrientation = orientation;
+    BuildContact(it->second);
+    return true;
+}
+
+void ConfigManager::BuildContact(KeyMapping& mapping) {
+    mapping.screenX = mapping.x;
+    mapping.screenY = mapping.y;
+    ToScreen(mapping.screenX, mapping.screenY);
+    
+    if (mapping.contactRadius > 0) {
+        TouchInjector::BuildContactTemplate(mapping.contact, mapping.screenX, mapping.screenY, mapping.contactRadius,
+                                            mapping.contactPressure, mapping.contactOrientation);
+    } else {
+        TouchInjector::BuildContactTemplate(mapping.contact, mapping.screenX, mapping.screenY);
+    }
+}
+
+void ConfigManager::BuildChordContact(ChordMapping& chord) {
+    int x = chord.x;
+    int y = chord.y;
+    ToScreen(x, y);
+    TouchInjector::BuildContactTemplate(chord.contact, x, y);
+}
+
+void ConfigManager::PlaceContacts() {
+    for (auto& layer : m_layers) {
+        for (auto& pair : layer.mappings) {
+            BuildContact(pair.second);
+        }
+    }
+    for (auto& device : m_devices) {
+        for (auto& pair : device.mappings) {
+            BuildContact(pair.second);
+        }
+    }
+    for (auto& pair : m_bindings) {
+        BuildContact(pair.second);
+    }
+    for (auto& chord : m_chords) {
+        BuildChordContact(chord);
+    }
+    
+    // Stick radius and trigger travel scale with the window like everything else
+    for (int axis = 0; axis < GAMEPAD_AXIS_COUNT; ++axis) {
+        AnalogMapping& analog = m_analogScreen[axis];
+        analog = m_analog[axis];
+        int radiusX = analog.x + analog.radius;
+        int radiusY = analog.y;
+        ToScreen(analog.x, analog.y);
+        ToScreen(analog.endX, analog.endY);
+        ToScreen(radiusX, radiusY);
+        analog.radius = radiusX - analog.x;
+    }
+    
+    m_mouseLookScreen = m_mouseLook;
+    ToScreen(m_mouseLookScreen.left, m_mouseLookScreen.top);
+    ToScreen(m_mouseLookScreen.right, m_mouseLookScreen.bottom);
+}
+
+void ConfigManager::ToScreen(int& x, int& y) const {
+    if (m_targetWidth <= 0 || m_targetHeight <= 0 || IsRectEmpty(&m_targetClient)) {
+        return;
+    }
+    x = m_targetClient.left + MulDiv(x, m_targetClient.right - m_targetClient.left, m_targetWidth);
+    y = m_targetClient.top + MulDiv(y, m_targetClient.bottom - m_targetClient.top, m_targetHeight);
+}
+
+void ConfigManager::FromScreen(int& x, int& y) const {
+    if (m_targetWidth <= 0 || m_targetHeight <= 0 || IsRectEmpty(&m_targetClient)) {
+        return;
+    }
+    x = MulDiv(x - m_targetClient.left, m_targetWidth, m_targetClient.right - m_targetClient.left);
+    y = MulDiv(y - m_targetClient.top, m_targetHeight, m_targetClient.bottom - m_targetClient.top);
+}
+
+void ConfigManager::SetTargetWindowRect(const RECT& client) {
+    if (IsRectEmpty(&client) || EqualRect(&client, &m_targetClient)) {
+        return;
+    }
+    m_targetClient = client;
+    PlaceContacts();
+}
+
+const std::string& ConfigManager::GetTargetWindowTitle() const {
+    return m_targetWindowTitle;
+}
+
+bool ConfigManager::ParseTargetWindow(const std::string& value) {
+    std::istringstream iss(value);
+    int width, height;
+    if (!(iss >> width >> height) || width <= 0 || height <= 0) {
+        return false;
+    }
+    
+    std::string title;
+    std::getline(iss, title);
+    size_t pos = title.find_first_not_of(" \t");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    
+    m_targetWindowTitle = title.substr(pos);
+    m_targetWidth = width;
+    m_targetHeight = height;
+    return true;
+}
+
+bool ConfigManager::ParseAnalog(const std::string& value, bool isStick) {
+    std::istringstream iss(value);
+    std::string side;
+    AnalogMapping mapping;
+    if (!(iss >> side >> mapping.x >> mapping.y)) {
+        return false;
+    }
+    
+    int axis;
+    if (side == "left") {
+        axis = isStick ? GAMEPAD_LEFT_STICK : GAMEPAD_LEFT_TRIGGER;
+    } else if (side == "right") {
+        axis = isStick ? GAMEPAD_RIGHT_STICK : GAMEPAD_RIGHT_TRIGGER;
+    } else {
+        return false;
+    }
+    
+    if (isStick) {
+        if (!(iss >> mapping.radius) || mapping.radius <= 0) {
+            return false;
+        }
+    } else {
+        if (!(iss >> mapping.endX >> mapping.endY)) {
+            return false;
+        }
+        ClampToScreen(mapping.endX, mapping.endY);
+    }
+    ClampToScreen(mapping.x, mapping.y);
+    
+    mapping.enabled = true;
+    m_analog[axis] = mapping;
+    return true;
+}
+
+bool ConfigManager::ParseMouseLook(const std::string& value) {
+    std::istringstream iss(value);
+    MouseLookMapping mapping;
+    if (!(iss >> mapping.left >> mapping.top >> mapping.right >> mapping.bottom)) {
+        return false;
+    }
+    iss >> mapping.sensitivityPercent;
+    
+    ClampToScreen(mapping.left, mapping.top);
+    ClampToScreen(mapping.right, mapping.bottom);
+    if (mapping.right <= mapping.left || mapping.bottom <= mapping.top ||
+        mapping.sensitivityPercent < 1 || mapping.sensitivityPercent > 10000) {
+        return false;
+    }
+    
+    mapping.enabled = true;
+    m_mouseLook = mapping;
+    return true;
+}
+
+int ConfigManager::ParseDeviceHeader(const std::string& line) {
+    size_t end = line.find(']');
+    if (end == std::string::npos) {
+        return -1;
+    }
+    
+    std::istringstream iss(line.substr(1, end - 1));
+    std::string keyword, alias, pattern;
+    if (!(iss >> keyword >> alias >> pattern) || keyword != "device") {
+        return -1;
+    }
+    
+    // Device names are matched case-insensitively
+    std::transform(pattern.begin(), pattern.end(), pattern.begin(), ::toupper);
+    
+    // Reopening a device section adds to the existing device
+    for (size_t i = 0; i < m_devices.size(); ++i) {
+        if (m_devices[i].alias == alias) {
+            m_devices[i].pattern = pattern;
+            return static_cast<int>(i) + 1;
+        }
+    }
+    
+    if (m_devices.size() >= MAX_KEY_DEVICES) {
+        std::cerr << "Too many devices (max " << MAX_KEY_DEVICES << "): " << alias << std::endl;
+        return -1;
+    }
+    
+    KeyDevice device;
+    device.alias = alias;
+    device.pattern = pattern;
+    m_devices.push_back(device);
+    return static_cast<int>(m_devices.size());
+}
+
+int ConfigManager::ParseLayerHeader(const std::string& line) {
+    size_t end = line.find(']');
+    if (end == std::string::npos) {
+        return -1;
+    }
+    
+    std::istringstream iss(line.substr(1, end - 1));
+    std::string keyword, name, activation;
+    iss >> keyword;
+    if (keyword == "base") {
+        return BASE_LAYER;
+    }
+    
+    int activationKey;
+    if (keyword != "layer" || !(iss >> name >> activation >> activationKey)) {
+        return -1;
+    }
+    
+    if (activationKey < 0 || activationKey > 255) {
+        std::cerr << "Invalid layer key code: " << activationKey << std::endl;
+        return -1;
+    }
+    
+    KeyLayer layer;
+    layer.name = name;
+    layer.activationKey = activationKey;
+    if (activation == "hold") {
+        layer.activation = LayerActivation::HOLD;
+    } else if (activation == "toggle") {
+        layer.activation = LayerActivation::TOGGLE;
+    } else {
+        return -1;
+    }
+    
+    // Reopening a layer section adds to the existing layer
+    for (size_t i = 1; i < m_layers.size(); ++i) {
+        if (m_layers[i].name == name) {
+            m_layers[i].activation = layer.activation;
+            m_layers[i].activationKey = layer.activationKey;
+            return static_cast<int>(i);
+        }
+    }
+    
+    if (m_layers.size() >= MAX_LAYERS) {
+        std::cerr << "Too many layers (max " << MAX_LAYERS << "): " << name << std::endl;
+        return -1;
+    }
+    
+    m_layers.push_back(layer);
+    return static_cast<int>(m_layers.size() - 1);
+}
+
 bool ConfigManager::LoadMappings() {
-    m_mappings.clear();
+    // Options a profile leaves out take their defaults, not the previous profile's values
+    ResetOptions();
+    
+    m_layers.clear();
+    m_chords.clear();
+    m_devices.clear();
+    m_bindings.clear();
+    m_activeLayers = 1u << BASE_LAYER;
+    for (auto& analog : m_analog) {
+        analog = AnalogMapping();
+    }
+    m_mouseLook = MouseLookMapping();
+    m_pluginPaths.clear();
+    m_actionBindings.clear();
+    
+    // A new profile may target another window; it is placed again once found
+    m_targetWindowTitle.clear();
+    m_targetWidth = 0;
+    m_targetHeight = 0;
+    SetRectEmpty(&m_targetClient);
+    
+    KeyLayer baseLayer;
+    baseLayer.name = "base";
+    baseLayer.activation = LayerActivation::HOLD;
+    baseLayer.activationKey = -1;
+    m_layers.push_back(baseLayer);
     
     std::ifstream file(m_configFile);
     if (!file.is_open()) {
         std::cout << "Config file not found, starting with empty mappings." << std::endl;
+        ResolveLayers();
+        BuildBindings();
+        PlaceContacts();
         return true; // Not an error for first run
     }
     
+    // Mapping lines go into the layer (or device) of the most recent section header
+    int currentLayer = BASE_LAYER;
+    int currentDevice = 0;
+    
     std::string line;
     while (std::getline(file, line)) {
         if (line.empty() || line[0] == '#') continue;
         
+        if (line[0] == '[') {
+            if (line.compare(0, 8, "[device ") == 0) {
+                currentLayer = -1;
+                currentDevice = ParseDeviceHeader(line);
+                if (currentDevice < 0) {
+                    std::cerr << "Invalid device header, skipping section: " << line << std::endl;
+                }
+                continue;
+            }
+            
+            currentDevice = 0;
+            currentLayer = ParseLayerHeader(line);
+            if (currentLayer < 0) {
+                std::cerr << "Invalid layer header, skipping section: " << line << std::endl;
+            }
+            continue;
+        }
+        
+        // Section the following mapping and turbo lines belong to (null while skipping)
+        std::map<int, KeyMapping>* sectionMappings = nullptr;
+        if (currentDevice > 0) {
+            sectionMappings = &m_devices[currentDevice - 1].mappings;
+        } else if (currentLayer >= 0) {
+            sectionMappings = &m_layers[currentLayer].mappings;
+        }
+        
         // Check for configuration options
         const std::string configKey = "hold_triggers_continuous_tap=";
         if (line.find(configKey) == 0) {
@@ -91,26 +784,177 @@ bool ConfigManager::LoadMappings() {
             continue;
         }
         
+        const std::string resolveWindowKey = "chord_resolve_window_ms=";
+        if (line.find(resolveWindowKey) == 0) {
+            int value = atoi(line.substr(resolveWindowKey.length()).c_str());
+            if (value < 0) value = 0;
+            if (value > MAX_CHORD_RESOLVE_WINDOW_MS) value = MAX_CHORD_RESOLVE_WINDOW_MS;
+            m_chordResolveWindowMs = value;
+            continue;
+        }
+        
+        const std::string defaultTurboKey = "continuous_tap_turbo=";
+        if (line.find(defaultTurboKey) == 0) {
+            std::istringstream iss(line.substr(defaultTurboKey.length()));
+            if (!ParseTurboSettings(iss, m_defaultTurboRateHz, m_defaultTurboDutyPercent) ||
+                m_defaultTurboRateHz == 0) {
+                m_defaultTurboRateHz = DEFAULT_TURBO_RATE_HZ;
+            }
+            continue;
+        }
+        
+        const std::string framePacingKey = "frame_pacing_lead_us=";
+        if (line.find(framePacingKey) == 0) {
+            int value = atoi(line.substr(framePacingKey.length()).c_str());
+            if (value < 0) value = 0;
+            if (value > MAX_FRAME_PACING_LEAD_US) value = MAX_FRAME_PACING_LEAD_US;
+            m_framePacingLeadUs = value;
+            continue;
+        }
+        
+        const std::string gamepadKey = "gamepad=";
+        if (line.find(gamepadKey) == 0) {
+            std::string value = line.substr(gamepadKey.length());
+            m_gamepadEnabled = (value == "1" || value == "true");
+            continue;
+        }
+        
+        const std::string controlIpcKey = "control_ipc=";
+        if (line.find(controlIpcKey) == 0) {
+            std::string value = line.substr(controlIpcKey.length());
+            m_controlIpcEnabled = (value == "1" || value == "true");
+            continue;
+        }
+        
+        const std::string eventStreamKey = "event_stream=";
+        if (line.find(eventStreamKey) == 0) {
+            std::string value = line.substr(eventStreamKey.length());
+            m_eventStreamEnabled = (value == "1" || value == "true");
+            continue;
+        }
+        
+        const std::string consumeKey = "consume_mapped_keys=";
+        if (line.find(consumeKey) == 0) {
+            std::string value = line.substr(consumeKey.length());
+            m_consumeMappedKeys = (value == "1" || value == "true");
+            continue;
+        }
+        
+        const std::string usageStatsKey = "usage_stats=";
+        if (line.find(usageStatsKey) == 0) {
+            std::string value = line.substr(usageStatsKey.length());
+            m_usageStatsEnabled = (value == "1" || value == "true");
+            continue;
+        }
+        
+        const std::string traceKey = "trace=";
+        if (line.find(traceKey) == 0) {
+            std::string value = line.substr(traceKey.length());
+            m_traceEnabled = (value == "1" || value == "true");
+            continue;
+        }
+        
+        const std::string touchLogKey = "log_touches=";
+        if (line.find(touchLogKey) == 0) {
+            std::string value = line.substr(touchLogKey.length());
+            m_touchLogEnabled = (value == "1" || value == "true");
+            continue;
+        }
+        
+        const std::string stickKey = "stick=";
+        const std::string triggerKey = "trigger=";
+        if (line.find(stickKey) == 0 || line.find(triggerKey) == 0) {
+            bool isStick = (line.find(stickKey) == 0);
+            if (!ParseAnalog(line.substr(isStick ? stickKey.length() : triggerKey.length()), isStick)) {
+                std::cerr << "Invalid analog definition: " << line << std::endl;
+            }
+            continue;
+        }
+        
+        const std::string targetWindowKey = "target_window=";
+        if (line.find(targetWindowKey) == 0) {
+            if (!ParseTargetWindow(line.substr(targetWindowKey.length()))) {
+                std::cerr << "Invalid target window: " << line << std::endl;
+            }
+            continue;
+        }
+        
+        const std::string mouseLookKey = "mouselook=";
+        if (line.find(mouseLookKey) == 0) {
+            if (!ParseMouseLook(line.substr(mouseLookKey.length()))) {
+                std::cerr << "Invalid mouse look definition: " << line << std::endl;
+            }
+            continue;
+        }
+        
+        const std::string pluginKey = "plugin=";
+        if (line.find(pluginKey) == 0) {
+            std::string path = line.substr(pluginKey.length());
+            if (path.empty()) {
+                std::cerr << "Invalid plugin line: " << line << std::endl;
+            } else {
+                m_pluginPaths.push_back(path);
+            }
+            continue;
+        }
+        
+        const std::string actionKey = "action=";
+        if (line.find(actionKey) == 0) {
+            std::istringstream iss(line.substr(actionKey.length()));
+            ActionBinding binding;
+            if (!(iss >> binding.virtualKey >> binding.name) || binding.virtualKey < 0 || binding.virtualKey > 255) {
+                std::cerr << "Invalid action binding: " << line << std::endl;
+            } else {
+                m_actionBindings.push_back(binding);
+            }
+            continue;
+        }
+        
+        const std::string turboKey = "turbo=";
+        if (line.find(turboKey) == 0) {
+            if (sectionMappings == nullptr || !ParseTurbo(line.substr(turboKey.length()), *sectionMappings)) {
+                std::cerr << "Invalid turbo definition: " << line << std::endl;
+            }
+            continue;
+        }
+        
+        const std::string contactKey = "contact=";
+        if (line.find(contactKey) == 0) {
+            if (sectionMappings == nullptr || !ParseContact(line.substr(contactKey.length()), *sectionMappings)) {
+                std::cerr << "Invalid contact definition: " << line << std::endl;
+            }
+            continue;
+        }
+        
+        const std::string chordKey = "chord=";
+        if (line.find(chordKey) == 0) {
+            if (!ParseChord(line.substr(chordKey.length()))) {
+                std::cerr << "Invalid chord definition: " << line << std::endl;
+            }
+            continue;
+        }
+        
+        const std::string bindKey = "bind=";
+        if (line.find(bindKey) == 0) {
+            if (!ParseBinding(line.substr(bindKey.length()))) {
+                std::cerr << "Invalid binding definition: " << line << std::endl;
+            }
+            continue;
+        }
+        
         std::istringstream iss(line);
         int virtualKey, x, y;
         std::string keyName;
         
-        if (iss >> virtualKey >> x >> y) {
+        if (sectionMappings != nullptr && iss >> virtualKey >> x >> y) {
             // Validate input ranges
             if (virtualKey < 0 || virtualKey > 255) {
                 std::cerr << "Invalid virtual key code: " << virtualKey << std::endl;
                 continue;
             }
             
-            // Get screen dimensions for validation
-            int screenWidth = GetSystemMetrics(SM_CXSCREEN);
-            int screenHeight = GetSystemMetrics(SM_CYSCREEN);
-            
             // Clamp coordinates to valid screen bounds
-            if (x < 0) x = 0;
-            if (x > screenWidth) x = screenWidth;
-            if (y < 0) y = 0;
-            if (y > screenHeight) y = screenHeight;
+            ClampToScreen(x, y);
             
             // Read the rest as key name
             std::getline(iss, keyName);
@@ -124,17 +968,34 @@ bool ConfigManager::LoadMappings() {
             mapping.x = x;
             mapping.y = y;
             mapping.keyName = keyName.empty() ? GetKeyName(virtualKey) : keyName;
+            BuildContact(mapping);
             
-            m_mappings[virtualKey] = mapping;
+            (*sectionMappings)[virtualKey] = mapping;
         }
     }
     
     file.close();
-    std::cout << "Loaded " << m_mappings.size() << " key mappings." << std::endl;
+    ResolveLayers();
+    BuildBindings();
+    PlaceContacts();
+    
+    size_t mappingCount = 0;
+    for (const auto& layer : m_layers) {
+        mappingCount += layer.mappings.size();
+    }
+    for (const auto& device : m_devices) {
+        mappingCount += device.mappings.size();
+    }
+    std::cout << "Loaded " << mappingCount << " key mappings, "
+              << m_bindings.size() << " bindings, "
+              << m_chords.size() << " chords, "
+              << (m_layers.size() - 1) << " layers and "
+              << m_devices.size() << " devices." << std::endl;
     return true;
 }
 
 bool ConfigManager::SaveMappings() {
+    TraceScope trace(TRACE_CONFIG_SAVE);
     std::ofstream file(m_configFile);
     if (!file.is_open()) {
         std::cerr << "Failed to open config file for writing: " << m_configFile << std::endl;
@@ -146,29 +1007,181 @@ bool ConfigManager::SaveMappings() {
     file << "#" << std::endl;
     file << "# Configuration Options:" << std::endl;
     file << "# hold_triggers_continuous_tap=0  (0=hold maintains touch, 1=hold triggers repeated taps)" << std::endl;
+    file << "# chord_resolve_window_ms=30      (wait for the rest of a chord after one of its keys is pressed)" << std::endl;
+    file << "# continuous_tap_turbo=15 50      (continuous tap mode rate in taps/s and duty cycle in %)" << std::endl;
+    file << "# frame_pacing_lead_us=0          (send touches this many us before each display refresh; 0=immediately)" << std::endl;
+    file << "# gamepad=0                       (1=read an XInput controller; buttons map like keys, VK 195-218)" << std::endl;
+    file << "# control_ipc=0                   (1=accept commands on a local pipe and publish a shared stats page)" << std::endl;
+    file << "# event_stream=0                  (1=broadcast key and touch events to shared memory for other tools)" << std::endl;
+    file << "# consume_mapped_keys=1           (1=mapped keys do not reach other applications while mapping)" << std::endl;
+    file << "# usage_stats=0                   (1=count presses and hold times per key into <config>_usage.txt)" << std::endl;
+    file << "# trace=0                         (1=record input pipeline spans; Ctrl+Shift+P/exit write <config>_trace.json)" << std::endl;
+    file << "# log_touches=0                   (1=print every touch and turbo change to the console)" << std::endl;
+    file << "#" << std::endl;
+    file << "# Turbo: turbo=VK RATE DUTY after a mapping line taps it RATE times/s while held" << std::endl;
+    file << "# Contact: contact=VK RADIUS PRESSURE ORIENTATION after a mapping line sets its touch size," << std::endl;
+    file << "#         pressure (1-1024) and orientation (degrees)" << std::endl;
+    file << "# Chords: chord=VK+VK+... X Y KeyName  (keys held together, e.g. chord=16+49 300 300 Shift+1)" << std::endl;
+    file << "# Bindings: bind=[Ctrl+][Shift+][Alt+][Win+][Ext+]VK|scNN X Y KeyName fires only with exactly" << std::endl;
+    file << "#         those modifiers held (e.g. bind=Ctrl+87 for Ctrl+W, bind=Ext+sc28 for numpad Enter)" << std::endl;
+    file << "# Layers: [layer NAME hold|toggle VK] starts a section of mappings stacked on the base layer;" << std::endl;
+    file << "#         keys a layer does not map fall through to the layers below" << std::endl;
+    file << "# Devices: [device ALIAS PATTERN] starts a section of mappings used only for keys from" << std::endl;
+    file << "#         the keyboard whose device name contains PATTERN (e.g. VID_046D&PID_C31C)" << std::endl;
+    file << "# Sticks: stick=left|right CX CY RADIUS drags a touch around CX,CY while the stick is pushed" << std::endl;
+    file << "# Triggers: trigger=left|right X1 Y1 X2 Y2 drags a touch from X1,Y1 towards X2,Y2 as it is pulled" << std::endl;
+    file << "# Target window: target_window=WIDTH HEIGHT TITLE makes every position relative to the client" << std::endl;
+    file << "#         area of the window whose title contains TITLE, set at a WIDTH x HEIGHT client size" << std::endl;
+    file << "# Mouse look: mouselook=LEFT TOP RIGHT BOTTOM SENSITIVITY drags a touch inside the region with" << std::endl;
+    file << "#         the mouse (Ctrl+Shift+L in mapping mode); SENSITIVITY is touch pixels per 100 mouse counts" << std::endl;
+    file << "# Plugins: plugin=PATH loads a plugin DLL; action=VK NAME runs the action NAME it registered" << std::endl;
+    file << "#         for that key while mapping, instead of the key's own mapping" << std::endl;
     file << std::endl;
     
-    // Write configuration option
+    // Write configuration options
     file << "hold_triggers_continuous_tap=" << (m_holdTriggersContinuousTap ? "1" : "0") << std::endl;
+    file << "chord_resolve_window_ms=" << m_chordResolveWindowMs << std::endl;
+    file << "continuous_tap_turbo=" << m_defaultTurboRateHz << " " << m_defaultTurboDutyPercent << std::endl;
+    file << "frame_pacing_lead_us=" << m_framePacingLeadUs << std::endl;
+    file << "gamepad=" << (m_gamepadEnabled ? "1" : "0") << std::endl;
+    file << "control_ipc=" << (m_controlIpcEnabled ? "1" : "0") << std::endl;
+    file << "event_stream=" << (m_eventStreamEnabled ? "1" : "0") << std::endl;
+    file << "consume_mapped_keys=" << (m_consumeMappedKeys ? "1" : "0") << std::endl;
+    file << "usage_stats=" << (m_usageStatsEnabled ? "1" : "0") << std::endl;
+    file << "trace=" << (m_traceEnabled ? "1" : "0") << std::endl;
+    file << "log_touches=" << (m_touchLogEnabled ? "1" : "0") << std::endl;
+    if (!m_targetWindowTitle.empty()) {
+        file << "target_window=" << m_targetWidth << " " << m_targetHeight << " " << m_targetWindowTitle << std::endl;
+    }
     file << std::endl;
     
-    for (const auto& pair : m_mappings) {
+    WriteMappings(file, m_layers[BASE_LAYER].mappings);
+    
+    for (const auto& chord : m_chords) {
+        file << "chord=";
+        bool first = true;
+        for (int virtualKey = 0; virtualKey < 256; ++virtualKey) {
+            if (chord.keys.Test(virtualKey)) {
+                if (!first) file << "+";
+                file << virtualKey;
+                first = false;
+            }
+        }
+        file << " " << chord.x << " " << chord.y << " " << chord.keyName << std::endl;
+    }
+    
+    for (const auto& pair : m_bindings) {
+        file << "bind=" << FormatBindingKey(pair.first) << " " << pair.second.x << " "
+             << pair.second.y << " " << pair.second.keyName << std::endl;
+    }
+    
+    for (int axis = 0; axis < GAMEPAD_AXIS_COUNT; ++axis) {
+        const AnalogMapping& analog = m_analog[axis];
+        if (!analog.enabled) {
+            continue;
+        }
+        bool isLeft = (axis == GAMEPAD_LEFT_STICK || axis == GAMEPAD_LEFT_TRIGGER);
+        if (axis == GAMEPAD_LEFT_STICK || axis == GAMEPAD_RIGHT_STICK) {
+            file << "stick=" << (isLeft ? "left" : "right") << " " << analog.x << " " << analog.y
+                 << " " << analog.radius << std::endl;
+        } else {
+            file << "trigger=" << (isLeft ? "left" : "right") << " " << analog.x << " " << analog.y
+                 << " " << analog.endX << " " << analog.endY << std::endl;
+        }
+    }
+    
+    if (m_mouseLook.enabled) {
+        file << "mouselook=" << m_mouseLook.left << " " << m_mouseLook.top << " " << m_mouseLook.right
+             << " " << m_mouseLook.bottom << " " << m_mouseLook.sensitivityPercent << std::endl;
+    }
+    
+    for (const auto& path : m_pluginPaths) {
+        file << "plugin=" << path << std::endl;
+    }
+    for (const auto& binding : m_actionBindings) {
+        file << "action=" << binding.virtualKey << " " << binding.name << std::endl;
+    }
+    
+    for (size_t i = 1; i < m_layers.size(); ++i) {
+        const KeyLayer& layer = m_layers[i];
+        file << std::endl;
+        file << "[layer " << layer.name << " "
+             << (layer.activation == LayerActivation::TOGGLE ? "toggle" : "hold") << " "
+             << layer.activationKey << "]" << std::endl;
+        WriteMappings(file, layer.mappings);
+    }
+    
+    for (const auto& device : m_devices) {
+        file << std::endl;
+        file << "[device " << device.alias << " " << device.pattern << "]" << std::endl;
+        WriteMappings(file, device.mappings);
+    }
+    
+    file.close();
+    return true;
+}
+
+void ConfigManager::WriteMappings(std::ofstream& file, const std::map<int, KeyMapping>& mappings) {
+    for (const auto& pair : mappings) {
         file << pair.first << " " 
              << pair.second.x << " " 
              << pair.second.y << " " 
              << pair.second.keyName << std::endl;
+        
+        if (pair.second.turboRateHz > 0) {
+            file << "turbo=" << pair.first << " " << pair.second.turboRateHz
+                 << " " << pair.second.turboDutyPercent << std::endl;
+        }
+        
+        if (pair.second.contactRadius > 0) {
+            file << "contact=" << pair.first << " " << pair.second.contactRadius << " "
+                 << pair.second.contactPressure << " " << pair.second.contactOrientation << std::endl;
+        }
     }
-    
-    file.close();
-    return true;
 }
 
 const std::map<int, KeyMapping>& ConfigManager::GetAllMappings() const {
-    return m_mappings;
+    return m_layers[BASE_LAYER].mappings;
+}
+
+std::map<int, KeyMapping> ConfigManager::GetActiveMappings() const {
+    std::map<int, KeyMapping> active;
+    for (int virtualKey = 0; virtualKey < 256; ++virtualKey) {
+        if (m_resolved[0][virtualKey] != nullptr) {
+            active[virtualKey] = *m_resolved[0][virtualKey];
+        }
+    }
+    return active;
+}
+
+const KeyMapping* const* ConfigManager::GetResolvedMappings(int device) const {
+    if (device < 0 || device > MAX_KEY_DEVICES) {
+        device = 0;
+    }
+    return m_resolved[device];
+}
+
+const std::vector<ChordMapping>& ConfigManager::GetAllChords() const {
+    return m_chords;
 }
 
 void ConfigManager::ClearMappings() {
-    m_mappings.clear();
+    // Layer definitions stay so their keys keep working
+    for (auto& layer : m_layers) {
+        layer.mappings.clear();
+    }
+    for (auto& device : m_devices) {
+        device.mappings.clear();
+    }
+    m_chords.clear();
+    m_bindings.clear();
+    for (auto& analog : m_analog) {
+        analog = AnalogMapping();
+    }
+    m_mouseLook = MouseLookMapping();
+    PlaceContacts();
+    ResolveLayers();
+    BuildBindings();
     SaveMappings();
 }
 
@@ -180,3 +1193,199 @@ void ConfigManager::SetHoldTriggersContinuousTap(bool enabled) {
     m_holdTriggersContinuousTap = enabled;
     SaveMappings();
 }
+
+int ConfigManager::GetChordResolveWindowMs() const {
+    return m_chordResolveWindowMs;
+}
+
+int ConfigManager::GetDefaultTurboRateHz() const {
+    return m_defaultTurboRateHz;
+}
+
+int ConfigManager::GetDefaultTurboDutyPercent() const {
+    return m_defaultTurboDutyPercent;
+}
+
+int ConfigManager::GetFramePacingLeadUs() const {
+    return m_framePacingLeadUs;
+}
+
+bool ConfigManager::IsControlIpcEnabled() const {
+    return m_controlIpcEnabled;
+}
+
+bool ConfigManager::IsEventStreamEnabled() const {
+    return m_eventStreamEnabled;
+}
+
+bool ConfigManager::IsConsumeMappedKeysEnabled() const {
+    return m_consumeMappedKeys;
+}
+
+bool ConfigManager::IsUsageStatsEnabled() const {
+    return m_usageStatsEnabled;
+}
+
+bool ConfigManager::IsTraceEnabled() const {
+    return m_traceEnabled;
+}
+
+bool ConfigManager::IsTouchLogEnabled() const {
+    return m_touchLogEnabled;
+}
+
+const std::string& ConfigManager::GetConfigFile() const {
+    return m_configFile;
+}
+
+bool ConfigManager::SetConfigFile(const std::string& configFile) {
+    std::ifstream file(configFile);
+    if (!file.is_open()) {
+        std::cerr << "Config file not found: " << configFile << std::endl;
+        return false;
+    }
+    file.close();
+    
+    // The current profile is saved on every change, so it can simply be left
+    m_configFile = configFile;
+    return LoadMappings();
+}
+
+bool ConfigManager::IsGamepadEnabled() const {
+    return m_gamepadEnabled;
+}
+
+const AnalogMapping& ConfigManager::GetAnalogMapping(int axis) const {
+    return m_analogScreen[axis];
+}
+
+const MouseLookMapping& ConfigManager::GetMouseLookMapping() const {
+    return m_mouseLookScreen;
+}
+
+const std::vector<std::string>& ConfigManager::GetPluginPaths() const {
+    return m_pluginPaths;
+}
+
+const std::vector<ActionBinding>& ConfigManager::GetActionBindings() const {
+    return m_actionBindings;
+}
+
+int ConfigManager::GetLayerCount() const {
+    return static_cast<int>(m_layers.size());
+}
+
+const KeyLayer& ConfigManager::GetLayer(int layer) const {
+    return m_layers[layer];
+}
+
+KeyBitset ConfigManager::GetMappedKeys() const {
+    KeyBitset keys;
+    for (const auto& layer : m_layers) {
+        if (layer.activationKey >= 0) {
+            keys.Set(layer.activationKey);
+        }
+        for (const auto& pair : layer.mappings) {
+            keys.Set(pair.first);
+        }
+    }
+    keys.Merge(GetDeviceMappedKeys());
+    return keys;
+}
+
+KeyBitset ConfigManager::GetBindingKeys() const {
+    KeyBitset keys;
+    uint32_t modifiers = 0;
+    for (const auto& pair : m_bindings) {
+        keys.Set(GetBindingVirtualKey(pair.first));
+        modifiers |= pair.first & BINDING_MOD_MASK;
+    }
+    if (modifiers & BINDING_MOD_CTRL) keys.Set(VK_CONTROL);
+    if (modifiers & BINDING_MOD_SHIFT) keys.Set(VK_SHIFT);
+    if (modifiers & BINDING_MOD_ALT) keys.Set(VK_MENU);
+    if (modifiers & BINDING_MOD_WIN) { keys.Set(VK_LWIN); keys.Set(VK_RWIN); }
+    return keys;
+}
+
+int ConfigManager::GetDeviceCount() const {
+    return static_cast<int>(m_devices.size());
+}
+
+const KeyDevice& ConfigManager::GetDevice(int device) const {
+    return m_devices[device - 1];
+}
+
+KeyBitset ConfigManager::GetDeviceMappedKeys() const {
+    KeyBitset keys;
+    for (const auto& device : m_devices) {
+        for (const auto& pair : device.mappings) {
+            keys.Set(pair.first);
+        }
+    }
+    return keys;
+}
+
+int ConfigManager::GetLayerForKey(int virtualKey) const {
+    if (virtualKey < 0 || virtualKey > 255) {
+        return -1;
+    }
+    return m_layerKeys[virtualKey];
+}
+
+void ConfigManager::SetLayerActive(int layer, bool active) {
+    // The base layer is always active
+    if (layer <= BASE_LAYER || layer >= static_cast<int>(m_layers.size())) {
+        return;
+    }
+    
+    uint32_t activeLayers = active ? (m_activeLayers | (1u << layer))
+                                   : (m_activeLayers & ~(1u << layer));
+    if (activeLayers != m_activeLayers) {
+        m_activeLayers = activeLayers;
+        ResolveLayers();
+    }
+}
+
+bool ConfigManager::IsLayerActive(int layer) const {
+    return layer >= 0 && layer < MAX_LAYERS && (m_activeLayers & (1u << layer)) != 0;
+}
+
+int ConfigManager::GetTopActiveLayer() const {
+    for (int layer = static_cast<int>(m_layers.size()) - 1; layer > BASE_LAYER; --layer) {
+        if (IsLayerActive(layer)) {
+            return layer;
+        }
+    }
+    return BASE_LAYER;
+}
+
+void ConfigManager::ResolveLayers() {
+    // Flatten bottom-up so higher active layers override lower ones;
+    // keys a layer leaves unmapped keep the lower layer's entry
+    for (int virtualKey = 0; virtualKey < 256; ++virtualKey) {
+        m_resolved[0][virtualKey] = nullptr;
+        m_layerKeys[virtualKey] = -1;
+    }
+    
+    for (size_t layer = 0; layer < m_layers.size(); ++layer) {
+        if (layer != BASE_LAYER && m_layers[layer].activationKey >= 0) {
+            m_layerKeys[m_layers[layer].activationKey] = static_cast<int>(layer);
+        }
+        
+        if (!IsLayerActive(static_cast<int>(layer))) continue;
+        
+        for (const auto& pair : m_layers[layer].mappings) {
+            m_resolved[0][pair.first] = &pair.second;
+        }
+    }
+    
+    // Each device table is the layered table with the device's own mappings on top
+    for (int device = 1; device <= MAX_KEY_DEVICES; ++device) {
+        memcpy(m_resolved[device], m_resolved[0], sizeof(m_resolved[0]));
+        if (device > static_cast<int>(m_devices.size())) continue;
+        
+        for (const auto& pair : m_devices[device - 1].mappings) {
+            m_resolved[device][pair.first] = &pair.second;
+        }
+    }
+}
@@ -5,49 +5,352 @@
 #include <string>
 #include <map>
 #include <fstream>
+#include <vector>
+#include <cstdint>
+#include "KeyState.h"
+#include "BindingTable.h"
+
+// Most input devices that can have their own mappings (device 0 is "any device")
+#define MAX_KEY_DEVICES 8
 
 struct KeyMapping {
     int x;
     int y;
     std::string keyName;
+    int turboRateHz = 0;        // Taps per second while held (0 = no turbo)
+    int turboDutyPercent = 50;  // Share of each turbo period the touch is down
+    int contactRadius = 0;      // Contact area half-size in pixels (0 = default shape)
+    int contactPressure = 0;
+    int contactOrientation = 0; // Degrees
+    POINTER_TOUCH_INFO contact = {};  // Prebuilt from the fields above (see BuildContactTemplate)
+    int screenX = 0;            // x, y on screen (they differ when anchored to a target window)
+    int screenY = 0;
+};
+
+// A set of keys that must be held together to trigger a touch (e.g. Shift+1)
+struct ChordMapping {
+    KeyBitset keys;
+    int x;
+    int y;
+    std::string keyName;
+    POINTER_TOUCH_INFO contact = {};  // Prebuilt default-shape contact at x, y
+};
+
+// How a layer is switched on
+enum class LayerActivation {
+    HOLD,    // Active while its key is held
+    TOGGLE   // Each press flips it on or off
+};
+
+// A named set of mappings stacked on top of the base layer.
+// Keys a layer does not map fall through to the layers below it.
+struct KeyLayer {
+    std::string name;
+    LayerActivation activation;
+    int activationKey;
+    std::map<int, KeyMapping> mappings;
+};
+
+// A keyboard (or macro pad) with its own mappings, matched by device name.
+// Keys it does not map fall through to the layered mappings.
+struct KeyDevice {
+    std::string alias;
+    std::string pattern;  // Substring of the device interface name, e.g. VID_046D&PID_C31C
+    std::map<int, KeyMapping> mappings;
+};
+
+// Gamepad sticks and triggers that can drive a drag contact
+enum GamepadAxis {
+    GAMEPAD_LEFT_STICK,
+    GAMEPAD_RIGHT_STICK,
+    GAMEPAD_LEFT_TRIGGER,
+    GAMEPAD_RIGHT_TRIGGER,
+    GAMEPAD_AXIS_COUNT
+};
+
+// A touch dragged by a stick (around a center) or a trigger (along a line).
+// The contact goes down when the axis leaves its rest position and up when it returns.
+struct AnalogMapping {
+    bool enabled = false;
+    int x = 0;       // Stick center, or trigger released position
+    int y = 0;
+    int radius = 0;  // Stick: distance at full deflection
+    int endX = 0;    // Trigger: fully pressed position
+    int endY = 0;
+};
+
+// A touch dragged by relative mouse motion inside a region (camera control).
+// The contact goes down at the center and is lifted and re-centered when it
+// reaches an edge.
+struct MouseLookMapping {
+    bool enabled = false;
+    int left = 0;
+    int top = 0;
+    int right = 0;
+    int bottom = 0;
+    int sensitivityPercent = 100;  // Touch pixels per 100 mouse counts
+};
+
+// Key bound to a plugin action by name (action=VK NAME)
+struct ActionBinding {
+    int virtualKey;
+    std::string name;
 };
 
 class ConfigManager {
 public:
     ConfigManager(const std::string& configFile = "keymap_config.txt");
     ~ConfigManager();
-
-    // Save a key mapping
+    
+    // Save a key mapping (into the highest active layer)
     bool SaveMapping(int virtualKey, int x, int y, const std::string& keyName);
     
-    // Get mapping for a key
-    bool GetMapping(int virtualKey, KeyMapping& mapping);
+    // Get mapping for a key as resolved through the active layers (and the device's own mappings).
+    // Points into the config (no copy); valid until the mappings or active layers change.
+    const KeyMapping* GetMapping(int virtualKey, int device = 0) const;
     
-    // Remove a mapping
+    // Remove a mapping (from the highest active layer that defines it)
     bool RemoveMapping(int virtualKey);
     
+    // Move a mapping to a new position (in the highest active layer that defines it),
+    // keeping its name and options
+    bool MoveMapping(int virtualKey, int x, int y);
+    
     // Load all mappings from file
     bool LoadMappings();
     
     // Save all mappings to file
     bool SaveMappings();
     
-    // Get all mappings (for display)
+    // Get all base layer mappings
     const std::map<int, KeyMapping>& GetAllMappings() const;
     
+    // Get the mappings in effect with the current active layers (copies; for status)
+    std::map<int, KeyMapping> GetActiveMappings() const;
+    
+    // Resolved lookup table for a device: 256 entries, null where unmapped.
+    // A view for display; valid until the mappings or active layers change.
+    const KeyMapping* const* GetResolvedMappings(int device = 0) const;
+    
+    // Keyboard layout name of a key as UTF-8 ("VK_<code>" if it has none)
+    static std::string GetKeyName(int virtualKey);
+    
+    // Save a chord mapping (keys are virtual key codes held together)
+    bool SaveChord(const std::vector<int>& virtualKeys, int x, int y, const std::string& keyName);
+    
+    // Get the mapping bound to a packed key (modifiers, extended flag and VK or
+    // scancode, see BindingTable.h), or null. Constant time through the
+    // perfect hash built when the profile is loaded.
+    const KeyMapping* FindBinding(uint32_t bindingKey) const;
+    
+    // Get all qualified bindings by packed key
+    const std::map<uint32_t, KeyMapping>& GetAllBindings() const;
+    
+    // Get all chord mappings (index is the chord ID)
+    const std::vector<ChordMapping>& GetAllChords() const;
+    
     // Clear all mappings
     void ClearMappings();
     
     // Get/Set hold behavior configuration
     bool GetHoldTriggersContinuousTap() const;
     void SetHoldTriggersContinuousTap(bool enabled);
+    
+    // Time to wait for the rest of a chord after one of its keys is pressed
+    int GetChordResolveWindowMs() const;
+    
+    // Turbo rate/duty used by continuous tap mode for keys without their own turbo
+    int GetDefaultTurboRateHz() const;
+    int GetDefaultTurboDutyPercent() const;
+    
+    // Lead before each display refresh at which touch frames are sent (0 = no frame pacing)
+    int GetFramePacingLeadUs() const;
+    
+    // Control pipe and shared stats page for external tools
+    bool IsControlIpcEnabled() const;
+    
+    // Key and contact records broadcast to shared memory for external tools
+    bool IsEventStreamEnabled() const;
+    
+    // Mapped keys are kept from other applications while mapping
+    bool IsConsumeMappedKeysEnabled() const;
+    
+    // Per-key press counts and hold times, snapshotted to a file
+    bool IsUsageStatsEnabled() const;
+    
+    // Input pipeline spans recorded for a trace viewer
+    bool IsTraceEnabled() const;
+    
+    // Every touch and turbo change printed to the console (per key press)
+    bool IsTouchLogEnabled() const;
+    
+    // Config file in use; switching loads the new file (profiles)
+    const std::string& GetConfigFile() const;
+    bool SetConfigFile(const std::string& configFile);
+    
+    // Gamepad input (buttons map like keys via their VK_GAMEPAD_* codes)
+    bool IsGamepadEnabled() const;
+    const AnalogMapping& GetAnalogMapping(int axis) const;
+    
+    // Mouse look region and sensitivity (enabled only if configured)
+    const MouseLookMapping& GetMouseLookMapping() const;
+    
+    // Plugin DLLs to load (plugin=PATH) and keys bound to their actions
+    const std::vector<std::string>& GetPluginPaths() const;
+    const std::vector<ActionBinding>& GetActionBindings() const;
+    
+    // Target window (target_window=WIDTH HEIGHT TITLE): all positions are relative
+    // to the client area of the window whose title contains TITLE, and were set
+    // with that area WIDTH x HEIGHT. Empty title: positions are screen pixels.
+    const std::string& GetTargetWindowTitle() const;
+    
+    // Place the target window's client area (screen rectangle) and rebuild every
+    // prebuilt contact and the analog and mouse look positions from it, so touches
+    // stay a table read. An empty rectangle keeps the current placement.
+    void SetTargetWindowRect(const RECT& client);
+    
+    // Convert a position between the config (window-relative) and the screen
+    void ToScreen(int& x, int& y) const;
+    void FromScreen(int& x, int& y) const;
+    
+    // Layers (layer 0 is the always-active base layer)
+    int GetLayerCount() const;
+    const KeyLayer& GetLayer(int layer) const;
+    
+    // Get every key mapped in any layer, plus the layer keys
+    KeyBitset GetMappedKeys() const;
+    
+    // Get the keys bindings are pressed with: their base keys and the
+    // modifiers they require (generic Shift/Ctrl/Alt codes, both Win keys).
+    // A base key without its modifiers is not mapped, so these are not consumed.
+    KeyBitset GetBindingKeys() const;
+    
+    // Get the layer switched by a key, or -1 if the key is not a layer key
+    int GetLayerForKey(int virtualKey) const;
+    
+    // Activate or deactivate a layer; re-resolves the lookup table
+    void SetLayerActive(int layer, bool active);
+    bool IsLayerActive(int layer) const;
+    
+    // Get the highest active layer
+    int GetTopActiveLayer() const;
+    
+    // Devices with their own mappings (device IDs 1..GetDeviceCount())
+    int GetDeviceCount() const;
+    const KeyDevice& GetDevice(int device) const;
+    
+    // Get every key some device maps on its own
+    KeyBitset GetDeviceMappedKeys() const;
 
 private:
     std::string m_configFile;
-    std::map<int, KeyMapping> m_mappings;
+    std::vector<KeyLayer> m_layers;
+    std::vector<ChordMapping> m_chords;
+    std::vector<KeyDevice> m_devices;
+    uint32_t m_activeLayers;
+    
+    // Qualified bindings, and their perfect hash (binding ID -> m_bindingList entry)
+    std::map<uint32_t, KeyMapping> m_bindings;
+    std::vector<const KeyMapping*> m_bindingList;
+    BindingTable m_bindingTable;
+    
+    // Flattened layer stack per device (row 0 = any device): one entry per VK, null when unmapped
+    const KeyMapping* m_resolved[MAX_KEY_DEVICES + 1][256];
+    
+    // Layer switched by each VK (-1 for none)
+    int m_layerKeys[256];
+    
     bool m_holdTriggersContinuousTap;
+    int m_chordResolveWindowMs;
+    int m_defaultTurboRateHz;
+    int m_defaultTurboDutyPercent;
+    int m_framePacingLeadUs;
+    bool m_gamepadEnabled;
+    bool m_controlIpcEnabled;
+    bool m_eventStreamEnabled;
+    bool m_consumeMappedKeys;
+    bool m_usageStatsEnabled;
+    bool m_traceEnabled;
+    bool m_touchLogEnabled;
+    AnalogMapping m_analog[GAMEPAD_AXIS_COUNT];
+    MouseLookMapping m_mouseLook;
+    std::vector<std::string> m_pluginPaths;
+    std::vector<ActionBinding> m_actionBindings;
+    
+    // Target window, the client size positions were set at, and where its client area is now
+    std::string m_targetWindowTitle;
+    int m_targetWidth;
+    int m_targetHeight;
+    RECT m_targetClient;
+    
+    // Analog and mouse look mappings in screen pixels (what the getters return)
+    AnalogMapping m_analogScreen[GAMEPAD_AXIS_COUNT];
+    MouseLookMapping m_mouseLookScreen;
+    
+    // Clamp coordinates to valid screen bounds
+    void ClampToScreen(int& x, int& y);
+    
+    // Set every configuration option to its default
+    void ResetOptions();
+    
+    // Parse a "chord=VK+VK+... X Y KeyName" line
+    bool ParseChord(const std::string& value);
+    
+    // Parse a "bind=[Ctrl+][Shift+][Alt+][Win+][Ext+]VK|scNN X Y KeyName" line
+    bool ParseBinding(const std::string& value);
+    
+    // Convert between the text form of a binding key and its packed form
+    static bool ParseBindingKey(const std::string& text, uint32_t& bindingKey);
+    static std::string FormatBindingKey(uint32_t bindingKey);
+    
+    // Default name of a binding, e.g. "Ctrl+W" or "Num Enter"
+    static std::string GetBindingName(uint32_t bindingKey);
+    
+    // Virtual key a binding is pressed with (for the hook filter)
+    static int GetBindingVirtualKey(uint32_t bindingKey);
+    
+    // Layout name of a scancode ("" if it has none)
+    static std::string GetScanCodeName(int scanCode, bool extended);
+    
+    // Rebuild the binding list and perfect hash after m_bindings changed
+    void BuildBindings();
+    
+    // Parse a "stick=left|right CX CY RADIUS" or "trigger=left|right X1 Y1 X2 Y2" line
+    bool ParseAnalog(const std::string& value, bool isStick);
+    
+    // Parse a "mouselook=LEFT TOP RIGHT BOTTOM SENSITIVITY" line
+    bool ParseMouseLook(const std::string& value);
+    
+    // Parse a "turbo=VK RATE DUTY" line for a mapping in the given section
+    bool ParseTurbo(const std::string& value, std::map<int, KeyMapping>& mappings);
+    
+    // Parse a "contact=VK RADIUS PRESSURE ORIENTATION" line for a mapping in the given section
+    bool ParseContact(const std::string& value, std::map<int, KeyMapping>& mappings);
+    
+    // Prebuild the contact record injected for a mapping (at its screen position)
+    void BuildContact(KeyMapping& mapping);
+    void BuildChordContact(ChordMapping& chord);
+    
+    // Rebuild every screen position after the target window placement changed
+    void PlaceContacts();
+    
+    // Parse a "target_window=WIDTH HEIGHT TITLE" line
+    bool ParseTargetWindow(const std::string& value);
+    
+    // Parse "RATE DUTY" turbo settings, clamped to the supported range
+    bool ParseTurboSettings(std::istream& in, int& rateHz, int& dutyPercent);
+    
+    // Write a layer's mapping lines (and their per-mapping options)
+    void WriteMappings(std::ofstream& file, const std::map<int, KeyMapping>& mappings);
+    
+    // Parse a "[layer NAME hold|toggle VK]" header; returns the layer index or -1
+    int ParseLayerHeader(const std::string& line);
+    
+    // Parse a "[device ALIAS PATTERN]" header; returns the device ID or -1
+    int ParseDeviceHeader(const std::string& line);
     
-    std::string GetKeyName(int virtualKey);
+    // Rebuild the resolved lookup tables from the active layers and device mappings
+    void ResolveLayers();
 };
 
 #endif // CONFIG_MANAGER_H
@@ -0,0 +1,229 @@
+#include "ControlServer.h"
+#include <iostream>
+
+#ifndef PIPE_REJECT_REMOTE_CLIENTS
+#define PIPE_REJECT_REMOTE_CLIENTS 0x00000008
+#endif
+
+// Room for the token's user SID and for the one-entry ACL granting it access
+#define CONTROL_SECURITY_BUFFER_SIZE 256
+
+// Fill descriptor with a DACL that grants the user this process runs as full
+// access and nobody else; tokenUser and acl back the descriptor and must
+// outlive its use
+static bool BuildUserOnlyDescriptor(DWORD_PTR* tokenUser, DWORD_PTR* acl, SECURITY_DESCRIPTOR& descriptor) {
+    HANDLE token = nullptr;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token)) {
+        return false;
+    }
+    DWORD size = 0;
+    BOOL gotUser = GetTokenInformation(token, TokenUser, tokenUser, CONTROL_SECURITY_BUFFER_SIZE, &size);
+    CloseHandle(token);
+    if (!gotUser) {
+        return false;
+    }
+    
+    PSID user = reinterpret_cast<TOKEN_USER*>(tokenUser)->User.Sid;
+    PACL list = reinterpret_cast<PACL>(acl);
+    return InitializeAcl(list, CONTROL_SECURITY_BUFFER_SIZE, ACL_REVISION)
+        && AddAccessAllowedAce(list, ACL_REVISION, FILE_ALL_ACCESS, user)
+        && InitializeSecurityDescriptor(&descriptor, SECURITY_DESCRIPTOR_REVISION)
+        && SetSecurityDescriptorDacl(&descriptor, TRUE, list, FALSE);
+}
+
+ControlServer::ControlServer()
+    : m_pipe(INVALID_HANDLE_VALUE)
+    , m_state(PipeState::CONNECTING)
+    , m_pending(false)
+    , m_handler(nullptr)
+    , m_handlerContext(nullptr) {
+    memset(&m_overlapped, 0, sizeof(m_overlapped));
+}
+
+ControlServer::~ControlServer() {
+    Shutdown();
+}
+
+bool ControlServer::Initialize() {
+    if (m_pipe != INVALID_HANDLE_VALUE) {
+        return true;
+    }
+    
+    // Manual-reset event, as overlapped pipe I/O requires
+    m_overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    if (m_overlapped.hEvent == nullptr) {
+        std::cerr << "Failed to create control pipe event. Error: " << GetLastError() << std::endl;
+        return false;
+    }
+    
+    // Commands can remap keys and switch profiles, so only the current user may
+    // open the pipe: the default DACL would also give Everyone read access
+    DWORD_PTR tokenUser[CONTROL_SECURITY_BUFFER_SIZE / sizeof(DWORD_PTR)];
+    DWORD_PTR acl[CONTROL_SECURITY_BUFFER_SIZE / sizeof(DWORD_PTR)];
+    SECURITY_DESCRIPTOR descriptor;
+    if (!BuildUserOnlyDescriptor(tokenUser, acl, descriptor)) {
+        std::cerr << "Failed to secure control pipe. Error: " << GetLastError() << std::endl;
+        CloseHandle(m_overlapped.hEvent);
+        m_overlapped.hEvent = nullptr;
+        return false;
+    }
+    SECURITY_ATTRIBUTES security = {};
+    security.nLength = sizeof(security);
+    security.lpSecurityDescriptor = &descriptor;
+    security.bInheritHandle = FALSE;
+    
+    // One client at a time, local machine only
+    m_pipe = CreateNamedPipeA(CONTROL_PIPE_NAME,
+                              PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+                              PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                              1, CONTROL_BUFFER_SIZE, CONTROL_BUFFER_SIZE, 0, &security);
+    if (m_pipe == INVALID_HANDLE_VALUE) {
+        std::cerr << "Failed to create control pipe. Error: " << GetLastError() << std::endl;
+        CloseHandle(m_overlapped.hEvent);
+        m_overlapped.hEvent = nullptr;
+        return false;
+    }
+    
+    Connect();
+    return true;
+}
+
+void ControlServer::Shutdown() {
+    if (m_pipe != INVALID_HANDLE_VALUE) {
+        // Closing the handle cancels any pending I/O
+        CancelIo(m_pipe);
+        DisconnectNamedPipe(m_pipe);
+        CloseHandle(m_pipe);
+        m_pipe = INVALID_HANDLE_VALUE;
+    }
+    if (m_overlapped.hEvent != nullptr) {
+        CloseHandle(m_overlapped.hEvent);
+        m_overlapped.hEvent = nullptr;
+    }
+    m_pending = false;
+}
+
+HANDLE ControlServer::GetWaitHandle() const {
+    return m_overlapped.hEvent;
+}
+
+void ControlServer::Poll() {
+    if (m_pipe == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    
+    // Each pass completes one I/O and starts the next; stops at the first one still in flight
+    while (true) {
+        if (m_pending) {
+            DWORD bytes = 0;
+            if (!GetOverlappedResult(m_pipe, &m_overlapped, &bytes, FALSE)) {
+                if (GetLastError() != ERROR_IO_INCOMPLETE) {
+                    Reconnect();  // Client went away
+                }
+                return;
+            }
+            m_pending = false;
+            
+            switch (m_state) {
+                case PipeState::CONNECTING:
+                    m_state = PipeState::READING;
+                    break;
+                case PipeState::READING:
+                    m_input.append(m_readBuffer, bytes);
+                    RunCommands();
+                    if (!m_output.empty()) {
+                        m_state = PipeState::WRITING;
+                    }
+                    break;
+                case PipeState::WRITING:
+                    m_output.erase(0, bytes);
+                    if (m_output.empty()) {
+                        m_state = PipeState::READING;
+                    }
+                    break;
+            }
+        }
+        
+        if (!StartIo()) {
+            return;
+        }
+    }
+}
+
+void ControlServer::Connect() {
+    m_state = PipeState::CONNECTING;
+    m_pending = false;
+    m_input.clear();
+    m_output.clear();
+    ResetEvent(m_overlapped.hEvent);
+    
+    if (ConnectNamedPipe(m_pipe, &m_overlapped)) {
+        m_pending = true;
+        return;
+    }
+    
+    switch (GetLastError()) {
+        case ERROR_IO_PENDING:
+            m_pending = true;
+            break;
+        case ERROR_PIPE_CONNECTED:
+            // Client connected between create and connect: go straight to reading
+            m_state = PipeState::READING;
+            SetEvent(m_overlapped.hEvent);
+            break;
+        default:
+            std::cerr << "Control pipe connect failed. Error: " << GetLastError() << std::endl;
+            break;
+    }
+}
+
+void ControlServer::Reconnect() {
+    CancelIo(m_pipe);
+    DisconnectNamedPipe(m_pipe);
+    Connect();
+}
+
+bool ControlServer::StartIo() {
+    BOOL result;
+    if (m_state == PipeState::READING) {
+        result = ReadFile(m_pipe, m_readBuffer, sizeof(m_readBuffer), nullptr, &m_overlapped);
+    } else if (m_state == PipeState::WRITING) {
+        DWORD length = static_cast<DWORD>(m_output.size() < CONTROL_BUFFER_SIZE ? m_output.size() : CONTROL_BUFFER_SIZE);
+        result = WriteFile(m_pipe, m_output.data(), length, nullptr, &m_overlapped);
+    } else {
+        // Connecting: the pending connect completes through the event
+        return false;
+    }
+    
+    if (result || GetLastError() == ERROR_IO_PENDING) {
+        m_pending = true;
+        return true;
+    }
+    
+    Reconnect();
+    return false;
+}
+
+void ControlServer::RunCommands() {
+    size_t newline;
+    while ((newline = m_input.find('\n')) != std::string::npos) {
+        std::string command = m_input.substr(0, newline);
+        m_input.erase(0, newline + 1);
+        
+        if (!command.empty() && command.back() == '\r') {
+            command.pop_back();
+        }
+        if (command.empty()) {
+            continue;
+        }
+        
+        std::string reply = m_handler ? m_handler(m_handlerContext, command) : "ERR no handler";
+        m_output += reply;
+        m_output += '\n';
+    }
+    
+    if (m_input.size() >= CONTROL_BUFFER_SIZE) {
+        m_input.clear();
+        m_output += "ERR line too long\n";
+    }
+}
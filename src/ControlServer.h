@@ -0,0 +1,81 @@
+#ifndef CONTROL_SERVER_H
+#define CONTROL_SERVER_H
+
+#include <windows.h>
+#include <string>
+
+// Name of the local control pipe
+#define CONTROL_PIPE_NAME "\\\\.\\pipe\\KeyboardMapTouch"
+
+// Pipe buffer size; also the longest command line accepted
+#define CONTROL_BUFFER_SIZE 4096
+
+// Accepts text commands (one per line) from local tools on a named pipe
+// and answers each with one reply line. All pipe I/O is overlapped: the
+// owner waits on GetWaitHandle() together with its other handles and calls
+// Poll() after waking, so commands run on the main thread between events.
+class ControlServer {
+public:
+    // Command handler: returns the reply line (without newline)
+    typedef std::string (*CommandHandlerProc)(void* context, const std::string& command);
+    
+    ControlServer();
+    ~ControlServer();
+    
+    // Create the pipe and start waiting for a client
+    bool Initialize();
+    
+    // Close the pipe
+    void Shutdown();
+    
+    // Bind the handler at compile time: SetCommandHandler<App, &App::OnCommand>(app)
+    template <class T, std::string (T::*Method)(const std::string&)>
+    void SetCommandHandler(T* target) {
+        m_handlerContext = target;
+        m_handler = &InvokeHandler<T, Method>;
+    }
+    
+    // Event signaled when pipe I/O completes (null before Initialize)
+    HANDLE GetWaitHandle() const;
+    
+    // Advance pending pipe I/O and run any complete commands; never blocks
+    void Poll();
+
+private:
+    enum class PipeState {
+        CONNECTING,  // Waiting for a client
+        READING,     // Waiting for a command
+        WRITING      // Sending a reply
+    };
+    
+    HANDLE m_pipe;
+    OVERLAPPED m_overlapped;
+    PipeState m_state;
+    bool m_pending;
+    
+    CommandHandlerProc m_handler;
+    void* m_handlerContext;
+    
+    char m_readBuffer[CONTROL_BUFFER_SIZE];
+    std::string m_input;   // Received text not yet ending in a newline
+    std::string m_output;  // Replies waiting to be written
+    
+    template <class T, std::string (T::*Method)(const std::string&)>
+    static std::string InvokeHandler(void* context, const std::string& command) {
+        return (static_cast<T*>(context)->*Method)(command);
+    }
+    
+    // Start waiting for the next client
+    void Connect();
+    
+    // Drop the current client and wait for a new one
+    void Reconnect();
+    
+    // Start an overlapped read or write for the current state
+    bool StartIo();
+    
+    // Run the complete lines in m_input, queueing their replies
+    void RunCommands();
+};
+
+#endif // CONTROL_SERVER_H
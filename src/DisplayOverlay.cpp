@@ -1,5 +1,7 @@
 #include "DisplayOverlay.h"
+#include "Tracer.h"
 #include <iostream>
+#include <cstring>
 #include <dwmapi.h>
 
 #pragma comment(lib, "dwmapi.lib")
@@ -9,16 +11,38 @@
 #define KEY_INDICATOR_RADIUS    30
 #define KEY_FONT_SIZE           20
 
+// Label atlas layout: one cell per virtual key, 16 x 16 cells
+#define LABEL_CELL_WIDTH        (KEY_INDICATOR_RADIUS * 2)
+#define LABEL_CELL_HEIGHT       20
+#define LABEL_ATLAS_COLUMNS     16
+
+// Edit mode: hit-test grid cell size and the spacing indicators snap to
+#define OVERLAY_GRID_CELL_SIZE  64
+#define OVERLAY_SNAP_SPACING    10
+
 DisplayOverlay* DisplayOverlay::s_instance = nullptr;
 
 DisplayOverlay::DisplayOverlay()
     : m_hwnd(nullptr)
-    , m_visible(false) {
+    , m_visible(false)
+    , m_mappings(nullptr)
+    , m_usage(nullptr)
+    , m_labelAtlasDC(nullptr)
+    , m_labelAtlasBitmap(nullptr)
+    , m_labelAtlasOldBitmap(nullptr)
+    , m_editMode(false)
+    , m_editHandler(nullptr)
+    , m_editContext(nullptr)
+    , m_dragKey(-1) {
+    memset(m_hasLabel, 0, sizeof(m_hasLabel));
+    m_dragPos.x = m_dragPos.y = 0;
+    m_dragOffset.x = m_dragOffset.y = 0;
     s_instance = this;
 }
 
 DisplayOverlay::~DisplayOverlay() {
     Destroy();
+    FreeLabelAtlas();
     s_instance = nullptr;
 }
 
@@ -43,7 +67,7 @@ bool DisplayOverlay::Create() {
     int screenHeight = GetSystemMetrics(SM_CYSCREEN);
     
     m_hwnd = CreateWindowExW(
-        WS_EX_LAYERED | WS_EX_TRANSPARENT | WS_EX_TOPMOST | WS_EX_TOOLWINDOW,
+        WS_EX_LAYERED | (m_editMode ? 0 : WS_EX_TRANSPARENT) | WS_EX_TOPMOST | WS_EX_TOOLWINDOW,
         CLASS_NAME,
         L"Keyboard Map Overlay",
         WS_POPUP,
@@ -75,14 +99,16 @@ void DisplayOverlay::Destroy() {
 }
 
 void DisplayOverlay::SetVisible(bool visible) {
+    // The window is created on first show
     if (m_hwnd == nullptr) {
-        if (visible) {
-            Create();
-        } else {
+        if (!visible || !Create()) {
             return;
         }
     }
     
+    if (!visible) {
+        CancelDrag();
+    }
     m_visible = visible;
     ShowWindow(m_hwnd, visible ? SW_SHOW : SW_HIDE);
     
@@ -96,8 +122,274 @@ bool DisplayOverlay::IsVisible() const {
     return m_visible;
 }
 
-void DisplayOverlay::UpdateMappings(const std::map<int, KeyMapping>& mappings) {
+void DisplayOverlay::SetMappings(const KeyMapping* const* mappings) {
+    // The dragged key may be gone from the new table
+    CancelDrag();
     m_mappings = mappings;
+    BuildLabelAtlas();
+    BuildGrid();
+    if (m_visible) {
+        Redraw();
+    }
+}
+
+void DisplayOverlay::BuildGrid() {
+    RECT bounds[256];
+    int ids[256];
+    int count = 0;
+    for (int virtualKey = 0; m_mappings != nullptr && virtualKey < 256; ++virtualKey) {
+        const KeyMapping* mapping = m_mappings[virtualKey];
+        if (mapping == nullptr) continue;
+        bounds[count] = GetIndicatorBounds(mapping->screenX, mapping->screenY);
+        ids[count] = virtualKey;
+        ++count;
+    }
+    
+    m_grid.Reset(GetSystemMetrics(SM_CXSCREEN), GetSystemMetrics(SM_CYSCREEN), OVERLAY_GRID_CELL_SIZE);
+    m_grid.Build(bounds, ids, count);
+}
+
+RECT DisplayOverlay::GetIndicatorBounds(int x, int y) {
+    // The label cell is as wide as the circle and lower; 2 pixels cover the pen
+    RECT bounds;
+    bounds.left = x - KEY_INDICATOR_RADIUS - 2;
+    bounds.top = y - KEY_INDICATOR_RADIUS - 2;
+    bounds.right = x + KEY_INDICATOR_RADIUS + 2;
+    bounds.bottom = y + KEY_INDICATOR_RADIUS + 2;
+    return bounds;
+}
+
+POINT DisplayOverlay::GetIndicatorPosition(int virtualKey) const {
+    if (virtualKey == m_dragKey) {
+        return m_dragPos;
+    }
+    POINT position = { m_mappings[virtualKey]->screenX, m_mappings[virtualKey]->screenY };
+    return position;
+}
+
+int DisplayOverlay::HitTest(int x, int y) const {
+    int count;
+    const int* candidates = m_grid.Query(x, y, count);
+    
+    // Overlapping indicators: the one whose center is nearest wins
+    int hitKey = -1;
+    int bestDistance = KEY_INDICATOR_RADIUS * KEY_INDICATOR_RADIUS + 1;
+    for (int i = 0; i < count; ++i) {
+        const KeyMapping* mapping = m_mappings[candidates[i]];
+        int dx = x - mapping->screenX;
+        int dy = y - mapping->screenY;
+        int distance = dx * dx + dy * dy;
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            hitKey = candidates[i];
+        }
+    }
+    return hitKey;
+}
+
+void DisplayOverlay::SetEditMode(bool enabled) {
+    if (!enabled) {
+        CancelDrag();
+    }
+    m_editMode = enabled;
+    
+    // Click-through only outside edit mode (a window not created yet gets the style on Create)
+    if (m_hwnd != nullptr) {
+        LONG_PTR exStyle = GetWindowLongPtrW(m_hwnd, GWL_EXSTYLE);
+        exStyle = enabled ? (exStyle & ~WS_EX_TRANSPARENT) : (exStyle | WS_EX_TRANSPARENT);
+        SetWindowLongPtrW(m_hwnd, GWL_EXSTYLE, exStyle);
+    }
+}
+
+bool DisplayOverlay::IsEditMode() const {
+    return m_editMode;
+}
+
+void DisplayOverlay::OnButtonDown(int x, int y) {
+    int virtualKey = HitTest(x, y);
+    if (virtualKey < 0) {
+        return;
+    }
+    
+    m_dragKey = virtualKey;
+    m_dragPos.x = m_mappings[virtualKey]->screenX;
+    m_dragPos.y = m_mappings[virtualKey]->screenY;
+    m_dragOffset.x = x - m_dragPos.x;
+    m_dragOffset.y = y - m_dragPos.y;
+    SetCapture(m_hwnd);
+    
+    // Repaint it highlighted
+    RECT bounds = GetIndicatorBounds(m_dragPos.x, m_dragPos.y);
+    PaintMove(bounds, bounds);
+}
+
+void DisplayOverlay::OnMouseMove(int x, int y, bool snap) {
+    if (m_dragKey < 0) {
+        return;
+    }
+    
+    POINT position = { x - m_dragOffset.x, y - m_dragOffset.y };
+    if (snap) {
+        position.x = (position.x + OVERLAY_SNAP_SPACING / 2) / OVERLAY_SNAP_SPACING * OVERLAY_SNAP_SPACING;
+        position.y = (position.y + OVERLAY_SNAP_SPACING / 2) / OVERLAY_SNAP_SPACING * OVERLAY_SNAP_SPACING;
+    }
+    RECT client;
+    GetClientRect(m_hwnd, &client);
+    position.x = (position.x < 0) ? 0 : (position.x >= client.right ? client.right - 1 : position.x);
+    position.y = (position.y < 0) ? 0 : (position.y >= client.bottom ? client.bottom - 1 : position.y);
+    if (position.x == m_dragPos.x && position.y == m_dragPos.y) {
+        return;
+    }
+    
+    RECT from = GetIndicatorBounds(m_dragPos.x, m_dragPos.y);
+    m_dragPos = position;
+    PaintMove(from, GetIndicatorBounds(m_dragPos.x, m_dragPos.y));
+}
+
+void DisplayOverlay::OnButtonUp() {
+    if (m_dragKey < 0) {
+        return;
+    }
+    
+    // Cleared before releasing the capture, so WM_CAPTURECHANGED does not cancel it
+    int virtualKey = m_dragKey;
+    POINT position = m_dragPos;
+    m_dragKey = -1;
+    ReleaseCapture();
+    
+    const KeyMapping* mapping = m_mappings[virtualKey];
+    if ((position.x != mapping->screenX || position.y != mapping->screenY) && m_editHandler != nullptr) {
+        m_editHandler(m_editContext, virtualKey, position.x, position.y, false);
+    } else {
+        RECT bounds = GetIndicatorBounds(position.x, position.y);
+        PaintMove(bounds, bounds);
+    }
+}
+
+void DisplayOverlay::OnRightButtonUp(int x, int y) {
+    int virtualKey = HitTest(x, y);
+    if (virtualKey >= 0 && m_dragKey < 0 && m_editHandler != nullptr) {
+        m_editHandler(m_editContext, virtualKey, 0, 0, true);
+    }
+}
+
+void DisplayOverlay::CancelDrag() {
+    if (m_dragKey < 0) {
+        return;
+    }
+    
+    RECT from = GetIndicatorBounds(m_dragPos.x, m_dragPos.y);
+    const KeyMapping* mapping = m_mappings[m_dragKey];
+    m_dragKey = -1;
+    if (GetCapture() == m_hwnd) {
+        ReleaseCapture();
+    }
+    PaintMove(from, GetIndicatorBounds(mapping->screenX, mapping->screenY));
+}
+
+void DisplayOverlay::PaintMove(const RECT& from, const RECT& to) {
+    if (m_hwnd == nullptr || !m_visible) {
+        return;
+    }
+    
+    // Overlapping areas are painted as one; distant ones separately, so a long
+    // jump does not repaint everything in between
+    HDC hdc = GetDC(m_hwnd);
+    RECT overlap;
+    if (IntersectRect(&overlap, &from, &to)) {
+        RECT area;
+        UnionRect(&area, &from, &to);
+        PaintArea(hdc, area);
+    } else {
+        PaintArea(hdc, from);
+        PaintArea(hdc, to);
+    }
+    ReleaseDC(m_hwnd, hdc);
+}
+
+void DisplayOverlay::BuildLabelAtlas() {
+    memset(m_hasLabel, 0, sizeof(m_hasLabel));
+    if (m_mappings == nullptr) {
+        return;
+    }
+    
+    int atlasWidth = LABEL_CELL_WIDTH * LABEL_ATLAS_COLUMNS;
+    int atlasHeight = LABEL_CELL_HEIGHT * (256 / LABEL_ATLAS_COLUMNS);
+    
+    // The atlas is created on first use and kept across mapping changes
+    if (m_labelAtlasDC == nullptr) {
+        HDC screenDC = GetDC(nullptr);
+        m_labelAtlasDC = CreateCompatibleDC(screenDC);
+        m_labelAtlasBitmap = CreateCompatibleBitmap(screenDC, atlasWidth, atlasHeight);
+        ReleaseDC(nullptr, screenDC);
+        
+        if (m_labelAtlasDC == nullptr || m_labelAtlasBitmap == nullptr) {
+            std::cerr << "Failed to create overlay label atlas. Error: " << GetLastError() << std::endl;
+            FreeLabelAtlas();
+            return;
+        }
+        m_labelAtlasOldBitmap = (HBITMAP)SelectObject(m_labelAtlasDC, m_labelAtlasBitmap);
+    }
+    
+    // Black cells, so only the glyphs show when the atlas is OR-ed onto the indicators
+    RECT atlasRect = {0, 0, atlasWidth, atlasHeight};
+    FillRect(m_labelAtlasDC, &atlasRect, (HBRUSH)GetStockObject(BLACK_BRUSH));
+    
+    SetBkMode(m_labelAtlasDC, TRANSPARENT);
+    SetTextColor(m_labelAtlasDC, RGB(255, 255, 255));
+    
+    HFONT hFont = CreateFontW(
+        KEY_FONT_SIZE, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
+        DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
+        CLEARTYPE_QUALITY, DEFAULT_PITCH | FF_DONTCARE,
+        L"Arial"
+    );
+    HFONT oldFont = (HFONT)SelectObject(m_labelAtlasDC, hFont);
+    
+    for (int virtualKey = 0; virtualKey < 256; ++virtualKey) {
+        const KeyMapping* mapping = m_mappings[virtualKey];
+        if (mapping == nullptr || mapping->keyName.empty()) continue;
+        
+        // Key names are UTF-8 in the config
+        const std::string& name = mapping->keyName;
+        int length = MultiByteToWideChar(CP_UTF8, 0, name.c_str(), (int)name.size(), nullptr, 0);
+        if (length <= 0) continue;
+        std::wstring text(length, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, name.c_str(), (int)name.size(), &text[0], length);
+        
+        RECT cell;
+        cell.left = (virtualKey % LABEL_ATLAS_COLUMNS) * LABEL_CELL_WIDTH;
+        cell.top = (virtualKey / LABEL_ATLAS_COLUMNS) * LABEL_CELL_HEIGHT;
+        cell.right = cell.left + LABEL_CELL_WIDTH;
+        cell.bottom = cell.top + LABEL_CELL_HEIGHT;
+        
+        DrawTextW(m_labelAtlasDC, text.c_str(), length, &cell,
+                  DT_CENTER | DT_VCENTER | DT_SINGLELINE | DT_NOPREFIX);
+        m_hasLabel[virtualKey] = true;
+    }
+    
+    SelectObject(m_labelAtlasDC, oldFont);
+    DeleteObject(hFont);
+}
+
+void DisplayOverlay::FreeLabelAtlas() {
+    if (m_labelAtlasDC != nullptr) {
+        if (m_labelAtlasOldBitmap != nullptr) {
+            SelectObject(m_labelAtlasDC, m_labelAtlasOldBitmap);
+        }
+        DeleteDC(m_labelAtlasDC);
+    }
+    if (m_labelAtlasBitmap != nullptr) {
+        DeleteObject(m_labelAtlasBitmap);
+    }
+    m_labelAtlasDC = nullptr;
+    m_labelAtlasBitmap = nullptr;
+    m_labelAtlasOldBitmap = nullptr;
+    memset(m_hasLabel, 0, sizeof(m_hasLabel));
+}
+
+void DisplayOverlay::SetUsage(const UsageCounters* usage) {
+    m_usage = usage;
     if (m_visible) {
         Redraw();
     }
@@ -119,13 +411,37 @@ LRESULT CALLBACK DisplayOverlay::WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam,
         case WM_PAINT:
             s_instance->OnPaint();
             return 0;
-            
+        
         case WM_DESTROY:
             PostQuitMessage(0);
             return 0;
-            
+        
         case WM_ERASEBKGND:
             return 1; // Don't erase background
+        
+        // Edit mode: take clicks without taking the focus from the application
+        case WM_MOUSEACTIVATE:
+            return MA_NOACTIVATE;
+        
+        case WM_LBUTTONDOWN:
+            s_instance->OnButtonDown((short)LOWORD(lParam), (short)HIWORD(lParam));
+            return 0;
+        
+        case WM_MOUSEMOVE:
+            s_instance->OnMouseMove((short)LOWORD(lParam), (short)HIWORD(lParam), (wParam & MK_SHIFT) == 0);
+            return 0;
+        
+        case WM_LBUTTONUP:
+            s_instance->OnButtonUp();
+            return 0;
+        
+        case WM_RBUTTONUP:
+            s_instance->OnRightButtonUp((short)LOWORD(lParam), (short)HIWORD(lParam));
+            return 0;
+        
+        case WM_CAPTURECHANGED:
+            s_instance->CancelDrag();
+            return 0;
     }
     
     return DefWindowProcW(hwnd, uMsg, wParam, lParam);
@@ -134,74 +450,93 @@ LRESULT CALLBACK DisplayOverlay::WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam,
 void DisplayOverlay::OnPaint() {
     PAINTSTRUCT ps;
     HDC hdc = BeginPaint(m_hwnd, &ps);
+    PaintArea(hdc, ps.rcPaint);
+    EndPaint(m_hwnd, &ps);
+}
+
+void DisplayOverlay::PaintArea(HDC hdc, const RECT& area) {
+    TraceScope trace(TRACE_OVERLAY_PAINT);
+    RECT client;
+    GetClientRect(m_hwnd, &client);
+    RECT rect;
+    if (!IntersectRect(&rect, &area, &client)) {
+        return;
+    }
+    int width = rect.right - rect.left;
+    int height = rect.bottom - rect.top;
     
-    // Create memory DC for double buffering
+    // Create memory DC for double buffering, sized to the area only
     HDC memDC = CreateCompatibleDC(hdc);
-    RECT rect;
-    GetClientRect(m_hwnd, &rect);
-    HBITMAP memBitmap = CreateCompatibleBitmap(hdc, rect.right, rect.bottom);
+    HBITMAP memBitmap = CreateCompatibleBitmap(hdc, width, height);
     HBITMAP oldBitmap = (HBITMAP)SelectObject(memDC, memBitmap);
     
+    // Render in window coordinates
+    SetViewportOrgEx(memDC, -rect.left, -rect.top, nullptr);
+    Render(memDC, rect);
+    
+    // Copy to screen
+    BitBlt(hdc, rect.left, rect.top, width, height, memDC, 0, 0, SRCCOPY);
+    
+    // Cleanup
+    SelectObject(memDC, oldBitmap);
+    DeleteObject(memBitmap);
+    DeleteDC(memDC);
+}
+
+void DisplayOverlay::Render(HDC memDC, const RECT& rect) {
     // Fill with transparent black
     HBRUSH brush = CreateSolidBrush(RGB(0, 0, 0));
     FillRect(memDC, &rect, brush);
     DeleteObject(brush);
     
-    // Set up drawing
-    SetBkMode(memDC, TRANSPARENT);
-    SetTextColor(memDC, RGB(255, 255, 255));
+    // One pen for every indicator; the DC brush is recolored per indicator
+    // for the heatmap without creating brushes
+    int radius = KEY_INDICATOR_RADIUS;
+    HPEN circlePen = CreatePen(PS_SOLID, 2, RGB(200, 200, 200));
+    HBRUSH oldBrush = (HBRUSH)SelectObject(memDC, GetStockObject(DC_BRUSH));
+    HPEN oldPen = (HPEN)SelectObject(memDC, circlePen);
     
-    // Create font
-    HFONT hFont = CreateFontW(
-        KEY_FONT_SIZE, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
-        DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
-        CLEARTYPE_QUALITY, DEFAULT_PITCH | FF_DONTCARE,
-        L"Arial"
-    );
-    HFONT oldFont = (HFONT)SelectObject(memDC, hFont);
+    uint64_t maxPresses = (m_usage != nullptr) ? m_usage->GetMaxPresses() : 0;
     
-    // Draw each mapping
-    for (const auto& pair : m_mappings) {
-        const KeyMapping& mapping = pair.second;
+    // Draw each mapping that overlaps the area
+    for (int virtualKey = 0; m_mappings != nullptr && virtualKey < 256; ++virtualKey) {
+        if (m_mappings[virtualKey] == nullptr) continue;
         
-        // Draw grey circle
-        int radius = KEY_INDICATOR_RADIUS;
-        HBRUSH circleBrush = CreateSolidBrush(RGB(128, 128, 128));
-        HPEN circlePen = CreatePen(PS_SOLID, 2, RGB(200, 200, 200));
+        POINT position = GetIndicatorPosition(virtualKey);
+        RECT bounds = GetIndicatorBounds(position.x, position.y);
+        RECT overlap;
+        if (!IntersectRect(&overlap, &bounds, &rect)) continue;
         
-        HBRUSH oldBrush = (HBRUSH)SelectObject(memDC, circleBrush);
-        HPEN oldPen = (HPEN)SelectObject(memDC, circlePen);
+        // Heatmap: grey for unused keys up to red for the most pressed one;
+        // the dragged indicator is blue
+        COLORREF fill = RGB(128, 128, 128);
+        if (maxPresses > 0) {
+            int heat = static_cast<int>(m_usage->GetPresses(virtualKey) * 127 / maxPresses);
+            fill = RGB(128 + heat, 128 - heat, 128 - heat);
+        }
+        if (virtualKey == m_dragKey) {
+            fill = RGB(64, 128, 255);
+        }
+        SetDCBrushColor(memDC, fill);
         
+        // Draw the circle
         Ellipse(memDC, 
-            mapping.x - radius, mapping.y - radius,
-            mapping.x + radius, mapping.y + radius);
-        
-        SelectObject(memDC, oldBrush);
-        SelectObject(memDC, oldPen);
-        DeleteObject(circleBrush);
-        DeleteObject(circlePen);
+            position.x - radius, position.y - radius,
+            position.x + radius, position.y + radius);
         
-        // Draw key name
-        std::wstring wKeyName(mapping.keyName.begin(), mapping.keyName.end());
-        RECT textRect;
-        textRect.left = mapping.x - radius;
-        textRect.right = mapping.x + radius;
-        textRect.top = mapping.y - 10;
-        textRect.bottom = mapping.y + 10;
-        
-        DrawTextW(memDC, wKeyName.c_str(), -1, &textRect, DT_CENTER | DT_VCENTER | DT_SINGLELINE);
+        // Copy the pre-rendered key name; OR-ing keeps the circle under the black cell
+        if (m_hasLabel[virtualKey]) {
+            BitBlt(memDC,
+                position.x - radius, position.y - LABEL_CELL_HEIGHT / 2,
+                LABEL_CELL_WIDTH, LABEL_CELL_HEIGHT,
+                m_labelAtlasDC,
+                (virtualKey % LABEL_ATLAS_COLUMNS) * LABEL_CELL_WIDTH,
+                (virtualKey / LABEL_ATLAS_COLUMNS) * LABEL_CELL_HEIGHT,
+                SRCPAINT);
+        }
     }
     
-    SelectObject(memDC, oldFont);
-    DeleteObject(hFont);
-    
-    // Copy to screen
-    BitBlt(hdc, 0, 0, rect.right, rect.bottom, memDC, 0, 0, SRCCOPY);
-    
-    // Cleanup
-    SelectObject(memDC, oldBitmap);
-    DeleteObject(memBitmap);
-    DeleteDC(memDC);
-    
-    EndPaint(m_hwnd, &ps);
+    SelectObject(memDC, oldBrush);
+    SelectObject(memDC, oldPen);
+    DeleteObject(circlePen);
 }
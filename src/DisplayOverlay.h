@@ -2,12 +2,14 @@
 #define DISPLAY_OVERLAY_H
 
 #include <windows.h>
-#include <map>
-#include <string>
 #include "ConfigManager.h"
+#include "UsageCounters.h"
+#include "SpatialGrid.h"
 
 class DisplayOverlay {
 public:
+    typedef void (*EditHandlerProc)(void* context, int virtualKey, int x, int y, bool remove);
+    
     DisplayOverlay();
     ~DisplayOverlay();
     
@@ -23,16 +25,99 @@ public:
     // Check if overlay is visible
     bool IsVisible() const;
     
-    // Update the overlay with current mappings
-    void UpdateMappings(const std::map<int, KeyMapping>& mappings);
+    // Show the mappings of a resolved lookup table (256 entries, null where unmapped).
+    // The table is a view into the config, not a copy: it must outlive the overlay
+    // or be replaced, and each call redraws with its current contents and
+    // re-renders the key labels.
+    void SetMappings(const KeyMapping* const* mappings);
+    
+    // Tint each indicator by how often its key was pressed (null for plain grey).
+    // The counters are read at paint time; call Redraw to show new counts.
+    void SetUsage(const UsageCounters* usage);
     
     // Force redraw
     void Redraw();
+    
+    // Bind the edit handler: SetEditHandler<App, &App::OnOverlayEdit>(app).
+    // It is called once per finished edit (indicator dropped at screen position x, y, or deleted),
+    // not per mouse move; the new position shows once SetMappings is called again.
+    template <class T, void (T::*Method)(int, int, int, bool)>
+    void SetEditHandler(T* target) {
+        m_editContext = target;
+        m_editHandler = &InvokeEditHandler<T, Method>;
+    }
+    
+    // Edit mode: the overlay takes the mouse instead of being click-through.
+    // Indicators are dragged with the left button, snapped to a grid (hold
+    // Shift to place freely), and deleted with the right button.
+    void SetEditMode(bool enabled);
+    bool IsEditMode() const;
+    
+    // Get the key whose indicator is under a point (screen coordinates), or -1
+    int HitTest(int x, int y) const;
+    
+    // Draw the indicators that overlap a rectangle into a device context
+    void Render(HDC hdc, const RECT& rect);
 
 private:
     HWND m_hwnd;
     bool m_visible;
-    std::map<int, KeyMapping> m_mappings;
+    const KeyMapping* const* m_mappings;
+    const UsageCounters* m_usage;
+    
+    // Key labels pre-rendered white on black, one cell per virtual key,
+    // copied onto the indicators at paint time (no text drawing per frame)
+    HDC m_labelAtlasDC;
+    HBITMAP m_labelAtlasBitmap;
+    HBITMAP m_labelAtlasOldBitmap;
+    bool m_hasLabel[256];
+    
+    // Hit-test index over the indicator bounds, rebuilt with the mappings
+    SpatialGrid m_grid;
+    
+    bool m_editMode;
+    EditHandlerProc m_editHandler;
+    void* m_editContext;
+    
+    // Indicator being dragged (-1 if none), where it is drawn and where it was grabbed
+    int m_dragKey;
+    POINT m_dragPos;
+    POINT m_dragOffset;
+    
+    // Render the key names (UTF-8) of the current mappings into the atlas
+    void BuildLabelAtlas();
+    
+    // Release the atlas bitmap and DC
+    void FreeLabelAtlas();
+    
+    // Index the indicators of the current mappings
+    void BuildGrid();
+    
+    // Screen area an indicator at a position covers (circle, label and pen)
+    static RECT GetIndicatorBounds(int x, int y);
+    
+    // Position an indicator is drawn at (the drag position while it is dragged)
+    POINT GetIndicatorPosition(int virtualKey) const;
+    
+    // Repaint one area of the window right away (only the indicators it overlaps)
+    void PaintArea(HDC hdc, const RECT& area);
+    
+    // Repaint the areas an indicator left and entered
+    void PaintMove(const RECT& from, const RECT& to);
+    
+    // Mouse handling in edit mode
+    void OnButtonDown(int x, int y);
+    void OnMouseMove(int x, int y, bool snap);
+    void OnButtonUp();
+    void OnRightButtonUp(int x, int y);
+    
+    // Drop the drag without an edit (capture lost, mappings replaced)
+    void CancelDrag();
+    
+    template <class T, void (T::*Method)(int, int, int, bool)>
+    static void InvokeEditHandler(void* context, int virtualKey, int x, int y, bool remove) {
+        (static_cast<T*>(context)->*Method)(virtualKey, x, y, remove);
+    }
     
     static LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
     void OnPaint();
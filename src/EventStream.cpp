@@ -0,0 +1,135 @@
+#include "EventStream.h"
+#include <iostream>
+#include <cstring>
+
+EventStream::EventStream()
+    : m_mapping(nullptr)
+    , m_stream(nullptr)
+    , m_nextSequence(1)
+    , m_clock(&SystemClock::Instance()) {
+}
+
+EventStream::~EventStream() {
+    Close();
+}
+
+bool EventStream::Create(const char* name) {
+    if (m_stream != nullptr) {
+        return true;
+    }
+    
+    m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                   0, sizeof(EventStreamData), name);
+    if (m_mapping == nullptr) {
+        std::cerr << "Failed to create event stream. Error: " << GetLastError() << std::endl;
+        return false;
+    }
+    if (name != nullptr && GetLastError() == ERROR_ALREADY_EXISTS) {
+        std::cerr << "Event stream already exists (another instance running?)." << std::endl;
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+        return false;
+    }
+    
+    m_stream = static_cast<EventStreamData*>(MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, sizeof(EventStreamData)));
+    if (m_stream == nullptr) {
+        std::cerr << "Failed to map event stream. Error: " << GetLastError() << std::endl;
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+        return false;
+    }
+    
+    // Fresh sections are zero-filled; the magic goes in last so readers never see a half header
+    EventStreamHeader& header = m_stream->header;
+    header.version = EVENT_STREAM_VERSION;
+    header.recordSize = sizeof(EventRecord);
+    header.capacity = EVENT_STREAM_CAPACITY;
+    header.writerProcessId = GetCurrentProcessId();
+    header.writeSequence = 1;
+    m_nextSequence = 1;
+    MemoryBarrier();
+    header.magic = EVENT_STREAM_MAGIC;
+    return true;
+}
+
+void EventStream::Close() {
+    if (m_stream != nullptr) {
+        UnmapViewOfFile(m_stream);
+        m_stream = nullptr;
+    }
+    if (m_mapping != nullptr) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+}
+
+void EventStream::SetClock(const Clock* clock) {
+    m_clock = (clock != nullptr) ? clock : &SystemClock::Instance();
+}
+
+void EventStream::Write(EventRecordType type, int code, int device, int x, int y) {
+    if (m_stream == nullptr) {
+        return;
+    }
+    
+    int64_t sequence = m_nextSequence++;
+    EventRecord& record = m_stream->records[sequence & (EVENT_STREAM_CAPACITY - 1)];
+    
+    // Mark the slot busy, fill it, then publish: a reader that copies the slot
+    // while it is rewritten sees the sequence change and discards its copy
+    InterlockedExchange64(&record.sequence, 0);
+    record.timeUs = m_clock->Now();
+    record.type = static_cast<uint16_t>(type);
+    record.code = static_cast<uint16_t>(code);
+    record.device = static_cast<uint16_t>(device);
+    record.reserved = 0;
+    record.x = x;
+    record.y = y;
+    InterlockedExchange64(&record.sequence, sequence);
+    InterlockedExchange64(&m_stream->header.writeSequence, sequence + 1);
+}
+
+const EventStreamData* EventStream::GetData() const {
+    return m_stream;
+}
+
+bool EventStream::ReadNext(const EventStreamData* stream, uint64_t& cursor, EventRecord& record, uint64_t& lost) {
+    if (stream == nullptr || stream->header.magic != EVENT_STREAM_MAGIC ||
+        stream->header.version != EVENT_STREAM_VERSION) {
+        return false;
+    }
+    
+    while (true) {
+        uint64_t head = static_cast<uint64_t>(stream->header.writeSequence);
+        MemoryBarrier();
+        
+        // New readers (cursor 0) start at the oldest record still in the ring
+        if (cursor == 0) {
+            cursor = (head > EVENT_STREAM_CAPACITY) ? head - EVENT_STREAM_CAPACITY : 1;
+        }
+        if (cursor >= head) {
+            return false;
+        }
+        
+        // Records older than one ring length are gone
+        if (head - cursor > EVENT_STREAM_CAPACITY) {
+            uint64_t oldest = head - EVENT_STREAM_CAPACITY;
+            lost += oldest - cursor;
+            cursor = oldest;
+        }
+        
+        const EventRecord& slot = stream->records[cursor & (EVENT_STREAM_CAPACITY - 1)];
+        LONG64 before = slot.sequence;
+        MemoryBarrier();
+        memcpy(&record, const_cast<const EventRecord*>(&slot), sizeof(EventRecord));
+        MemoryBarrier();
+        if (before == static_cast<LONG64>(cursor) && slot.sequence == before) {
+            ++cursor;
+            return true;
+        }
+        
+        // The writer lapped this slot while it was read: skip ahead and retry
+        ++lost;
+        ++cursor;
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef EVENT_STREAM_H
+#define EVENT_STREAM_H
+
+#include <windows.h>
+#include <cstdint>
+#include "Clock.h"
+
+// Name of the shared event stream (per session)
+#define EVENT_STREAM_NAME "Local\\KeyboardMapTouchEvents"
+
+// Stream identification; the version changes whenever the layout does
+#define EVENT_STREAM_MAGIC   0x454D4D4B  // "KMME"
+#define EVENT_STREAM_VERSION 1
+
+// Records in the ring (power of two); readers more than this far behind are lapped
+#define EVENT_STREAM_CAPACITY 4096
+
+enum EventRecordType {
+    EVENT_KEY_DOWN = 1,
+    EVENT_KEY_UP = 2,
+    EVENT_TOUCH_DOWN = 3,
+    EVENT_TOUCH_UPDATE = 4,  // Contact moved or kept alive
+    EVENT_TOUCH_UP = 5
+};
+
+// One fixed-size (32 byte) record. The slot's sequence number is the
+// record's position in the stream; it is 0 while the slot is being rewritten.
+struct EventRecord {
+    volatile LONG64 sequence;
+    int64_t timeUs;    // Clock time in microseconds (QPC unless simulated)
+    uint16_t type;     // EventRecordType
+    uint16_t code;     // Virtual key (key events) or touch ID (contacts)
+    uint16_t device;   // Source keyboard for key events (0 = any)
+    uint16_t reserved;
+    int32_t x;         // Contact position (0 for key events)
+    int32_t y;
+};
+
+// Shared section layout: header, write position on its own cache line, records
+struct EventStreamHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;  // sizeof(EventRecord)
+    uint32_t capacity;    // EVENT_STREAM_CAPACITY
+    uint32_t writerProcessId;
+    uint8_t padding0[44];
+    
+    volatile LONG64 writeSequence;  // Sequence number the next record will get (first is 1)
+    uint8_t padding1[56];
+};
+
+struct EventStreamData {
+    EventStreamHeader header;
+    EventRecord records[EVENT_STREAM_CAPACITY];
+};
+
+// Broadcasts key and contact records to any number of readers through a
+// shared memory ring. The writer never waits: it overwrites the oldest
+// record, and each reader keeps its own cursor, so a slow reader only
+// learns how many records it lost and never holds the writer back.
+class EventStream {
+public:
+    EventStream();
+    ~EventStream();
+    
+    // Create the shared memory section (null name: private, for tests and benchmarks)
+    bool Create(const char* name = EVENT_STREAM_NAME);
+    
+    // Unmap and close the section
+    void Close();
+    
+    // Clock the records are timestamped with (default: the system clock)
+    void SetClock(const Clock* clock);
+    
+    // Append a record (no-op before Create)
+    void Write(EventRecordType type, int code, int device, int x, int y);
+    
+    // Mapped stream (for in-process readers)
+    const EventStreamData* GetData() const;
+    
+    // Read the record at cursor and advance it (start with cursor 0). Returns
+    // false when the reader has caught up. A lapped reader is moved to the
+    // oldest record still available and the records it missed are added to lost.
+    static bool ReadNext(const EventStreamData* stream, uint64_t& cursor, EventRecord& record, uint64_t& lost);
+
+private:
+    HANDLE m_mapping;
+    EventStreamData* m_stream;
+    int64_t m_nextSequence;
+    const Clock* m_clock;
+};
+
+#endif // EVENT_STREAM_H
@@ -0,0 +1,166 @@
+#include "FramePacer.h"
+#include <dwmapi.h>
+#include <iostream>
+
+#pragma comment(lib, "dwmapi.lib")
+
+// Refresh timing used when neither DWM nor the display report one (60 Hz)
+#define DEFAULT_REFRESH_PERIOD_US 16667
+
+// Re-read the DWM timing this often to follow clock drift and mode changes
+#define FRAME_PACER_RESYNC_US 1000000
+
+// Default flush lead before vblank
+#define DEFAULT_FRAME_LEAD_US 1000
+
+FramePacer::FramePacer()
+    : m_vblankUs(0)
+    , m_periodUs(DEFAULT_REFRESH_PERIOD_US)
+    , m_leadUs(DEFAULT_FRAME_LEAD_US)
+    , m_lastSyncUs(0)
+    , m_frequency(1)
+    , m_fromDwm(false)
+    , m_totalPhaseErrorUs(0)
+    , m_maxPhaseErrorUs(0)
+    , m_maxDriftUs(0)
+    , m_flushCount(0)
+    , m_lateFlushCount(0) {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    m_frequency = frequency.QuadPart;
+}
+
+FramePacer::~FramePacer() {
+}
+
+bool FramePacer::Initialize(int64_t nowUs) {
+    int64_t vblankUs, periodUs;
+    if (ReadDwmTiming(vblankUs, periodUs)) {
+        m_fromDwm = true;
+        SetTiming(vblankUs, periodUs);
+        m_lastSyncUs = nowUs;
+        return true;
+    }
+    
+    // No composition timing: use the display refresh rate with an arbitrary phase
+    DEVMODEA mode;
+    memset(&mode, 0, sizeof(mode));
+    mode.dmSize = sizeof(mode);
+    int64_t period = DEFAULT_REFRESH_PERIOD_US;
+    if (EnumDisplaySettingsA(nullptr, ENUM_CURRENT_SETTINGS, &mode) && mode.dmDisplayFrequency > 1) {
+        period = 1000000 / mode.dmDisplayFrequency;
+    }
+    
+    std::cerr << "Warning: DWM timing unavailable, frame pacing uses a "
+              << period << " us period without vblank phase." << std::endl;
+    m_fromDwm = false;
+    SetTiming(nowUs, period);
+    m_lastSyncUs = nowUs;
+    return false;
+}
+
+void FramePacer::Resync(int64_t nowUs) {
+    if (!m_fromDwm || nowUs - m_lastSyncUs < FRAME_PACER_RESYNC_US) {
+        return;
+    }
+    m_lastSyncUs = nowUs;
+    
+    int64_t vblankUs, periodUs;
+    if (!ReadDwmTiming(vblankUs, periodUs)) {
+        return;
+    }
+    
+    // How far the predicted vblank grid drifted from the reported one
+    int64_t drift = (vblankUs - m_vblankUs) % m_periodUs;
+    if (drift < 0) drift += m_periodUs;
+    if (drift > m_periodUs / 2) drift -= m_periodUs;
+    if (drift < 0) drift = -drift;
+    if (drift > m_maxDriftUs) {
+        m_maxDriftUs = drift;
+    }
+    
+    SetTiming(vblankUs, periodUs);
+}
+
+void FramePacer::SetTiming(int64_t vblankUs, int64_t periodUs) {
+    m_vblankUs = vblankUs;
+    m_periodUs = (periodUs > 0) ? periodUs : DEFAULT_REFRESH_PERIOD_US;
+    SetLeadUs(m_leadUs);
+}
+
+void FramePacer::SetLeadUs(int64_t leadUs) {
+    // Flushing more than half a frame early only adds latency
+    if (leadUs < 0) leadUs = 0;
+    if (leadUs > m_periodUs / 2) leadUs = m_periodUs / 2;
+    m_leadUs = leadUs;
+}
+
+int64_t FramePacer::NextFlushTime(int64_t nowUs) const {
+    // First vblank grid point whose flush point lies after nowUs
+    int64_t sinceVblank = (nowUs + m_leadUs - m_vblankUs) % m_periodUs;
+    if (sinceVblank < 0) sinceVblank += m_periodUs;
+    return nowUs + (m_periodUs - sinceVblank);
+}
+
+void FramePacer::RecordFlush(int64_t targetUs, int64_t flushUs) {
+    int64_t error = flushUs - targetUs;
+    
+    ++m_flushCount;
+    m_totalPhaseErrorUs += (error < 0) ? -error : error;
+    if (error > m_maxPhaseErrorUs) {
+        m_maxPhaseErrorUs = error;
+    }
+    
+    // Flushed after the vblank it was meant for: the frame was missed
+    if (error >= m_leadUs) {
+        ++m_lateFlushCount;
+    }
+}
+
+int64_t FramePacer::GetRefreshPeriodUs() const {
+    return m_periodUs;
+}
+
+int64_t FramePacer::GetLeadUs() const {
+    return m_leadUs;
+}
+
+int64_t FramePacer::GetMeanPhaseErrorUs() const {
+    return m_flushCount ? m_totalPhaseErrorUs / static_cast<int64_t>(m_flushCount) : 0;
+}
+
+int64_t FramePacer::GetMaxPhaseErrorUs() const {
+    return m_maxPhaseErrorUs;
+}
+
+int64_t FramePacer::GetMaxDriftUs() const {
+    return m_maxDriftUs;
+}
+
+uint64_t FramePacer::GetFlushCount() const {
+    return m_flushCount;
+}
+
+uint64_t FramePacer::GetLateFlushCount() const {
+    return m_lateFlushCount;
+}
+
+bool FramePacer::ReadDwmTiming(int64_t& vblankUs, int64_t& periodUs) const {
+    DWM_TIMING_INFO timing;
+    memset(&timing, 0, sizeof(timing));
+    timing.cbSize = sizeof(timing);
+    
+    // Windows 8.1+ only accepts a null window (timing of the whole desktop)
+    if (FAILED(DwmGetCompositionTimingInfo(nullptr, &timing)) ||
+        timing.qpcRefreshPeriod == 0 || timing.qpcVBlank == 0) {
+        return false;
+    }
+    
+    vblankUs = QpcToUs(static_cast<int64_t>(timing.qpcVBlank));
+    periodUs = QpcToUs(static_cast<int64_t>(timing.qpcRefreshPeriod));
+    return periodUs > 0;
+}
+
+int64_t FramePacer::QpcToUs(int64_t qpc) const {
+    return (qpc / m_frequency) * 1000000 + (qpc % m_frequency) * 1000000 / m_frequency;
+}
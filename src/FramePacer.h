@@ -0,0 +1,65 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <windows.h>
+#include <cstdint>
+
+// Predicts display refresh (vblank) times so touch frames can be flushed
+// just before the compositor picks up input for the next frame.
+// All times are microseconds on the Scheduler clock (QPC); the pacer only
+// does arithmetic on the times it is given, so it can be driven by any clock.
+class FramePacer {
+public:
+    FramePacer();
+    ~FramePacer();
+    
+    // Read the refresh timing from DWM (falls back to the display refresh rate)
+    bool Initialize(int64_t nowUs);
+    
+    // Re-read the DWM timing if the last sync is older than the resync interval
+    void Resync(int64_t nowUs);
+    
+    // Use a fixed timing instead of DWM (vblank at vblankUs, then every periodUs)
+    void SetTiming(int64_t vblankUs, int64_t periodUs);
+    
+    // How long before each vblank to flush
+    void SetLeadUs(int64_t leadUs);
+    
+    // Time of the next flush point strictly after nowUs
+    int64_t NextFlushTime(int64_t nowUs) const;
+    
+    // Record a flush that was planned for targetUs and happened at flushUs
+    void RecordFlush(int64_t targetUs, int64_t flushUs);
+    
+    // Timing and phase error statistics
+    int64_t GetRefreshPeriodUs() const;
+    int64_t GetLeadUs() const;
+    int64_t GetMeanPhaseErrorUs() const;
+    int64_t GetMaxPhaseErrorUs() const;
+    int64_t GetMaxDriftUs() const;
+    uint64_t GetFlushCount() const;
+    uint64_t GetLateFlushCount() const;
+
+private:
+    int64_t m_vblankUs;
+    int64_t m_periodUs;
+    int64_t m_leadUs;
+    int64_t m_lastSyncUs;
+    int64_t m_frequency;
+    bool m_fromDwm;
+    
+    // Phase error statistics (flush time minus planned flush time)
+    int64_t m_totalPhaseErrorUs;
+    int64_t m_maxPhaseErrorUs;
+    int64_t m_maxDriftUs;
+    uint64_t m_flushCount;
+    uint64_t m_lateFlushCount;
+    
+    // Query DWM for the last vblank and refresh period
+    bool ReadDwmTiming(int64_t& vblankUs, int64_t& periodUs) const;
+    
+    // Convert a QPC value to microseconds
+    int64_t QpcToUs(int64_t qpc) const;
+};
+
+#endif // FRAME_PACER_H
@@ -0,0 +1,237 @@
+#include "GamepadSource.h"
+#include <iostream>
+#include <cmath>
+
+// Poll intervals (microseconds): fast while in use, backing off to the idle
+// interval once nothing changed for a while; slow scans for a new controller
+#define GAMEPAD_ACTIVE_INTERVAL_US 1000
+#define GAMEPAD_IDLE_INTERVAL_US   16000
+#define GAMEPAD_ACTIVE_WINDOW_US   250000
+#define GAMEPAD_SCAN_INTERVAL_US   2000000
+
+// Stick deflection (after the dead zone) that counts as a stick direction press
+#define GAMEPAD_STICK_PRESS 0.5f
+
+// Axis changes smaller than this are not reported
+#define GAMEPAD_AXIS_EPSILON 0.002f
+
+// Button bit masks in the same order as the VK_GAMEPAD_* codes from VK_GAMEPAD_A
+static const struct {
+    WORD mask;
+    int virtualKey;
+} s_buttonMap[] = {
+    { XINPUT_GAMEPAD_A, VK_GAMEPAD_A },
+    { XINPUT_GAMEPAD_B, VK_GAMEPAD_B },
+    { XINPUT_GAMEPAD_X, VK_GAMEPAD_X },
+    { XINPUT_GAMEPAD_Y, VK_GAMEPAD_Y },
+    { XINPUT_GAMEPAD_RIGHT_SHOULDER, VK_GAMEPAD_RIGHT_SHOULDER },
+    { XINPUT_GAMEPAD_LEFT_SHOULDER, VK_GAMEPAD_LEFT_SHOULDER },
+    { XINPUT_GAMEPAD_DPAD_UP, VK_GAMEPAD_DPAD_UP },
+    { XINPUT_GAMEPAD_DPAD_DOWN, VK_GAMEPAD_DPAD_DOWN },
+    { XINPUT_GAMEPAD_DPAD_LEFT, VK_GAMEPAD_DPAD_LEFT },
+    { XINPUT_GAMEPAD_DPAD_RIGHT, VK_GAMEPAD_DPAD_RIGHT },
+    { XINPUT_GAMEPAD_START, VK_GAMEPAD_MENU },
+    { XINPUT_GAMEPAD_BACK, VK_GAMEPAD_VIEW },
+    { XINPUT_GAMEPAD_LEFT_THUMB, VK_GAMEPAD_LEFT_THUMBSTICK_BUTTON },
+    { XINPUT_GAMEPAD_RIGHT_THUMB, VK_GAMEPAD_RIGHT_THUMBSTICK_BUTTON },
+};
+
+// Normalize a stick with a radial dead zone: 0 inside it, up to 1 at full deflection
+static void NormalizeStick(SHORT rawX, SHORT rawY, int deadZone, float& x, float& y) {
+    float fx = static_cast<float>(rawX);
+    float fy = static_cast<float>(rawY);
+    float magnitude = std::sqrt(fx * fx + fy * fy);
+    
+    if (magnitude <= deadZone) {
+        x = y = 0.0f;
+        return;
+    }
+    
+    float scaled = (magnitude - deadZone) / (32767.0f - deadZone);
+    if (scaled > 1.0f) scaled = 1.0f;
+    x = fx / magnitude * scaled;
+    y = fy / magnitude * scaled;
+}
+
+// Normalize a trigger: 0 up to the threshold, up to 1 when fully pressed
+static float NormalizeTrigger(BYTE raw) {
+    if (raw <= XINPUT_GAMEPAD_TRIGGER_THRESHOLD) {
+        return 0.0f;
+    }
+    return (raw - XINPUT_GAMEPAD_TRIGGER_THRESHOLD) / (255.0f - XINPUT_GAMEPAD_TRIGGER_THRESHOLD);
+}
+
+GamepadSource::GamepadSource()
+    : m_xinputModule(nullptr)
+    , m_getState(nullptr)
+    , m_buttonHandler(nullptr)
+    , m_buttonContext(nullptr)
+    , m_axisHandler(nullptr)
+    , m_axisContext(nullptr)
+    , m_connected(false)
+    , m_userIndex(0)
+    , m_lastPacket(0)
+    , m_lastChangeUs(0)
+    , m_intervalUs(GAMEPAD_IDLE_INTERVAL_US)
+    , m_pollCount(0)
+    , m_buttons(0) {
+    for (int axis = 0; axis < GAMEPAD_AXIS_COUNT; ++axis) {
+        m_axes[axis][0] = m_axes[axis][1] = 0.0f;
+    }
+}
+
+GamepadSource::~GamepadSource() {
+    if (m_xinputModule) {
+        FreeLibrary(m_xinputModule);
+    }
+}
+
+bool GamepadSource::Initialize() {
+    if (m_getState != nullptr) {
+        return true;
+    }
+    
+    // XInput 1.4 ships with Windows 8+, 9.1.0 with Windows 7
+    m_xinputModule = LoadLibraryA("xinput1_4.dll");
+    if (m_xinputModule == nullptr) {
+        m_xinputModule = LoadLibraryA("xinput9_1_0.dll");
+    }
+    if (m_xinputModule == nullptr) {
+        std::cerr << "XInput not available, gamepad input disabled." << std::endl;
+        return false;
+    }
+    
+    m_getState = reinterpret_cast<XInputGetStateFunc>(GetProcAddress(m_xinputModule, "XInputGetState"));
+    if (m_getState == nullptr) {
+        FreeLibrary(m_xinputModule);
+        m_xinputModule = nullptr;
+        std::cerr << "XInputGetState not found, gamepad input disabled." << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+int64_t GamepadSource::Poll(int64_t nowUs) {
+    if (m_getState == nullptr) {
+        return GAMEPAD_SCAN_INTERVAL_US;
+    }
+    ++m_pollCount;
+    
+    XINPUT_STATE state;
+    
+    // Querying empty slots is slow, so look for a controller only every few seconds
+    if (!m_connected) {
+        for (DWORD index = 0; index < XUSER_MAX_COUNT; ++index) {
+            if (m_getState(index, &state) == ERROR_SUCCESS) {
+                m_connected = true;
+                m_userIndex = index;
+                m_lastPacket = state.dwPacketNumber;
+                m_lastChangeUs = nowUs;
+                m_intervalUs = GAMEPAD_ACTIVE_INTERVAL_US;
+                std::cout << "Gamepad " << index << " connected." << std::endl;
+                ProcessState(state.Gamepad);
+                return m_intervalUs;
+            }
+        }
+        return GAMEPAD_SCAN_INTERVAL_US;
+    }
+    
+    if (m_getState(m_userIndex, &state) != ERROR_SUCCESS) {
+        std::cout << "Gamepad " << m_userIndex << " disconnected." << std::endl;
+        m_connected = false;
+        ResetState();
+        return GAMEPAD_SCAN_INTERVAL_US;
+    }
+    
+    // The packet number only changes when the controller state does
+    if (state.dwPacketNumber != m_lastPacket) {
+        m_lastPacket = state.dwPacketNumber;
+        m_lastChangeUs = nowUs;
+        m_intervalUs = GAMEPAD_ACTIVE_INTERVAL_US;
+        ProcessState(state.Gamepad);
+    } else if (nowUs - m_lastChangeUs > GAMEPAD_ACTIVE_WINDOW_US && m_intervalUs < GAMEPAD_IDLE_INTERVAL_US) {
+        m_intervalUs *= 2;
+        if (m_intervalUs > GAMEPAD_IDLE_INTERVAL_US) {
+            m_intervalUs = GAMEPAD_IDLE_INTERVAL_US;
+        }
+    }
+    
+    return m_intervalUs;
+}
+
+bool GamepadSource::IsConnected() const {
+    return m_connected;
+}
+
+uint64_t GamepadSource::GetPollCount() const {
+    return m_pollCount;
+}
+
+void GamepadSource::ProcessState(const XINPUT_GAMEPAD& pad) {
+    float lx, ly, rx, ry;
+    NormalizeStick(pad.sThumbLX, pad.sThumbLY, XINPUT_GAMEPAD_LEFT_THUMB_DEADZONE, lx, ly);
+    NormalizeStick(pad.sThumbRX, pad.sThumbRY, XINPUT_GAMEPAD_RIGHT_THUMB_DEADZONE, rx, ry);
+    float lt = NormalizeTrigger(pad.bLeftTrigger);
+    float rt = NormalizeTrigger(pad.bRightTrigger);
+    
+    // Digital view of every input, including triggers and stick directions
+    uint32_t buttons = 0;
+    for (const auto& button : s_buttonMap) {
+        if (pad.wButtons & button.mask) {
+            buttons |= 1u << (button.virtualKey - VK_GAMEPAD_A);
+        }
+    }
+    if (lt > 0.0f) buttons |= 1u << (VK_GAMEPAD_LEFT_TRIGGER - VK_GAMEPAD_A);
+    if (rt > 0.0f) buttons |= 1u << (VK_GAMEPAD_RIGHT_TRIGGER - VK_GAMEPAD_A);
+    if (ly > GAMEPAD_STICK_PRESS) buttons |= 1u << (VK_GAMEPAD_LEFT_THUMBSTICK_UP - VK_GAMEPAD_A);
+    if (ly < -GAMEPAD_STICK_PRESS) buttons |= 1u << (VK_GAMEPAD_LEFT_THUMBSTICK_DOWN - VK_GAMEPAD_A);
+    if (lx > GAMEPAD_STICK_PRESS) buttons |= 1u << (VK_GAMEPAD_LEFT_THUMBSTICK_RIGHT - VK_GAMEPAD_A);
+    if (lx < -GAMEPAD_STICK_PRESS) buttons |= 1u << (VK_GAMEPAD_LEFT_THUMBSTICK_LEFT - VK_GAMEPAD_A);
+    if (ry > GAMEPAD_STICK_PRESS) buttons |= 1u << (VK_GAMEPAD_RIGHT_THUMBSTICK_UP - VK_GAMEPAD_A);
+    if (ry < -GAMEPAD_STICK_PRESS) buttons |= 1u << (VK_GAMEPAD_RIGHT_THUMBSTICK_DOWN - VK_GAMEPAD_A);
+    if (rx > GAMEPAD_STICK_PRESS) buttons |= 1u << (VK_GAMEPAD_RIGHT_THUMBSTICK_RIGHT - VK_GAMEPAD_A);
+    if (rx < -GAMEPAD_STICK_PRESS) buttons |= 1u << (VK_GAMEPAD_RIGHT_THUMBSTICK_LEFT - VK_GAMEPAD_A);
+    
+    uint32_t changed = buttons ^ m_buttons;
+    m_buttons = buttons;
+    if (m_buttonHandler != nullptr) {
+        while (changed) {
+            int bit = 0;
+            while (!(changed & (1u << bit))) {
+                ++bit;
+            }
+            changed &= ~(1u << bit);
+            m_buttonHandler(m_buttonContext, VK_GAMEPAD_A + bit, (buttons & (1u << bit)) != 0);
+        }
+    }
+    
+    UpdateAxis(GAMEPAD_LEFT_STICK, lx, ly);
+    UpdateAxis(GAMEPAD_RIGHT_STICK, rx, ry);
+    UpdateAxis(GAMEPAD_LEFT_TRIGGER, lt, 0.0f);
+    UpdateAxis(GAMEPAD_RIGHT_TRIGGER, rt, 0.0f);
+}
+
+void GamepadSource::ResetState() {
+    XINPUT_GAMEPAD centered;
+    memset(&centered, 0, sizeof(centered));
+    ProcessState(centered);
+}
+
+void GamepadSource::UpdateAxis(int axis, float x, float y) {
+    float* last = m_axes[axis];
+    
+    // Always report reaching the center exactly so contacts are released
+    bool centered = (x == 0.0f && y == 0.0f);
+    bool wasCentered = (last[0] == 0.0f && last[1] == 0.0f);
+    if (centered == wasCentered &&
+        std::fabs(x - last[0]) < GAMEPAD_AXIS_EPSILON && std::fabs(y - last[1]) < GAMEPAD_AXIS_EPSILON) {
+        return;
+    }
+    
+    last[0] = x;
+    last[1] = y;
+    if (m_axisHandler != nullptr) {
+        m_axisHandler(m_axisContext, axis, x, y);
+    }
+}
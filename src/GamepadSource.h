@@ -0,0 +1,117 @@
+#ifndef GAMEPAD_SOURCE_H
+#define GAMEPAD_SOURCE_H
+
+#include <windows.h>
+#include <xinput.h>
+#include <cstdint>
+#include "ConfigManager.h"
+
+// Gamepad virtual key codes (winuser.h only defines them for Windows 10 targets)
+#ifndef VK_GAMEPAD_A
+#define VK_GAMEPAD_A                         0xC3
+#define VK_GAMEPAD_B                         0xC4
+#define VK_GAMEPAD_X                         0xC5
+#define VK_GAMEPAD_Y                         0xC6
+#define VK_GAMEPAD_RIGHT_SHOULDER            0xC7
+#define VK_GAMEPAD_LEFT_SHOULDER             0xC8
+#define VK_GAMEPAD_LEFT_TRIGGER              0xC9
+#define VK_GAMEPAD_RIGHT_TRIGGER             0xCA
+#define VK_GAMEPAD_DPAD_UP                   0xCB
+#define VK_GAMEPAD_DPAD_DOWN                 0xCC
+#define VK_GAMEPAD_DPAD_LEFT                 0xCD
+#define VK_GAMEPAD_DPAD_RIGHT                0xCE
+#define VK_GAMEPAD_MENU                      0xCF
+#define VK_GAMEPAD_VIEW                      0xD0
+#define VK_GAMEPAD_LEFT_THUMBSTICK_BUTTON    0xD1
+#define VK_GAMEPAD_RIGHT_THUMBSTICK_BUTTON   0xD2
+#define VK_GAMEPAD_LEFT_THUMBSTICK_UP        0xD3
+#define VK_GAMEPAD_LEFT_THUMBSTICK_DOWN      0xD4
+#define VK_GAMEPAD_LEFT_THUMBSTICK_RIGHT     0xD5
+#define VK_GAMEPAD_LEFT_THUMBSTICK_LEFT      0xD6
+#define VK_GAMEPAD_RIGHT_THUMBSTICK_UP       0xD7
+#define VK_GAMEPAD_RIGHT_THUMBSTICK_DOWN     0xD8
+#define VK_GAMEPAD_RIGHT_THUMBSTICK_RIGHT    0xD9
+#define VK_GAMEPAD_RIGHT_THUMBSTICK_LEFT     0xDA
+#endif
+
+// Reads an XInput controller and reports buttons as VK_GAMEPAD_* key events
+// and sticks/triggers as normalized axis values. XInput has no change
+// notification, so the owner calls Poll() on a timer; the returned interval
+// is short (1 kHz) while the controller is in use and backs off when idle.
+class GamepadSource {
+public:
+    typedef void (*ButtonHandlerProc)(void* context, int virtualKey, bool isDown);
+    typedef void (*AxisHandlerProc)(void* context, int axis, float x, float y);
+    
+    GamepadSource();
+    ~GamepadSource();
+    
+    // Load XInput; returns false if it is not available
+    bool Initialize();
+    
+    // Bind handlers at compile time: SetButtonHandler<App, &App::OnButton>(app)
+    template <class T, void (T::*Method)(int, bool)>
+    void SetButtonHandler(T* target) {
+        m_buttonContext = target;
+        m_buttonHandler = &InvokeButtonHandler<T, Method>;
+    }
+    
+    // Axis values: sticks -1..1 (y up), triggers 0..1 in x; 0 inside the dead zone
+    template <class T, void (T::*Method)(int, float, float)>
+    void SetAxisHandler(T* target) {
+        m_axisContext = target;
+        m_axisHandler = &InvokeAxisHandler<T, Method>;
+    }
+    
+    // Read the controller and report changes; returns microseconds until the next poll
+    int64_t Poll(int64_t nowUs);
+    
+    // Check if a controller is connected
+    bool IsConnected() const;
+    
+    // Number of polls so far (for status output)
+    uint64_t GetPollCount() const;
+
+private:
+    typedef DWORD (WINAPI *XInputGetStateFunc)(DWORD, XINPUT_STATE*);
+    
+    HMODULE m_xinputModule;
+    XInputGetStateFunc m_getState;
+    
+    ButtonHandlerProc m_buttonHandler;
+    void* m_buttonContext;
+    AxisHandlerProc m_axisHandler;
+    void* m_axisContext;
+    
+    bool m_connected;
+    DWORD m_userIndex;
+    DWORD m_lastPacket;
+    int64_t m_lastChangeUs;
+    int64_t m_intervalUs;
+    uint64_t m_pollCount;
+    
+    // Last reported state
+    uint32_t m_buttons;  // Bit per VK_GAMEPAD_* code (offset from VK_GAMEPAD_A)
+    float m_axes[GAMEPAD_AXIS_COUNT][2];
+    
+    template <class T, void (T::*Method)(int, bool)>
+    static void InvokeButtonHandler(void* context, int virtualKey, bool isDown) {
+        (static_cast<T*>(context)->*Method)(virtualKey, isDown);
+    }
+    
+    template <class T, void (T::*Method)(int, float, float)>
+    static void InvokeAxisHandler(void* context, int axis, float x, float y) {
+        (static_cast<T*>(context)->*Method)(axis, x, y);
+    }
+    
+    // Report the differences between the last state and a new one
+    void ProcessState(const XINPUT_GAMEPAD& pad);
+    
+    // Release every button and center every axis (controller lost)
+    void ResetState();
+    
+    // Report an axis if it changed
+    void UpdateAxis(int axis, float x, float y);
+};
+
+#endif // GAMEPAD_SOURCE_H
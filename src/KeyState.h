@@ -0,0 +1,79 @@
+#ifndef KEY_STATE_H
+#define KEY_STATE_H
+
+#include <cstdint>
+
+// 256-bit set of virtual key codes (one bit per VK 0..255).
+// Laid out as four 64-bit words and aligned so it can be loaded with
+// two 128-bit (or one 256-bit) vector loads.
+struct alignas(32) KeyBitset {
+    uint64_t words[4];
+    
+    KeyBitset() : words{0, 0, 0, 0} {}
+    
+    void Set(int virtualKey) {
+        words[(virtualKey >> 6) & 3] |= (uint64_t)1 << (virtualKey & 63);
+    }
+    
+    void Clear(int virtualKey) {
+        words[(virtualKey >> 6) & 3] &= ~((uint64_t)1 << (virtualKey & 63));
+    }
+    
+    bool Test(int virtualKey) const {
+        return (words[(virtualKey >> 6) & 3] >> (virtualKey & 63)) & 1;
+    }
+    
+    void Reset() {
+        words[0] = words[1] = words[2] = words[3] = 0;
+    }
+    
+    void SetAll() {
+        words[0] = words[1] = words[2] = words[3] = ~(uint64_t)0;
+    }
+    
+    void Merge(const KeyBitset& other) {
+        for (int i = 0; i < 4; ++i) {
+            words[i] |= other.words[i];
+        }
+    }
+    
+    // Remove every key in 'other'
+    void Remove(const KeyBitset& other) {
+        for (int i = 0; i < 4; ++i) {
+            words[i] &= ~other.words[i];
+        }
+    }
+    
+    bool Empty() const {
+        return (words[0] | words[1] | words[2] | words[3]) == 0;
+    }
+    
+    // True if every key in 'other' is also in this set
+    bool Contains(const KeyBitset& other) const {
+        for (int i = 0; i < 4; ++i) {
+            if ((words[i] & other.words[i]) != other.words[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    bool Intersects(const KeyBitset& other) const {
+        return ((words[0] & other.words[0]) | (words[1] & other.words[1]) |
+                (words[2] & other.words[2]) | (words[3] & other.words[3])) != 0;
+    }
+    
+    int Count() const {
+        int count = 0;
+        for (int i = 0; i < 4; ++i) {
+            uint64_t w = words[i];
+            while (w) {
+                w &= w - 1;
+                ++count;
+            }
+        }
+        return count;
+    }
+};
+
+#endif // KEY_STATE_H
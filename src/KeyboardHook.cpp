@@ -1,10 +1,36 @@
 #include "KeyboardHook.h"
+#include "Clock.h"
+#include "Tracer.h"
 #include <iostream>
+#include <cstring>
+
+// Flag stored with the scancode of an extended key
+#define KEY_SCANCODE_EXTENDED 0x100
+
+// Hook timeout Windows uses when LowLevelHooksTimeout is not set (milliseconds)
+#define HOOK_DEFAULT_TIMEOUT_MS 300
 
 KeyboardHook* KeyboardHook::s_instance = nullptr;
 
 KeyboardHook::KeyboardHook()
-    : m_hook(nullptr) {
+    : m_hook(nullptr)
+    , m_clock(&SystemClock::Instance())
+    , m_handler(nullptr)
+    , m_handlerContext(nullptr)
+    , m_consumeTable(&m_consumeTables[0])
+    , m_dispatchingKeyDown(0)
+    , m_timeoutUs(HOOK_DEFAULT_TIMEOUT_MS * 1000LL)
+    , m_overran(false) {
+    memset(&m_health, 0, sizeof(m_health));
+    memset(m_scanCodes, 0, sizeof(m_scanCodes));
+    
+    DWORD timeoutMs = 0;
+    DWORD size = sizeof(timeoutMs);
+    if (RegGetValueA(HKEY_CURRENT_USER, "Control Panel\\Desktop", "LowLevelHooksTimeout",
+                     RRF_RT_REG_DWORD, nullptr, &timeoutMs, &size) == ERROR_SUCCESS && timeoutMs > 0) {
+        m_timeoutUs = timeoutMs * 1000LL;
+    }
+    
     s_instance = this;
 }
 
@@ -38,22 +64,230 @@ void KeyboardHook::Uninstall() {
     }
 }
 
-void KeyboardHook::SetKeyCallback(KeyCallback callback) {
-    m_callback = callback;
+void KeyboardHook::SetClock(const Clock* clock) {
+    m_clock = (clock != nullptr) ? clock : &SystemClock::Instance();
+}
+
+void KeyboardHook::SetKeyFilter(const KeyBitset& keys) {
+    m_filterKeys = keys;
+}
+
+int KeyboardHook::GetScanCode(int virtualKey) const {
+    return m_scanCodes[virtualKey & 0xFF] & 0xFF;
+}
+
+bool KeyboardHook::IsExtended(int virtualKey) const {
+    return (m_scanCodes[virtualKey & 0xFF] & KEY_SCANCODE_EXTENDED) != 0;
+}
+
+void KeyboardHook::SetConsumeKeys(const KeyBitset& keys) {
+    const KeyBitset* current = m_consumeTable.load(std::memory_order_relaxed);
+    KeyBitset* next = (current == &m_consumeTables[0]) ? &m_consumeTables[1] : &m_consumeTables[0];
+    *next = keys;
+    m_consumeTable.store(next, std::memory_order_release);
+}
+
+void KeyboardHook::ConsumeKeyDown(int virtualKey) {
+    if (virtualKey != 0 && virtualKey == m_dispatchingKeyDown) {
+        m_consumedKeys.Set(virtualKey);
+    }
 }
 
 bool KeyboardHook::IsInstalled() const {
     return m_hook != nullptr;
 }
 
+bool KeyboardHook::HasHeldKeys() const {
+    return !m_downKeys.Empty();
+}
+
+int KeyboardHook::CheckHealth() {
+    bool simulated = m_clock->IsSimulated();
+    if (m_hook == nullptr && !simulated) {
+        return 0;
+    }
+    
+    // Keys the hook still holds but that are up: their key-up never arrived.
+    // A swallowed key never shows as held in the key state, so it only counts
+    // as lost when the hook itself was dropped (a callback overran); if it is
+    // still held, its next auto-repeat arrives as a fresh key-down.
+    int orphaned = 0;
+    for (int virtualKey = 1; virtualKey < 256; ++virtualKey) {
+        if (!m_downKeys.Test(virtualKey)) {
+            continue;
+        }
+        if (m_consumedKeys.Test(virtualKey) ? !m_overran : IsKeyHeld(virtualKey)) {
+            continue;
+        }
+        
+        ++orphaned;
+        Dispatch(virtualKey, false);
+    }
+    
+    if (!m_overran && orphaned == 0) {
+        return 0;
+    }
+    
+    std::cerr << "Keyboard hook lost events (" << orphaned << " stuck keys released"
+              << (m_overran ? ", callback overran the hook timeout" : "") << "). Re-installing." << std::endl;
+    
+    // Removing an already dropped hook fails harmlessly (a simulated one has nothing to re-install)
+    if (!simulated) {
+        UnhookWindowsHookEx(m_hook);
+        m_hook = SetWindowsHookEx(WH_KEYBOARD_LL, KeyboardProc, GetModuleHandle(nullptr), 0);
+        if (m_hook == nullptr) {
+            std::cerr << "Failed to re-install keyboard hook. Error: " << GetLastError() << std::endl;
+        }
+    }
+    
+    m_overran = false;
+    ++m_health.reinstalls;
+    m_health.orphanedKeys += orphaned;
+    return orphaned;
+}
+
+const HookHealth& KeyboardHook::GetHealth() const {
+    return m_health;
+}
+
+bool KeyboardHook::IsKeyHeld(int virtualKey) const {
+    if (m_clock->IsSimulated()) {
+        switch (virtualKey) {
+            case VK_SHIFT:
+                return m_passedKeys.Test(VK_LSHIFT) || m_passedKeys.Test(VK_RSHIFT);
+            case VK_CONTROL:
+                return m_passedKeys.Test(VK_LCONTROL) || m_passedKeys.Test(VK_RCONTROL);
+            case VK_MENU:
+                return m_passedKeys.Test(VK_LMENU) || m_passedKeys.Test(VK_RMENU);
+            default:
+                return m_passedKeys.Test(virtualKey);
+        }
+    }
+    return (GetAsyncKeyState(virtualKey) & 0x8000) != 0;
+}
+
+void KeyboardHook::RecordCallbackTime(int64_t elapsedUs) {
+    ++m_health.callbacks;
+    if (elapsedUs > m_health.maxCallbackUs) {
+        m_health.maxCallbackUs = elapsedUs;
+    }
+    if (elapsedUs * 2 > m_timeoutUs) {
+        ++m_health.slowCallbacks;
+    }
+    if (elapsedUs >= m_timeoutUs) {
+        m_overran = true;
+    }
+}
+
+bool KeyboardHook::FilterEvent(int virtualKey, bool isDown) {
+    if (isDown) {
+        // Typematic repeat of a key that is already down
+        if (m_downKeys.Test(virtualKey)) {
+            return false;
+        }
+        m_downKeys.Set(virtualKey);
+        
+        if (!m_filterKeys.Test(virtualKey)) {
+            return false;
+        }
+        m_deliveredKeys.Set(virtualKey);
+        return true;
+    }
+    
+    m_downKeys.Clear(virtualKey);
+    
+    // Deliver the key-up only if the handler saw the key-down
+    if (!m_deliveredKeys.Test(virtualKey)) {
+        return false;
+    }
+    m_deliveredKeys.Clear(virtualKey);
+    return true;
+}
+
+bool KeyboardHook::PassThrough(int virtualKey, bool isDown) {
+    if (m_filterKeys.Test(virtualKey) || m_deliveredKeys.Test(virtualKey) || m_consumedKeys.Test(virtualKey)) {
+        return false;
+    }
+    
+    // Still tracked, so the watchdog can tell a key left down
+    if (isDown) {
+        m_downKeys.Set(virtualKey);
+        m_passedKeys.Set(virtualKey);
+    } else {
+        m_downKeys.Clear(virtualKey);
+        m_passedKeys.Clear(virtualKey);
+    }
+    return true;
+}
+
+bool KeyboardHook::Dispatch(int virtualKey, bool isDown, int scanCode, bool extended) {
+    // Kept per key: a binding may be looked up after the event (chord window)
+    if (isDown) {
+        m_scanCodes[virtualKey] = static_cast<uint16_t>((scanCode & 0xFF) | (extended ? KEY_SCANCODE_EXTENDED : 0));
+    }
+    
+    // The table is checked on the first key-down only: a key is consumed until
+    // its key-up, so other applications never see half a keystroke when the
+    // table changes while it is held
+    bool consume;
+    bool firstDown = false;
+    if (!isDown) {
+        consume = m_consumedKeys.Test(virtualKey);
+        m_consumedKeys.Clear(virtualKey);
+    } else if (m_downKeys.Test(virtualKey)) {
+        consume = m_consumedKeys.Test(virtualKey);
+    } else {
+        firstDown = true;
+        consume = m_consumeTable.load(std::memory_order_acquire)->Test(virtualKey);
+        if (consume) {
+            m_consumedKeys.Set(virtualKey);
+        }
+    }
+    
+    // Drop repeats and unwanted keys before doing any other work
+    if (m_handler != nullptr && FilterEvent(virtualKey, isDown)) {
+        m_dispatchingKeyDown = firstDown ? virtualKey : 0;
+        m_handler(m_handlerContext, virtualKey, isDown);
+        m_dispatchingKeyDown = 0;
+        
+        // The handler may have claimed the keystroke (ConsumeKeyDown)
+        if (firstDown) {
+            consume = m_consumedKeys.Test(virtualKey);
+        }
+    }
+    
+    if (!isDown) {
+        m_passedKeys.Clear(virtualKey);
+    } else if (!consume) {
+        m_passedKeys.Set(virtualKey);
+    }
+    return consume;
+}
+
 LRESULT CALLBACK KeyboardHook::KeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
-    if (nCode >= 0 && s_instance != nullptr && s_instance->m_callback) {
-        KBDLLHOOKSTRUCT* pKbd = reinterpret_cast<KBDLLHOOKSTRUCT*>(lParam);
+    KeyboardHook* hook = s_instance;
+    if (nCode >= 0 && hook != nullptr) {
+        const KBDLLHOOKSTRUCT* pKbd = reinterpret_cast<const KBDLLHOOKSTRUCT*>(lParam);
         
+        int virtualKey = static_cast<int>(pKbd->vkCode & 0xFF);
         bool isDown = (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN);
         
-        // Call the callback
-        s_instance->m_callback(pKbd->vkCode, isDown);
+        // Most typing is not mapped: pass it on without timing or dispatching it
+        if (hook->PassThrough(virtualKey, isDown)) {
+            return CallNextHookEx(nullptr, nCode, wParam, lParam);
+        }
+        
+        int64_t traceBegin = Tracer::Begin();
+        int64_t start = hook->m_clock->Now();
+        bool extended = (pKbd->flags & LLKHF_EXTENDED) != 0;
+        bool consume = hook->Dispatch(virtualKey, isDown, static_cast<int>(pKbd->scanCode), extended);
+        hook->RecordCallbackTime(hook->m_clock->Now() - start);
+        Tracer::End(TRACE_HOOK_CALLBACK, traceBegin, virtualKey);
+        
+        // Mapped keys end here; the focused application never sees them
+        if (consume) {
+            return 1;
+        }
     }
     
     // Pass to next hook
@@ -2,11 +2,23 @@
 #define KEYBOARD_HOOK_H
 
 #include <windows.h>
-#include <functional>
+#include "KeyState.h"
+#include "Clock.h"
+#include <cstdint>
+#include <atomic>
+
+// Hook health counters, published on the stats page
+struct HookHealth {
+    uint64_t callbacks;       // Events that needed Dispatch (pass-throughs are not timed)
+    uint64_t slowCallbacks;   // Over half the OS hook timeout
+    int64_t maxCallbackUs;
+    uint64_t reinstalls;
+    uint64_t orphanedKeys;    // Held keys released because their key-up was lost
+};
 
 class KeyboardHook {
 public:
-    using KeyCallback = std::function<void(int virtualKey, bool isDown)>;
+    typedef void (*KeyHandlerProc)(void* context, int virtualKey, bool isDown);
     
     KeyboardHook();
     ~KeyboardHook();
@@ -17,15 +29,115 @@ public:
     // Uninstall the keyboard hook
     void Uninstall();
     
-    // Set callback for key events
-    void SetKeyCallback(KeyCallback callback);
+    // Bind the key event handler at compile time: SetKeyHandler<App, &App::OnKey>(app).
+    // The member is a template argument, so the hook calls it through a plain
+    // function pointer with no type-erased wrapper in between.
+    template <class T, void (T::*Method)(int, bool)>
+    void SetKeyHandler(T* target) {
+        m_handlerContext = target;
+        m_handler = &InvokeHandler<T, Method>;
+    }
+    
+    // Set the keys the handler wants to see; all other key events are dropped
+    // in the hook (key-ups of keys whose key-down was delivered always pass)
+    void SetKeyFilter(const KeyBitset& keys);
+    
+    // Set the keys the hook swallows instead of passing them on to other
+    // applications. The table is double-buffered and published with one atomic
+    // store, so the hook reads it with a single load and no lock.
+    void SetConsumeKeys(const KeyBitset& keys);
+    
+    // Called by the handler during a key's first key-down: swallow that
+    // keystroke (down, repeats and up) although the key is not in the consume
+    // set, for keys whose mapping depends on the modifiers held. Ignored at
+    // any other time.
+    void ConsumeKeyDown(int virtualKey);
+    
+    // Hook fast path: track a key no one wants and return true, or return false
+    // for a key that needs Dispatch. The consume set is a subset of the filter,
+    // so a key that passes through is never swallowed.
+    bool PassThrough(int virtualKey, bool isDown);
+    
+    // Run one key event through the filter and handler (what the hook does per event).
+    // Returns true if the event is consumed (not passed to the next hook).
+    bool Dispatch(int virtualKey, bool isDown, int scanCode = 0, bool extended = false);
+    
+    // Time callbacks on another clock (null: the system clock). A simulated
+    // clock stands for a hook that is never installed: events only come
+    // through Dispatch, and a key counts as physically held when its events
+    // reached the system (a swallowed key never does, as with the real hook).
+    void SetClock(const Clock* clock);
+    
+    // Scancode and extended flag of a key's latest key-down (0/false if never seen)
+    int GetScanCode(int virtualKey) const;
+    bool IsExtended(int virtualKey) const;
     
     // Check if hook is installed
     bool IsInstalled() const;
+    
+    // Check if the hook has seen a key-down without its key-up
+    bool HasHeldKeys() const;
+    
+    // Check if a key is physically held, filtered or not (see SetClock for
+    // simulated clocks). Generic Shift/Ctrl/Alt codes match either side.
+    bool IsKeyHeld(int virtualKey) const;
+    
+    // Watchdog check. Windows silently removes a low-level hook whose callback
+    // overruns the hook timeout, and its key-ups are lost from then on. The hook
+    // is re-installed if a callback overran or a key it passed on is physically
+    // up (swallowed keys are only released after an overrun); such orphaned keys
+    // get a key-up through the handler. Returns their count.
+    int CheckHealth();
+    
+    // Callback timing and watchdog counters
+    const HookHealth& GetHealth() const;
 
 private:
     HHOOK m_hook;
-    KeyCallback m_callback;
+    const Clock* m_clock;
+    KeyHandlerProc m_handler;
+    void* m_handlerContext;
+    
+    // Keys the handler wants
+    KeyBitset m_filterKeys;
+    
+    // Keys currently held, as seen by the hook (used to drop auto-repeat)
+    KeyBitset m_downKeys;
+    
+    // Keys whose key-down was delivered to the handler
+    KeyBitset m_deliveredKeys;
+    
+    // Scancode of each key's latest key-down, with KEY_SCANCODE_EXTENDED for E0 keys
+    uint16_t m_scanCodes[256];
+    
+    // Consume tables: the hook reads the published one, updates fill the other
+    KeyBitset m_consumeTables[2];
+    std::atomic<const KeyBitset*> m_consumeTable;
+    
+    // Keys whose key-down was consumed (their repeats and key-up are consumed too)
+    KeyBitset m_consumedKeys;
+    
+    // Key whose first key-down is in the handler (0 otherwise), for ConsumeKeyDown
+    int m_dispatchingKeyDown;
+    
+    // Keys held as far as the system knows (their key-down was passed on)
+    KeyBitset m_passedKeys;
+    
+    // OS callback time limit (LowLevelHooksTimeout), and whether a callback exceeded it
+    int64_t m_timeoutUs;
+    bool m_overran;
+    HookHealth m_health;
+    
+    // Decide whether an event reaches the handler
+    bool FilterEvent(int virtualKey, bool isDown);
+    
+    // Account one callback's duration
+    void RecordCallbackTime(int64_t elapsedUs);
+    
+    template <class T, void (T::*Method)(int, bool)>
+    static void InvokeHandler(void* context, int virtualKey, bool isDown) {
+        (static_cast<T*>(context)->*Method)(virtualKey, isDown);
+    }
     
     static KeyboardHook* s_instance;
     static LRESULT CALLBACK KeyboardProc(int nCode, WPARAM wParam, LPARAM lParam);
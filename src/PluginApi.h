@@ -0,0 +1,121 @@
+#ifndef KMM_PLUGIN_API_H
+#define KMM_PLUGIN_API_H
+
+/*
+ * Plugin ABI for custom key actions (plain C, stable across compilers).
+ *
+ * A plugin is a DLL exporting kmm_plugin_init. The host calls it once after
+ * loading the DLL; the plugin registers its action handlers by name through
+ * the host API, and the config binds keys to them (action=VK NAME). While
+ * mapping, a key bound to an action runs its handler instead of the key's
+ * own mapping, on the main thread, on key down and key up.
+ *
+ * Handlers get read-only views of the event and of the pressed key set, and
+ * write touch contacts into a buffer the host owns. Nothing is allocated or
+ * copied per call on either side; the views are only valid during the call.
+ *
+ * Structs start with their size so later versions can append fields: check
+ * size before reading a field a newer version added.
+ */
+
+#include <stdint.h>
+
+/* Calling convention of every function crossing the boundary, and the export
+ * attribute for plugin entry points: KMM_PLUGIN_EXPORT int KMM_CALL kmm_plugin_init(...) */
+#define KMM_CALL __cdecl
+#ifdef __cplusplus
+#define KMM_PLUGIN_EXPORT extern "C" __declspec(dllexport)
+#else
+#define KMM_PLUGIN_EXPORT __declspec(dllexport)
+#endif
+
+/* Bumped only for incompatible changes; appended fields keep the version */
+#define KMM_PLUGIN_API_VERSION 1
+
+/* Longest action name, including the terminating zero */
+#define KMM_ACTION_NAME_SIZE 64
+
+/* Names of the exported entry points */
+#define KMM_PLUGIN_INIT_NAME     "kmm_plugin_init"
+#define KMM_PLUGIN_SHUTDOWN_NAME "kmm_plugin_shutdown"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A key event of a key bound to an action */
+typedef struct KmmKeyEvent {
+    uint32_t size;        /* sizeof(KmmKeyEvent) */
+    int32_t virtualKey;
+    int32_t isDown;       /* 1 for key down, 0 for key up */
+    int32_t isRepeat;     /* OS auto-repeat of a held key */
+    int32_t scanCode;     /* Scancode of the key's latest key down */
+    int32_t extended;     /* E0-prefixed key (right Ctrl, arrows, numpad Enter, ...) */
+    int32_t x;            /* Screen position of the key's own mapping, or -1 if unmapped */
+    int32_t y;
+    int64_t timeUs;       /* Host clock time in microseconds */
+} KmmKeyEvent;
+
+/* Keys held right now: bit (vk & 63) of word (vk >> 6), for VK 0..255.
+ * Generic Shift/Ctrl/Alt are set along with their left/right codes. */
+typedef struct KmmKeyState {
+    uint32_t size;              /* sizeof(KmmKeyState) */
+    const uint64_t* pressed;    /* 4 words: every key physically held */
+    const uint64_t* touching;   /* 4 words: keys whose mapped touch is held */
+} KmmKeyState;
+
+/* What a contact does */
+enum {
+    KMM_CONTACT_DOWN = 1,
+    KMM_CONTACT_MOVE = 2,
+    KMM_CONTACT_UP = 3
+};
+
+/* One touch contact change */
+typedef struct KmmContact {
+    int32_t action;     /* KMM_CONTACT_* */
+    int32_t touchId;    /* 0-9, shared with the host: a DOWN on an ID one of the host's own
+                           contacts holds (keys, sticks, triggers, mouse look) is dropped, as is
+                           a MOVE or UP on an ID this plugin did not put down */
+    int32_t x;          /* Screen position (ignored for KMM_CONTACT_UP) */
+    int32_t y;
+} KmmContact;
+
+/* Contacts a handler emits: it writes contacts[count] and increments count,
+ * up to capacity. The host sends them into the current touch frame after
+ * the call, in order. */
+typedef struct KmmContactBuffer {
+    KmmContact* contacts;
+    uint32_t capacity;
+    uint32_t count;
+} KmmContactBuffer;
+
+/* Action handler: returns 1 if it handled the event, 0 to let the key's own
+ * mapping run. It must return quickly; it runs on the input path. */
+typedef int (KMM_CALL *KmmActionHandler)(void* userData, const KmmKeyEvent* event,
+                                         const KmmKeyState* keys, KmmContactBuffer* out);
+
+/* Services the host offers a plugin (valid until kmm_plugin_shutdown) */
+typedef struct KmmHostApi {
+    uint32_t size;      /* sizeof(KmmHostApi) */
+    uint32_t version;   /* KMM_PLUGIN_API_VERSION of the host */
+    void* context;      /* Pass back to every host function */
+    
+    /* Register a handler under a name (unique among all plugins); returns 1 on success */
+    int (KMM_CALL *registerAction)(void* context, const char* name, KmmActionHandler handler, void* userData);
+    
+    /* Print a line to the host console */
+    void (KMM_CALL *log)(void* context, const char* message);
+} KmmHostApi;
+
+/* Exported by every plugin: register actions, return 1 to stay loaded or 0 to be unloaded */
+typedef int (KMM_CALL *KmmPluginInitProc)(const KmmHostApi* host);
+
+/* Optional export, called before the plugin is unloaded */
+typedef void (KMM_CALL *KmmPluginShutdownProc)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KMM_PLUGIN_API_H */
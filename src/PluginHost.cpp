@@ -0,0 +1,203 @@
+#include "PluginHost.h"
+#include "Clock.h"
+#include "Tracer.h"
+#include <iostream>
+#include <cstring>
+
+PluginHost::PluginHost()
+    : m_pluginCount(0)
+    , m_actionCount(0) {
+    for (Plugin& plugin : m_plugins) {
+        plugin.module = nullptr;
+        plugin.shutdown = nullptr;
+    }
+    for (int i = 0; i < 256; ++i) {
+        m_keyActions[i] = -1;
+    }
+    
+    memset(&m_api, 0, sizeof(m_api));
+    m_api.size = sizeof(KmmHostApi);
+    m_api.version = KMM_PLUGIN_API_VERSION;
+    m_api.context = this;
+    m_api.registerAction = RegisterAction;
+    m_api.log = Log;
+}
+
+PluginHost::~PluginHost() {
+    UnloadAll();
+}
+
+bool PluginHost::Load(const std::string& path) {
+    if (IsLoaded(path)) {
+        return true;
+    }
+    if (m_pluginCount == MAX_PLUGINS) {
+        std::cerr << "Too many plugins, not loading: " << path << std::endl;
+        return false;
+    }
+    
+    HMODULE module = LoadLibraryA(path.c_str());
+    if (module == nullptr) {
+        std::cerr << "Failed to load plugin: " << path << ". Error: " << GetLastError() << std::endl;
+        return false;
+    }
+    
+    KmmPluginInitProc init = reinterpret_cast<KmmPluginInitProc>(GetProcAddress(module, KMM_PLUGIN_INIT_NAME));
+    if (init == nullptr) {
+        std::cerr << "Not a plugin (no " << KMM_PLUGIN_INIT_NAME << " export): " << path << std::endl;
+        FreeLibrary(module);
+        return false;
+    }
+    
+    // Actions it registers before refusing to load are dropped with it
+    int firstAction = m_actionCount;
+    if (init(&m_api) == 0) {
+        std::cerr << "Plugin refused to load: " << path << std::endl;
+        m_actionCount = firstAction;
+        FreeLibrary(module);
+        return false;
+    }
+    
+    Plugin& plugin = m_plugins[m_pluginCount++];
+    plugin.module = module;
+    plugin.path = path;
+    plugin.shutdown = reinterpret_cast<KmmPluginShutdownProc>(GetProcAddress(module, KMM_PLUGIN_SHUTDOWN_NAME));
+    std::cout << "Loaded plugin " << path << " (" << (m_actionCount - firstAction) << " actions)" << std::endl;
+    return true;
+}
+
+bool PluginHost::IsLoaded(const std::string& path) const {
+    for (int i = 0; i < m_pluginCount; ++i) {
+        if (m_plugins[i].path == path) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PluginHost::UnloadAll() {
+    // Bindings point into the actions of the plugins being unloaded
+    for (int i = 0; i < 256; ++i) {
+        m_keyActions[i] = -1;
+    }
+    m_actionKeys.Reset();
+    m_actionCount = 0;
+    
+    for (int i = m_pluginCount - 1; i >= 0; --i) {
+        Plugin& plugin = m_plugins[i];
+        if (plugin.shutdown != nullptr) {
+            plugin.shutdown();
+        }
+        FreeLibrary(plugin.module);
+        plugin.module = nullptr;
+        plugin.path.clear();
+        plugin.shutdown = nullptr;
+    }
+    m_pluginCount = 0;
+}
+
+int PluginHost::BindKeys(const std::vector<ActionBinding>& bindings) {
+    for (int i = 0; i < 256; ++i) {
+        m_keyActions[i] = -1;
+    }
+    m_actionKeys.Reset();
+    
+    int bound = 0;
+    for (const auto& binding : bindings) {
+        int action = 0;
+        while (action < m_actionCount && binding.name != m_actions[action].name) {
+            ++action;
+        }
+        if (action == m_actionCount) {
+            std::cerr << "No plugin registered action \"" << binding.name << "\", key "
+                      << binding.virtualKey << " is not bound." << std::endl;
+            continue;
+        }
+        
+        m_keyActions[binding.virtualKey & 0xFF] = action;
+        m_actionKeys.Set(binding.virtualKey & 0xFF);
+        ++bound;
+    }
+    return bound;
+}
+
+const KeyBitset& PluginHost::GetActionKeys() const {
+    return m_actionKeys;
+}
+
+bool PluginHost::Dispatch(const KmmKeyEvent& event, const KmmKeyState& keys, KmmContactBuffer& out) {
+    int index = m_keyActions[event.virtualKey & 0xFF];
+    if (index < 0) {
+        return false;
+    }
+    Action& action = m_actions[index];
+    
+    int64_t traceBegin = Tracer::Begin();
+    int64_t start = SystemClock::Instance().Now();
+    int handled = action.handler(action.userData, &event, &keys, &out);
+    int64_t elapsedUs = SystemClock::Instance().Now() - start;
+    Tracer::End(TRACE_PLUGIN_ACTION, traceBegin, index);
+    
+    ++action.stats.calls;
+    action.stats.totalUs += elapsedUs;
+    if (elapsedUs > action.stats.maxUs) {
+        action.stats.maxUs = elapsedUs;
+    }
+    
+    // The buffer is the host's: never trust a count past its end
+    if (out.count > out.capacity) {
+        out.count = out.capacity;
+    }
+    return handled != 0;
+}
+
+int PluginHost::GetActionCount() const {
+    return m_actionCount;
+}
+
+const char* PluginHost::GetActionName(int action) const {
+    return m_actions[action].name;
+}
+
+const PluginActionStats& PluginHost::GetActionStats(int action) const {
+    return m_actions[action].stats;
+}
+
+int PluginHost::GetPluginCount() const {
+    return m_pluginCount;
+}
+
+const KmmHostApi* PluginHost::GetHostApi() const {
+    return &m_api;
+}
+
+int KMM_CALL PluginHost::RegisterAction(void* context, const char* name, KmmActionHandler handler, void* userData) {
+    PluginHost* host = static_cast<PluginHost*>(context);
+    if (host == nullptr || name == nullptr || handler == nullptr ||
+        name[0] == '\0' || strlen(name) >= KMM_ACTION_NAME_SIZE) {
+        return 0;
+    }
+    if (host->m_actionCount == MAX_PLUGIN_ACTIONS) {
+        std::cerr << "Too many plugin actions, not registering: " << name << std::endl;
+        return 0;
+    }
+    for (int i = 0; i < host->m_actionCount; ++i) {
+        if (strcmp(host->m_actions[i].name, name) == 0) {
+            std::cerr << "Plugin action registered twice: " << name << std::endl;
+            return 0;
+        }
+    }
+    
+    Action& action = host->m_actions[host->m_actionCount++];
+    strcpy(action.name, name);
+    action.handler = handler;
+    action.userData = userData;
+    memset(&action.stats, 0, sizeof(action.stats));
+    return 1;
+}
+
+void KMM_CALL PluginHost::Log(void* context, const char* message) {
+    if (message != nullptr) {
+        std::cout << "[plugin] " << message << std::endl;
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef PLUGIN_HOST_H
+#define PLUGIN_HOST_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "PluginApi.h"
+#include "ConfigManager.h"
+#include "KeyState.h"
+
+// Most plugin DLLs and registered actions (fixed tables, no allocation per call)
+#define MAX_PLUGINS 16
+#define MAX_PLUGIN_ACTIONS 64
+
+// Time spent in one action handler
+struct PluginActionStats {
+    uint64_t calls;
+    int64_t totalUs;
+    int64_t maxUs;
+};
+
+// Loads plugin DLLs (see PluginApi.h), keeps the actions they register and
+// runs the one bound to a key. Each call is timed per handler.
+class PluginHost {
+public:
+    PluginHost();
+    ~PluginHost();
+    
+    // Load a plugin DLL and let it register its actions (a DLL already loaded is skipped)
+    bool Load(const std::string& path);
+    
+    // Call each plugin's shutdown and unload it
+    void UnloadAll();
+    
+    // Check if a plugin DLL is loaded (by the path it was loaded from)
+    bool IsLoaded(const std::string& path) const;
+    
+    // Bind keys to actions by name, replacing the previous bindings; names no
+    // plugin registered are reported and skipped. Returns the bound key count.
+    int BindKeys(const std::vector<ActionBinding>& bindings);
+    
+    // Keys bound to an action
+    const KeyBitset& GetActionKeys() const;
+    
+    // Run the action bound to a key: the handler reads the event and key state
+    // in place and appends contacts to 'out'. Returns true if it handled the event.
+    bool Dispatch(const KmmKeyEvent& event, const KmmKeyState& keys, KmmContactBuffer& out);
+    
+    // Registered actions, their names and handler timing
+    int GetActionCount() const;
+    const char* GetActionName(int action) const;
+    const PluginActionStats& GetActionStats(int action) const;
+    
+    // Loaded plugin count
+    int GetPluginCount() const;
+    
+    // The API handed to plugins, for handlers linked into the host (benchmarks)
+    const KmmHostApi* GetHostApi() const;
+
+private:
+    struct Plugin {
+        HMODULE module;
+        std::string path;
+        KmmPluginShutdownProc shutdown;
+    };
+    
+    struct Action {
+        char name[KMM_ACTION_NAME_SIZE];
+        KmmActionHandler handler;
+        void* userData;
+        PluginActionStats stats;
+    };
+    
+    Plugin m_plugins[MAX_PLUGINS];
+    int m_pluginCount;
+    Action m_actions[MAX_PLUGIN_ACTIONS];
+    int m_actionCount;
+    
+    // Action index per virtual key (-1 if unbound)
+    int m_keyActions[256];
+    KeyBitset m_actionKeys;
+    
+    // Handed to every plugin; its context is this host
+    KmmHostApi m_api;
+    
+    // Host API entry points
+    static int KMM_CALL RegisterAction(void* context, const char* name, KmmActionHandler handler, void* userData);
+    static void KMM_CALL Log(void* context, const char* message);
+};
+
+#endif // PLUGIN_HOST_H
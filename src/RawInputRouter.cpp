@@ -0,0 +1,291 @@
+#include "RawInputRouter.h"
+#include <iostream>
+#include <algorithm>
+
+// HID usage of a keyboard (generic desktop page)
+#define HID_USAGE_PAGE_GENERIC 0x01
+#define HID_USAGE_MOUSE        0x02
+#define HID_USAGE_KEYBOARD     0x06
+
+#ifndef MOUSE_MOVE_ABSOLUTE
+#define MOUSE_MOVE_ABSOLUTE 1
+#endif
+
+// Raw keyboard flags and the VK of fake keys sent as part of escape sequences
+#ifndef RI_KEY_BREAK
+#define RI_KEY_BREAK 1
+#define RI_KEY_E0    2
+#endif
+#define RAW_FAKE_KEY 0xFF
+
+// Scan code of the right Shift key (Shift has no E0 prefix to tell the sides apart)
+#define SCANCODE_RSHIFT 0x36
+
+#ifndef RIDEV_DEVNOTIFY
+#define RIDEV_DEVNOTIFY 0x00002000
+#endif
+
+#ifndef GIDC_ARRIVAL
+#define GIDC_ARRIVAL 1
+#define GIDC_REMOVAL 2
+#endif
+
+RawInputRouter* RawInputRouter::s_instance = nullptr;
+
+RawInputRouter::RawInputRouter()
+    : m_hwnd(nullptr)
+    , m_handler(nullptr)
+    , m_handlerContext(nullptr)
+    , m_mouseHandler(nullptr)
+    , m_mouseContext(nullptr)
+    , m_keyboardRegistered(false)
+    , m_mouseRegistered(false) {
+    s_instance = this;
+}
+
+RawInputRouter::~RawInputRouter() {
+    Shutdown();
+    s_instance = nullptr;
+}
+
+bool RawInputRouter::Initialize(bool keyboard) {
+    if (m_hwnd != nullptr) {
+        return true;
+    }
+    
+    const wchar_t CLASS_NAME[] = L"KeyboardMapRawInput";
+    
+    WNDCLASSW wc = {};
+    wc.lpfnWndProc = WindowProc;
+    wc.hInstance = GetModuleHandle(nullptr);
+    wc.lpszClassName = CLASS_NAME;
+    RegisterClassW(&wc);
+    
+    // Message-only window: receives WM_INPUT without ever being shown
+    m_hwnd = CreateWindowExW(0, CLASS_NAME, L"", 0, 0, 0, 0, 0,
+                             HWND_MESSAGE, nullptr, GetModuleHandle(nullptr), nullptr);
+    if (m_hwnd == nullptr) {
+        std::cerr << "Failed to create raw input window. Error: " << GetLastError() << std::endl;
+        return false;
+    }
+    
+    // Keyboard input even while another window has focus, plus hot-plug notifications
+    if (keyboard) {
+        if (!RegisterUsage(HID_USAGE_KEYBOARD, RIDEV_INPUTSINK | RIDEV_DEVNOTIFY)) {
+            std::cerr << "Failed to register for raw keyboard input. Error: " << GetLastError() << std::endl;
+            DestroyWindow(m_hwnd);
+            m_hwnd = nullptr;
+            return false;
+        }
+        m_keyboardRegistered = true;
+    }
+    
+    return true;
+}
+
+void RawInputRouter::Shutdown() {
+    if (m_hwnd == nullptr) {
+        return;
+    }
+    
+    if (m_keyboardRegistered) {
+        RegisterUsage(HID_USAGE_KEYBOARD, RIDEV_REMOVE);
+        m_keyboardRegistered = false;
+    }
+    SetMouseEnabled(false);
+    
+    DestroyWindow(m_hwnd);
+    m_hwnd = nullptr;
+}
+
+bool RawInputRouter::RegisterUsage(USHORT usage, DWORD flags) {
+    RAWINPUTDEVICE device;
+    device.usUsagePage = HID_USAGE_PAGE_GENERIC;
+    device.usUsage = usage;
+    device.dwFlags = flags;
+    device.hwndTarget = (flags & RIDEV_REMOVE) ? nullptr : m_hwnd;
+    return RegisterRawInputDevices(&device, 1, sizeof(device)) != FALSE;
+}
+
+bool RawInputRouter::SetMouseEnabled(bool enabled) {
+    if (m_hwnd == nullptr || enabled == m_mouseRegistered) {
+        return enabled == m_mouseRegistered;
+    }
+    
+    // Input sink: motion keeps arriving while the game window has focus
+    if (!RegisterUsage(HID_USAGE_MOUSE, enabled ? RIDEV_INPUTSINK : RIDEV_REMOVE)) {
+        std::cerr << "Failed to " << (enabled ? "register" : "unregister")
+                  << " raw mouse input. Error: " << GetLastError() << std::endl;
+        return false;
+    }
+    m_mouseRegistered = enabled;
+    return true;
+}
+
+bool RawInputRouter::IsMouseEnabled() const {
+    return m_mouseRegistered;
+}
+
+void RawInputRouter::SetDevicePatterns(const std::vector<std::string>& patterns) {
+    m_patterns.clear();
+    for (std::string pattern : patterns) {
+        std::transform(pattern.begin(), pattern.end(), pattern.begin(), ::toupper);
+        m_patterns.push_back(pattern);
+    }
+    
+    // Handles have to be matched again against the new patterns
+    m_deviceCache.clear();
+    for (auto& keys : m_downKeys) {
+        keys.Reset();
+    }
+}
+
+void RawInputRouter::SetKeyFilter(const KeyBitset& keys) {
+    m_filterKeys = keys;
+}
+
+bool RawInputRouter::IsDeviceConnected(int device) const {
+    for (const auto& entry : m_deviceCache) {
+        if (entry.device == device) {
+            return true;
+        }
+    }
+    return false;
+}
+
+LRESULT CALLBACK RawInputRouter::WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    RawInputRouter* router = s_instance;
+    if (router != nullptr) {
+        if (uMsg == WM_INPUT) {
+            router->OnRawInput(reinterpret_cast<HRAWINPUT>(lParam));
+        } else if (uMsg == WM_INPUT_DEVICE_CHANGE) {
+            router->OnDeviceChange(wParam, reinterpret_cast<HANDLE>(lParam));
+            return 0;
+        }
+    }
+    
+    // WM_INPUT must reach DefWindowProc so the system can free the input
+    return DefWindowProcW(hwnd, uMsg, wParam, lParam);
+}
+
+void RawInputRouter::OnRawInput(HRAWINPUT input) {
+    RAWINPUT raw;
+    UINT size = sizeof(raw);
+    if (GetRawInputData(input, RID_INPUT, &raw, &size, sizeof(RAWINPUTHEADER)) == (UINT)-1) {
+        return;
+    }
+    
+    // Relative motion only (tablets and remote sessions report absolute positions)
+    if (raw.header.dwType == RIM_TYPEMOUSE) {
+        const RAWMOUSE& mouse = raw.data.mouse;
+        if (m_mouseHandler != nullptr && (mouse.usFlags & MOUSE_MOVE_ABSOLUTE) == 0 &&
+            (mouse.lLastX != 0 || mouse.lLastY != 0)) {
+            m_mouseHandler(m_mouseContext, mouse.lLastX, mouse.lLastY);
+        }
+        return;
+    }
+    if (raw.header.dwType != RIM_TYPEKEYBOARD) {
+        return;
+    }
+    
+    const RAWKEYBOARD& keyboard = raw.data.keyboard;
+    int virtualKey = keyboard.VKey;
+    bool isDown = (keyboard.Flags & RI_KEY_BREAK) == 0;
+    
+    if (virtualKey == RAW_FAKE_KEY || virtualKey == 0) {
+        return;
+    }
+    
+    // Raw input reports generic modifiers; mappings use the hook's left/right codes
+    switch (virtualKey) {
+        case VK_SHIFT:
+            virtualKey = (keyboard.MakeCode == SCANCODE_RSHIFT) ? VK_RSHIFT : VK_LSHIFT;
+            break;
+        case VK_CONTROL:
+            virtualKey = (keyboard.Flags & RI_KEY_E0) ? VK_RCONTROL : VK_LCONTROL;
+            break;
+        case VK_MENU:
+            virtualKey = (keyboard.Flags & RI_KEY_E0) ? VK_RMENU : VK_LMENU;
+            break;
+    }
+    virtualKey &= 0xFF;
+    
+    // Key-ups always pass when their key-down was reported, even if the filter changed since
+    if (m_handler == nullptr || (isDown && !m_filterKeys.Test(virtualKey))) {
+        return;
+    }
+    
+    // Input injected by software has no device handle and counts as any keyboard
+    int device = (raw.header.hDevice != nullptr) ? GetDeviceForHandle(raw.header.hDevice) : 0;
+    
+    KeyBitset& downKeys = m_downKeys[device];
+    if (isDown) {
+        if (downKeys.Test(virtualKey)) {
+            return;
+        }
+        downKeys.Set(virtualKey);
+    } else {
+        if (!downKeys.Test(virtualKey)) {
+            return;
+        }
+        downKeys.Clear(virtualKey);
+    }
+    
+    m_handler(m_handlerContext, device, virtualKey, isDown);
+}
+
+void RawInputRouter::OnDeviceChange(WPARAM change, HANDLE handle) {
+    if (change == GIDC_REMOVAL) {
+        for (auto it = m_deviceCache.begin(); it != m_deviceCache.end(); ++it) {
+            if (it->handle == handle) {
+                if (it->device > 0) {
+                    std::cout << "Input device " << it->device << " disconnected." << std::endl;
+                }
+                m_deviceCache.erase(it);
+                break;
+            }
+        }
+    } else if (change == GIDC_ARRIVAL) {
+        int device = GetDeviceForHandle(handle);
+        if (device > 0) {
+            std::cout << "Input device " << device << " connected." << std::endl;
+        }
+    }
+}
+
+int RawInputRouter::GetDeviceForHandle(HANDLE handle) {
+    for (const auto& entry : m_deviceCache) {
+        if (entry.handle == handle) {
+            return entry.device;
+        }
+    }
+    
+    DeviceEntry entry;
+    entry.handle = handle;
+    entry.device = MatchDevice(handle);
+    m_deviceCache.push_back(entry);
+    return entry.device;
+}
+
+int RawInputRouter::MatchDevice(HANDLE handle) const {
+    if (m_patterns.empty()) {
+        return 0;
+    }
+    
+    char name[512];
+    UINT size = sizeof(name);
+    if (GetRawInputDeviceInfoA(handle, RIDI_DEVICENAME, name, &size) == (UINT)-1) {
+        return 0;
+    }
+    name[sizeof(name) - 1] = '\0';
+    
+    std::string deviceName(name);
+    std::transform(deviceName.begin(), deviceName.end(), deviceName.begin(), ::toupper);
+    
+    for (size_t i = 0; i < m_patterns.size() && i < MAX_KEY_DEVICES; ++i) {
+        if (!m_patterns[i].empty() && deviceName.find(m_patterns[i]) != std::string::npos) {
+            return static_cast<int>(i) + 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+#ifndef RAW_INPUT_ROUTER_H
+#define RAW_INPUT_ROUTER_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "ConfigManager.h"
+#include "KeyState.h"
+
+// Reports key events together with the keyboard they came from.
+// The low-level hook carries no device identity, so keys that need it are
+// read from Raw Input on a message-only window; device handles are matched
+// to configured devices once and cached. Relative mouse motion can be read
+// the same way (mouse look).
+class RawInputRouter {
+public:
+    // Device key handler: device 0 is any keyboard without its own mappings
+    typedef void (*DeviceKeyHandlerProc)(void* context, int device, int virtualKey, bool isDown);
+    
+    // Mouse motion handler: counts moved since the last report (not pixels)
+    typedef void (*MouseMotionHandlerProc)(void* context, int dx, int dy);
+    
+    RawInputRouter();
+    ~RawInputRouter();
+    
+    // Create the message-only window and register for keyboard raw input
+    // (a router used only for the mouse skips the keyboard)
+    bool Initialize(bool keyboard = true);
+    
+    // Unregister and destroy the window
+    void Shutdown();
+    
+    // Bind the handler at compile time: SetKeyHandler<App, &App::OnDeviceKey>(app)
+    template <class T, void (T::*Method)(int, int, bool)>
+    void SetKeyHandler(T* target) {
+        m_handlerContext = target;
+        m_handler = &InvokeHandler<T, Method>;
+    }
+    
+    // Bind the mouse motion handler: SetMouseHandler<App, &App::OnMouseMotion>(app)
+    template <class T, void (T::*Method)(int, int)>
+    void SetMouseHandler(T* target) {
+        m_mouseContext = target;
+        m_mouseHandler = &InvokeMouseHandler<T, Method>;
+    }
+    
+    // Register or unregister for mouse raw input. A high-rate mouse sends
+    // thousands of messages a second, so it is only read while needed.
+    bool SetMouseEnabled(bool enabled);
+    bool IsMouseEnabled() const;
+    
+    // Set the device name patterns (pattern i is device i + 1)
+    void SetDevicePatterns(const std::vector<std::string>& patterns);
+    
+    // Set the keys to report; all others are ignored
+    void SetKeyFilter(const KeyBitset& keys);
+    
+    // Check if a configured device has been seen
+    bool IsDeviceConnected(int device) const;
+
+private:
+    HWND m_hwnd;
+    DeviceKeyHandlerProc m_handler;
+    void* m_handlerContext;
+    MouseMotionHandlerProc m_mouseHandler;
+    void* m_mouseContext;
+    bool m_keyboardRegistered;
+    bool m_mouseRegistered;
+    
+    // Upper-case device name patterns
+    std::vector<std::string> m_patterns;
+    
+    // Device handle -> device ID, filled on first input from each keyboard
+    struct DeviceEntry {
+        HANDLE handle;
+        int device;
+    };
+    std::vector<DeviceEntry> m_deviceCache;
+    
+    KeyBitset m_filterKeys;
+    
+    // Keys down per device (to drop auto-repeat and unmatched key-ups)
+    KeyBitset m_downKeys[MAX_KEY_DEVICES + 1];
+    
+    static RawInputRouter* s_instance;
+    static LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+    
+    template <class T, void (T::*Method)(int, int, bool)>
+    static void InvokeHandler(void* context, int device, int virtualKey, bool isDown) {
+        (static_cast<T*>(context)->*Method)(device, virtualKey, isDown);
+    }
+    
+    template <class T, void (T::*Method)(int, int)>
+    static void InvokeMouseHandler(void* context, int dx, int dy) {
+        (static_cast<T*>(context)->*Method)(dx, dy);
+    }
+    
+    // Register (or with RIDEV_REMOVE, unregister) one generic desktop usage
+    bool RegisterUsage(USHORT usage, DWORD flags);
+    
+    // Decode one WM_INPUT message
+    void OnRawInput(HRAWINPUT input);
+    
+    // Handle keyboard arrival/removal
+    void OnDeviceChange(WPARAM change, HANDLE handle);
+    
+    // Get the device ID of a raw input handle (cached)
+    int GetDeviceForHandle(HANDLE handle);
+    
+    // Match a device name against the patterns; returns the device ID or 0
+    int MatchDevice(HANDLE handle) const;
+};
+
+#endif // RAW_INPUT_ROUTER_H
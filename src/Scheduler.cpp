@@ -0,0 +1,198 @@
+#include "Scheduler.h"
+#include <mmsystem.h>
+#include <algorithm>
+#include <iostream>
+
+#pragma comment(lib, "winmm.lib")
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// Wake this long before a deadline and spin the rest (microseconds)
+#define SCHEDULER_SPIN_US 300
+
+// Task slots reserved up front so scheduling never allocates in steady state
+// (one turbo task per held key plus the periodic tasks fits easily)
+#define SCHEDULER_RESERVED_TASKS 64
+
+Scheduler::Scheduler()
+    : m_nextTaskId(1)
+    , m_clock(&SystemClock::Instance())
+    , m_simulatedClock(nullptr)
+    , m_timer(nullptr)
+    , m_highResolution(false)
+    , m_maxLatenessUs(0) {
+    m_tasks.reserve(SCHEDULER_RESERVED_TASKS);
+}
+
+Scheduler::Scheduler(SimulatedClock* clock)
+    : m_nextTaskId(1)
+    , m_clock(clock)
+    , m_simulatedClock(clock)
+    , m_timer(nullptr)
+    , m_highResolution(false)
+    , m_maxLatenessUs(0) {
+    m_tasks.reserve(SCHEDULER_RESERVED_TASKS);
+}
+
+Scheduler::~Scheduler() {
+    if (m_timer) {
+        CancelWaitableTimer(m_timer);
+        CloseHandle(m_timer);
+        
+        // The fallback timer raised the system timer resolution
+        if (!m_highResolution) {
+            timeEndPeriod(1);
+        }
+    }
+}
+
+bool Scheduler::Initialize() {
+    if (m_timer != nullptr || m_simulatedClock != nullptr) {
+        return true;
+    }
+    
+    // High-resolution timers are available on Windows 10 1803 and later
+    m_timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (m_timer != nullptr) {
+        m_highResolution = true;
+        return true;
+    }
+    
+    // Fallback: regular timer with 1 ms system timer resolution
+    m_timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+    if (m_timer == nullptr) {
+        std::cerr << "Failed to create scheduler timer. Error: " << GetLastError() << std::endl;
+        return false;
+    }
+    timeBeginPeriod(1);
+    return true;
+}
+
+int64_t Scheduler::Now() const {
+    return m_clock->Now();
+}
+
+int Scheduler::Schedule(int64_t dueTimeUs, TaskProc proc, void* context, int param, bool precise) {
+    if (proc == nullptr) {
+        return 0;
+    }
+    
+    Task task;
+    task.dueTime = dueTimeUs;
+    task.id = m_nextTaskId++;
+    task.proc = proc;
+    task.context = context;
+    task.param = param;
+    task.precise = precise;
+    
+    m_tasks.push_back(task);
+    std::push_heap(m_tasks.begin(), m_tasks.end(), TaskLater);
+    
+    // Only re-arm if the new task became the earliest one
+    if (m_tasks.front().id == task.id) {
+        ArmTimer();
+    }
+    return task.id;
+}
+
+bool Scheduler::Cancel(int taskId) {
+    for (auto it = m_tasks.begin(); it != m_tasks.end(); ++it) {
+        if (it->id == taskId) {
+            m_tasks.erase(it);
+            std::make_heap(m_tasks.begin(), m_tasks.end(), TaskLater);
+            ArmTimer();
+            return true;
+        }
+    }
+    return false;
+}
+
+void Scheduler::RunDueTasks() {
+    while (!m_tasks.empty()) {
+        int64_t now = Now();
+        int64_t dueTime = m_tasks.front().dueTime;
+        
+        if (dueTime > now) {
+            // Simulated time never moves on its own, so there is nothing to spin for
+            if (!m_tasks.front().precise || dueTime - now > SCHEDULER_SPIN_US ||
+                m_simulatedClock != nullptr) {
+                break;
+            }
+            // Close enough: spin to the exact deadline
+            while (Now() < dueTime) {
+            }
+            continue;
+        }
+        
+        std::pop_heap(m_tasks.begin(), m_tasks.end(), TaskLater);
+        Task task = m_tasks.back();
+        m_tasks.pop_back();
+        
+        if (task.precise && now - task.dueTime > m_maxLatenessUs) {
+            m_maxLatenessUs = now - task.dueTime;
+        }
+        
+        // The task may schedule or cancel other tasks
+        task.proc(task.context, task.param);
+    }
+    
+    ArmTimer();
+}
+
+bool Scheduler::RunUntil(int64_t endUs) {
+    if (m_simulatedClock == nullptr) {
+        return false;
+    }
+    
+    // Tasks scheduled by the tasks themselves are picked up in the same pass
+    while (!m_tasks.empty() && m_tasks.front().dueTime <= endUs) {
+        m_simulatedClock->AdvanceTo(m_tasks.front().dueTime);
+        RunDueTasks();
+    }
+    m_simulatedClock->AdvanceTo(endUs);
+    return true;
+}
+
+const Clock& Scheduler::GetClock() const {
+    return *m_clock;
+}
+
+HANDLE Scheduler::GetWaitHandle() const {
+    return m_timer;
+}
+
+bool Scheduler::CanRunTasks() const {
+    return m_timer != nullptr || m_simulatedClock != nullptr;
+}
+
+size_t Scheduler::GetPendingCount() const {
+    return m_tasks.size();
+}
+
+int64_t Scheduler::GetMaxLatenessUs() const {
+    return m_maxLatenessUs;
+}
+
+void Scheduler::ArmTimer() {
+    if (m_timer == nullptr) {
+        return;
+    }
+    
+    if (m_tasks.empty()) {
+        CancelWaitableTimer(m_timer);
+        return;
+    }
+    
+    // Relative due time in 100 ns units (negative = relative); precise tasks wake early to spin
+    const Task& next = m_tasks.front();
+    int64_t wait = next.dueTime - (next.precise ? SCHEDULER_SPIN_US : 0) - Now();
+    LARGE_INTEGER dueTime;
+    dueTime.QuadPart = (wait > 0) ? -wait * 10 : -1;
+    SetWaitableTimer(m_timer, &dueTime, 0, nullptr, nullptr, FALSE);
+}
+
+bool Scheduler::TaskLater(const Task& a, const Task& b) {
+    return a.dueTime > b.dueTime;
+}
@@ -0,0 +1,90 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <windows.h>
+#include <vector>
+#include <cstdint>
+#include "Clock.h"
+
+// Runs timed tasks on the main thread with sub-millisecond precision.
+// A high-resolution waitable timer wakes the message loop shortly before
+// the earliest deadline and the remaining time is spun off, so tasks fire
+// with well under 1 ms of jitter without a dedicated thread.
+//
+// On a simulated clock nothing waits: RunUntil() jumps the clock from one
+// task's due time to the next, so long stretches run as fast as the tasks do.
+class Scheduler {
+public:
+    typedef void (*TaskProc)(void* context, int param);
+    
+    // Real time (the system clock)
+    Scheduler();
+    
+    // Simulated time driven by RunUntil (the clock must outlive the scheduler)
+    explicit Scheduler(SimulatedClock* clock);
+    
+    ~Scheduler();
+    
+    // Create the waitable timer (nothing to create on a simulated clock)
+    bool Initialize();
+    
+    // Current time in microseconds
+    int64_t Now() const;
+    
+    // Run proc(context, param) at dueTimeUs; returns a task ID (0 on failure).
+    // Imprecise tasks skip the final spin and may run up to ~1 ms late (for polling).
+    int Schedule(int64_t dueTimeUs, TaskProc proc, void* context, int param, bool precise = true);
+    
+    // Cancel a pending task
+    bool Cancel(int taskId);
+    
+    // Run every task that is due and re-arm the timer
+    void RunDueTasks();
+    
+    // Simulated clock only: run every task due up to endUs in order, advancing
+    // the clock to each task's due time, and leave the clock at endUs
+    bool RunUntil(int64_t endUs);
+    
+    // Clock the tasks are timed on
+    const Clock& GetClock() const;
+    
+    // Handle signaled when the next task is (nearly) due; wait on it in the message loop
+    // (null on a simulated clock)
+    HANDLE GetWaitHandle() const;
+    
+    // Check if scheduled tasks get run: the timer exists, or time is simulated
+    // (RunUntil runs them)
+    bool CanRunTasks() const;
+    
+    // Number of pending tasks
+    size_t GetPendingCount() const;
+    
+    // Worst observed lateness of a precise task, in microseconds
+    int64_t GetMaxLatenessUs() const;
+
+private:
+    struct Task {
+        int64_t dueTime;
+        int id;
+        TaskProc proc;
+        void* context;
+        int param;
+        bool precise;
+    };
+    
+    // Min-heap on dueTime
+    std::vector<Task> m_tasks;
+    int m_nextTaskId;
+    const Clock* m_clock;
+    SimulatedClock* m_simulatedClock;  // Null in real time
+    HANDLE m_timer;
+    bool m_highResolution;
+    int64_t m_maxLatenessUs;
+    
+    // Arm the waitable timer for the earliest task
+    void ArmTimer();
+    
+    static bool TaskLater(const Task& a, const Task& b);
+};
+
+#endif // SCHEDULER_H
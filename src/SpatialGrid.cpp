@@ -0,0 +1,83 @@
+#include "SpatialGrid.h"
+
+SpatialGrid::SpatialGrid()
+    : m_cellSize(1)
+    , m_columns(0)
+    , m_rows(0) {
+}
+
+void SpatialGrid::Reset(int width, int height, int cellSize) {
+    m_cellSize = (cellSize > 0) ? cellSize : 1;
+    m_columns = (width > 0) ? (width + m_cellSize - 1) / m_cellSize : 0;
+    m_rows = (height > 0) ? (height + m_cellSize - 1) / m_cellSize : 0;
+    
+    m_cellStart.assign(m_columns * m_rows + 1, 0);
+    m_items.clear();
+}
+
+void SpatialGrid::Build(const RECT* bounds, const int* ids, int count) {
+    int cellCount = m_columns * m_rows;
+    m_cellStart.assign(cellCount + 1, 0);
+    
+    // Count the items per cell (shifted by one, so the prefix sum gives starts)
+    int firstColumn, firstRow, lastColumn, lastRow;
+    for (int i = 0; i < count; ++i) {
+        if (!GetCellRange(bounds[i], firstColumn, firstRow, lastColumn, lastRow)) continue;
+        for (int row = firstRow; row <= lastRow; ++row) {
+            for (int column = firstColumn; column <= lastColumn; ++column) {
+                ++m_cellStart[row * m_columns + column + 1];
+            }
+        }
+    }
+    for (int cell = 0; cell < cellCount; ++cell) {
+        m_cellStart[cell + 1] += m_cellStart[cell];
+    }
+    
+    // Place each item in its cells
+    m_items.resize(m_cellStart[cellCount]);
+    m_fill.assign(m_cellStart.begin(), m_cellStart.end() - 1);
+    for (int i = 0; i < count; ++i) {
+        if (!GetCellRange(bounds[i], firstColumn, firstRow, lastColumn, lastRow)) continue;
+        for (int row = firstRow; row <= lastRow; ++row) {
+            for (int column = firstColumn; column <= lastColumn; ++column) {
+                m_items[m_fill[row * m_columns + column]++] = ids[i];
+            }
+        }
+    }
+}
+
+const int* SpatialGrid::Query(int x, int y, int& count) const {
+    count = 0;
+    if (x < 0 || y < 0 || m_items.empty()) {
+        return nullptr;
+    }
+    
+    int column = x / m_cellSize;
+    int row = y / m_cellSize;
+    if (column >= m_columns || row >= m_rows) {
+        return nullptr;
+    }
+    
+    int cell = row * m_columns + column;
+    count = m_cellStart[cell + 1] - m_cellStart[cell];
+    return m_items.data() + m_cellStart[cell];
+}
+
+bool SpatialGrid::GetCellRange(const RECT& bounds, int& firstColumn, int& firstRow,
+                               int& lastColumn, int& lastRow) const {
+    // RECT right/bottom are exclusive
+    if (bounds.right <= 0 || bounds.bottom <= 0 || bounds.right <= bounds.left || bounds.bottom <= bounds.top) {
+        return false;
+    }
+    
+    firstColumn = (bounds.left > 0) ? bounds.left / m_cellSize : 0;
+    firstRow = (bounds.top > 0) ? bounds.top / m_cellSize : 0;
+    lastColumn = (bounds.right - 1) / m_cellSize;
+    lastRow = (bounds.bottom - 1) / m_cellSize;
+    if (firstColumn >= m_columns || firstRow >= m_rows) {
+        return false;
+    }
+    if (lastColumn >= m_columns) lastColumn = m_columns - 1;
+    if (lastRow >= m_rows) lastRow = m_rows - 1;
+    return true;
+}
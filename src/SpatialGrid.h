@@ -0,0 +1,41 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <windows.h>
+#include <vector>
+
+// Uniform grid over item rectangles for hit-testing. Each item is listed in
+// every cell its bounds overlap, so a point query looks at one cell only.
+// The cell lists are packed into one array (counting sort), so a rebuild
+// allocates only when the grid or item count grows.
+class SpatialGrid {
+public:
+    SpatialGrid();
+    
+    // Cover a width x height area with square cells (clears the items)
+    void Reset(int width, int height, int cellSize);
+    
+    // Replace the items: bounds[i] is listed under ids[i]. Parts outside the
+    // covered area are dropped.
+    void Build(const RECT* bounds, const int* ids, int count);
+    
+    // Get the items whose bounds overlap the cell containing a point
+    // (count is 0 outside the covered area)
+    const int* Query(int x, int y, int& count) const;
+
+private:
+    int m_cellSize;
+    int m_columns;
+    int m_rows;
+    
+    // Cell c lists m_items[m_cellStart[c]] to m_items[m_cellStart[c + 1] - 1]
+    std::vector<int> m_cellStart;
+    std::vector<int> m_items;
+    std::vector<int> m_fill;  // Build scratch: next free slot per cell
+    
+    // Get the cells a rectangle overlaps; returns false if it misses the area
+    bool GetCellRange(const RECT& bounds, int& firstColumn, int& firstRow,
+                      int& lastColumn, int& lastRow) const;
+};
+
+#endif // SPATIAL_GRID_H
@@ -0,0 +1,149 @@
+#include "StatsPage.h"
+#include <iostream>
+#include <cstddef>
+#include <cstring>
+
+// Reader attempts before giving up on a page that is always mid-update
+#define STATS_READ_RETRIES 100
+
+LatencyHistogram::LatencyHistogram()
+    : m_count(0)
+    , m_maxUs(0) {
+    memset(m_buckets, 0, sizeof(m_buckets));
+}
+
+void LatencyHistogram::Record(int64_t latencyUs) {
+    int bucket = 0;
+    for (int64_t rest = latencyUs; rest > 0 && bucket < LATENCY_BUCKET_COUNT - 1; rest >>= 1) {
+        ++bucket;
+    }
+    ++m_buckets[bucket];
+    ++m_count;
+    if (latencyUs > m_maxUs) {
+        m_maxUs = latencyUs;
+    }
+}
+
+int64_t LatencyHistogram::Percentile(double fraction) const {
+    if (m_count == 0) {
+        return 0;
+    }
+    
+    uint64_t target = static_cast<uint64_t>(fraction * m_count);
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < LATENCY_BUCKET_COUNT; ++bucket) {
+        seen += m_buckets[bucket];
+        if (seen > target) {
+            return (bucket == 0) ? 0 : (int64_t(1) << bucket) - 1;
+        }
+    }
+    return m_maxUs;
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+    return m_count;
+}
+
+int64_t LatencyHistogram::GetMaxUs() const {
+    return m_maxUs;
+}
+
+const uint64_t* LatencyHistogram::GetBuckets() const {
+    return m_buckets;
+}
+
+StatsPage::StatsPage()
+    : m_mapping(nullptr)
+    , m_page(nullptr) {
+}
+
+StatsPage::~StatsPage() {
+    Close();
+}
+
+bool StatsPage::Create() {
+    if (m_page != nullptr) {
+        return true;
+    }
+    
+    m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                   0, sizeof(StatsPageData), STATS_PAGE_NAME);
+    if (m_mapping == nullptr) {
+        std::cerr << "Failed to create stats page. Error: " << GetLastError() << std::endl;
+        return false;
+    }
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        std::cerr << "Stats page already exists (another instance running?)." << std::endl;
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+        return false;
+    }
+    
+    m_page = static_cast<StatsPageData*>(MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, sizeof(StatsPageData)));
+    if (m_page == nullptr) {
+        std::cerr << "Failed to map stats page. Error: " << GetLastError() << std::endl;
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+        return false;
+    }
+    
+    // Fresh sections are zero-filled; the magic goes in last so readers never see a half header
+    m_page->version = STATS_PAGE_VERSION;
+    m_page->size = sizeof(StatsPageData);
+    m_page->processId = GetCurrentProcessId();
+    MemoryBarrier();
+    m_page->magic = STATS_PAGE_MAGIC;
+    return true;
+}
+
+void StatsPage::Close() {
+    if (m_page != nullptr) {
+        UnmapViewOfFile(m_page);
+        m_page = nullptr;
+    }
+    if (m_mapping != nullptr) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+}
+
+void StatsPage::Publish(const StatsPageData& data) {
+    if (m_page == nullptr) {
+        return;
+    }
+    
+    // Interlocked increments are full barriers: the body is written strictly
+    // between the odd and the following even sequence number
+    InterlockedIncrement(&m_page->sequence);
+    
+    // Everything after the header fields
+    const size_t bodyOffset = offsetof(StatsPageData, publishTimeUs);
+    memcpy(reinterpret_cast<char*>(m_page) + bodyOffset,
+           reinterpret_cast<const char*>(&data) + bodyOffset,
+           sizeof(StatsPageData) - bodyOffset);
+    m_page->processId = GetCurrentProcessId();
+    
+    InterlockedIncrement(&m_page->sequence);
+}
+
+bool StatsPage::Read(const StatsPageData* page, StatsPageData& snapshot) {
+    if (page == nullptr || page->magic != STATS_PAGE_MAGIC ||
+        page->version != STATS_PAGE_VERSION || page->size < sizeof(StatsPageData)) {
+        return false;
+    }
+    
+    for (int attempt = 0; attempt < STATS_READ_RETRIES; ++attempt) {
+        LONG before = page->sequence;
+        if (before & 1) {
+            YieldProcessor();
+            continue;
+        }
+        MemoryBarrier();
+        memcpy(&snapshot, const_cast<const StatsPageData*>(page), sizeof(StatsPageData));
+        MemoryBarrier();
+        if (page->sequence == before) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,106 @@
+#ifndef STATS_PAGE_H
+#define STATS_PAGE_H
+
+#include <windows.h>
+#include <cstdint>
+
+// Name of the shared stats page (per session)
+#define STATS_PAGE_NAME "Local\\KeyboardMapTouchStats"
+
+// Page identification; the version changes whenever fields move or change
+// meaning. New fields are only ever appended, so readers check size too.
+#define STATS_PAGE_MAGIC   0x534D4D4B  // "KMMS"
+#define STATS_PAGE_VERSION 1
+
+// Latency histogram buckets: bucket 0 is < 1 us, bucket i is [2^(i-1), 2^i) us
+#define LATENCY_BUCKET_COUNT 24
+
+// Layout of the shared stats page. Only fixed-width fields, so tools built
+// with other compilers (or in other languages) can map it directly.
+struct StatsPageData {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;            // sizeof(StatsPageData) of the writer
+    volatile LONG sequence;   // Seqlock: odd while the writer is updating
+    
+    int64_t publishTimeUs;    // QPC time of the last update
+    uint32_t processId;
+    uint32_t mode;            // 0 = recording, 1 = mapping, 2 = idle
+    uint32_t activeLayers;    // Bit per active layer
+    uint32_t mappingCount;
+    
+    uint64_t keyEvents;       // Key events handled (keyboard and gamepad)
+    uint64_t mappedKeyDowns;  // Key downs that triggered a mapping
+    uint64_t controlCommands; // Commands received over the control pipe
+    uint64_t frameFlushes;
+    uint64_t lateFrames;
+    int64_t schedulerMaxLatenessUs;
+    
+    // Key event handling time (hook callback entry to return)
+    uint64_t latencyCount;
+    int64_t latencyP50Us;
+    int64_t latencyP99Us;
+    int64_t latencyP999Us;
+    int64_t latencyMaxUs;
+    uint64_t latencyBuckets[LATENCY_BUCKET_COUNT];
+    
+    // Keyboard hook health (callback time is measured inside the hook)
+    uint64_t hookCallbacks;
+    uint64_t hookSlowCallbacks;   // Over half the OS hook timeout
+    int64_t hookMaxCallbackUs;
+    uint64_t hookReinstalls;      // Times the watchdog found the hook dropped
+    uint64_t hookOrphanedKeys;    // Stuck keys released by the watchdog
+    
+    // Main loop wake-ups (both stay flat while the process is idle)
+    uint64_t wakeups;
+    uint64_t timerWakeups;        // Caused by the scheduler timer
+};
+
+// Log2 histogram of latencies in microseconds
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+    
+    // Add one sample
+    void Record(int64_t latencyUs);
+    
+    // Upper bound of the bucket holding the given fraction of samples (e.g. 0.99)
+    int64_t Percentile(double fraction) const;
+    
+    uint64_t GetCount() const;
+    int64_t GetMaxUs() const;
+    const uint64_t* GetBuckets() const;
+
+private:
+    uint64_t m_buckets[LATENCY_BUCKET_COUNT];
+    uint64_t m_count;
+    int64_t m_maxUs;
+};
+
+// Publishes StatsPageData in a named shared memory section.
+// Readers map the section and copy it under the seqlock (see Read), so
+// reading needs no system call and never blocks or slows the writer.
+class StatsPage {
+public:
+    StatsPage();
+    ~StatsPage();
+    
+    // Create the shared memory section
+    bool Create();
+    
+    // Unmap and close the section
+    void Close();
+    
+    // Copy a new snapshot into the page (header fields are filled in)
+    void Publish(const StatsPageData& data);
+    
+    // Copy a consistent snapshot out of a mapped page; false if the page is
+    // not a compatible stats page or stayed busy for every retry
+    static bool Read(const StatsPageData* page, StatsPageData& snapshot);
+
+private:
+    HANDLE m_mapping;
+    StatsPageData* m_page;
+};
+
+#endif // STATS_PAGE_H
@@ -1,4 +1,7 @@
 #include "TouchInjector.h"
+#include "EventStream.h"
+#include "Scheduler.h"
+#include "Tracer.h"
 #include <iostream>
 
 // Touch injection constants
@@ -6,9 +9,7 @@
 #define TOUCH_MASK_ORIENTATION  0x00000002
 #define TOUCH_MASK_PRESSURE     0x00000004
 #define TOUCH_HOLD_DURATION_MS  50
-#define TOUCH_CONTACT_RADIUS    2
-#define TOUCH_DEFAULT_PRESSURE  32000
-#define TOUCH_DEFAULT_ORIENTATION 90
+#define CURSOR_RESTORE_DELAY_MS 50
 
 // PT_TOUCH constant if not defined
 #ifndef PT_TOUCH
@@ -18,25 +19,46 @@
 TouchInjector::TouchInjector()
     : m_initialized(false)
     , m_supported(false)
+    , m_frameHead(0)
+    , m_frameCount(0)
+    , m_frameBatching(false)
+    , m_eventStream(nullptr)
+    , m_scheduler(nullptr)
+    , m_contactCount(0)
+    , m_cursorRestoreTask(0)
     , m_user32Module(nullptr)
     , m_initializeTouchInjection(nullptr)
     , m_injectTouchInput(nullptr) {
+    for (int i = 0; i < MAX_TOUCH_CONTACTS; ++i) {
+        m_touches[i].x = 0;
+        m_touches[i].y = 0;
+        m_touches[i].id = i;
+        m_touches[i].isActive = false;
+        m_touches[i].releaseTask = 0;
+        memset(&m_touches[i].contact, 0, sizeof(POINTER_TOUCH_INFO));
+    }
 }
 
 TouchInjector::~TouchInjector() {
     ReleaseAllTouches();
-    if (m_user32Module) {
-        FreeLibrary(m_user32Module);
+    while (FlushFrame()) {
     }
 }
 
-bool TouchInjector::Initialize() {
+bool TouchInjector::Initialize(bool sendToSystem) {
     if (m_initialized) {
         return true;
     }
     
-    // Try to load touch injection functions (Windows 8+)
-    m_user32Module = LoadLibraryA("user32.dll");
+    if (!sendToSystem) {
+        m_injectTouchInput = DiscardTouchInput;
+        m_supported = true;
+        m_initialized = true;
+        return true;
+    }
+    
+    // Look up touch injection functions (Windows 8+); user32 is always loaded already
+    m_user32Module = GetModuleHandleA("user32.dll");
     if (m_user32Module) {
         m_initializeTouchInjection = reinterpret_cast<InitializeTouchInjectionFunc>(
             GetProcAddress(m_user32Module, "InitializeTouchInjection"));
@@ -45,7 +67,7 @@ bool TouchInjector::Initialize() {
         
         if (m_initializeTouchInjection && m_injectTouchInput) {
             // Initialize for up to 10 simultaneous touch points
-            if (m_initializeTouchInjection(10, TOUCH_FEEDBACK_NONE)) {
+            if (m_initializeTouchInjection(MAX_TOUCH_CONTACTS, TOUCH_FEEDBACK_NONE)) {
                 m_supported = true;
                 m_initialized = true;
                 std::cout << "Touch injection initialized successfully." << std::endl;
@@ -64,17 +86,25 @@ bool TouchInjector::Initialize() {
 }
 
 bool TouchInjector::TouchDown(int x, int y, int touchId) {
+    POINTER_TOUCH_INFO contactTemplate;
+    BuildContactTemplate(contactTemplate, x, y);
+    return TouchDown(contactTemplate, touchId);
+}
+
+bool TouchInjector::TouchDown(const POINTER_TOUCH_INFO& contactTemplate, int touchId) {
     if (!m_initialized) {
         return false;
     }
     
     // Validate touch ID range
-    if (touchId < 0 || touchId >= 10) {
+    if (touchId < 0 || touchId >= MAX_TOUCH_CONTACTS) {
         std::cerr << "Invalid touch ID: " << touchId << std::endl;
         return false;
     }
     
     // Validate coordinates are within screen bounds
+    int x = contactTemplate.pointerInfo.ptPixelLocation.x;
+    int y = contactTemplate.pointerInfo.ptPixelLocation.y;
     int screenWidth = GetSystemMetrics(SM_CXSCREEN);
     int screenHeight = GetSystemMetrics(SM_CYSCREEN);
     if (x < 0 || x > screenWidth || y < 0 || y > screenHeight) {
@@ -87,37 +117,20 @@ bool TouchInjector::TouchDown(int x, int y, int touchId) {
         return true;
     }
     
-    POINTER_TOUCH_INFO contact;
-    memset(&contact, 0, sizeof(POINTER_TOUCH_INFO));
-    
-    contact.pointerInfo.pointerType = PT_TOUCH;
-    contact.pointerInfo.pointerId = touchId;
-    contact.pointerInfo.ptPixelLocation.x = x;
-    contact.pointerInfo.ptPixelLocation.y = y;
-    contact.pointerInfo.pointerFlags = POINTER_FLAG_DOWN | POINTER_FLAG_INRANGE | POINTER_FLAG_INCONTACT;
-    
-    if (touchId == 0) {
-        contact.pointerInfo.pointerFlags |= POINTER_FLAG_PRIMARY;
+    // A tap still held on this ID is lifted first
+    TouchPoint& tp = m_touches[touchId];
+    if (tp.isActive && tp.releaseTask != 0) {
+        TouchUp(touchId);
     }
     
-    // Set contact area (small circle)
-    contact.rcContact.left = x - TOUCH_CONTACT_RADIUS;
-    contact.rcContact.right = x + TOUCH_CONTACT_RADIUS;
-    contact.rcContact.top = y - TOUCH_CONTACT_RADIUS;
-    contact.rcContact.bottom = y + TOUCH_CONTACT_RADIUS;
-    
-    contact.touchFlags = 0;
-    contact.touchMask = TOUCH_MASK_CONTACTAREA | TOUCH_MASK_ORIENTATION | TOUCH_MASK_PRESSURE;
-    contact.orientation = TOUCH_DEFAULT_ORIENTATION;
-    contact.pressure = TOUCH_DEFAULT_PRESSURE;
+    // The held contact starts as a copy of the template; later events only patch flags
+    tp.contact = contactTemplate;
+    SetContactFlags(tp.contact, touchId, POINTER_FLAG_DOWN | POINTER_FLAG_INRANGE | POINTER_FLAG_INCONTACT);
     
-    if (m_injectTouchInput(1, &contact)) {
-        TouchPoint tp;
+    if (Inject(tp.contact)) {
         tp.x = x;
         tp.y = y;
-        tp.id = touchId;
         tp.isActive = true;
-        m_activeTouches.push_back(tp);
         return true;
     }
     
@@ -129,27 +142,18 @@ bool TouchInjector::TouchUp(int touchId) {
         return false;
     }
     
-    // Find the touch point
-    auto it = m_activeTouches.begin();
-    while (it != m_activeTouches.end()) {
-        if (it->id == touchId) {
-            POINTER_TOUCH_INFO contact;
-            memset(&contact, 0, sizeof(POINTER_TOUCH_INFO));
-            
-            contact.pointerInfo.pointerType = PT_TOUCH;
-            contact.pointerInfo.pointerId = touchId;
-            contact.pointerInfo.ptPixelLocation.x = it->x;
-            contact.pointerInfo.ptPixelLocation.y = it->y;
-            contact.pointerInfo.pointerFlags = POINTER_FLAG_UP;
-            
-            bool result = m_injectTouchInput(1, &contact);
-            m_activeTouches.erase(it);
-            return result;
-        }
-        ++it;
+    if (touchId < 0 || touchId >= MAX_TOUCH_CONTACTS || !m_touches[touchId].isActive) {
+        return false;
     }
     
-    return false;
+    TouchPoint& tp = m_touches[touchId];
+    if (tp.releaseTask != 0) {
+        m_scheduler->Cancel(tp.releaseTask);
+        tp.releaseTask = 0;
+    }
+    SetContactFlags(tp.contact, touchId, POINTER_FLAG_UP);
+    tp.isActive = false;
+    return Inject(tp.contact);
 }
 
 bool TouchInjector::TouchUpdate(int touchId) {
@@ -157,56 +161,79 @@ bool TouchInjector::TouchUpdate(int touchId) {
         return false;
     }
     
-    // Find the active touch point
-    for (const auto& tp : m_activeTouches) {
-        if (tp.id == touchId && tp.isActive) {
-            POINTER_TOUCH_INFO contact;
-            memset(&contact, 0, sizeof(POINTER_TOUCH_INFO));
-            
-            contact.pointerInfo.pointerType = PT_TOUCH;
-            contact.pointerInfo.pointerId = touchId;
-            contact.pointerInfo.ptPixelLocation.x = tp.x;
-            contact.pointerInfo.ptPixelLocation.y = tp.y;
-            contact.pointerInfo.pointerFlags = POINTER_FLAG_UPDATE | POINTER_FLAG_INRANGE | POINTER_FLAG_INCONTACT;
-            
-            if (touchId == 0) {
-                contact.pointerInfo.pointerFlags |= POINTER_FLAG_PRIMARY;
-            }
-            
-            // Set contact area (small circle)
-            contact.rcContact.left = tp.x - TOUCH_CONTACT_RADIUS;
-            contact.rcContact.right = tp.x + TOUCH_CONTACT_RADIUS;
-            contact.rcContact.top = tp.y - TOUCH_CONTACT_RADIUS;
-            contact.rcContact.bottom = tp.y + TOUCH_CONTACT_RADIUS;
-            
-            contact.touchFlags = 0;
-            contact.touchMask = TOUCH_MASK_CONTACTAREA | TOUCH_MASK_ORIENTATION | TOUCH_MASK_PRESSURE;
-            contact.orientation = TOUCH_DEFAULT_ORIENTATION;
-            contact.pressure = TOUCH_DEFAULT_PRESSURE;
-            
-            return m_injectTouchInput(1, &contact);
-        }
+    if (touchId < 0 || touchId >= MAX_TOUCH_CONTACTS || !m_touches[touchId].isActive) {
+        return false;
     }
     
-    return false;
+    TouchPoint& tp = m_touches[touchId];
+    SetContactFlags(tp.contact, touchId, POINTER_FLAG_UPDATE | POINTER_FLAG_INRANGE | POINTER_FLAG_INCONTACT);
+    return Inject(tp.contact);
+}
+
+bool TouchInjector::TouchMove(int x, int y, int touchId) {
+    if (!m_initialized || !m_supported) {
+        return false;
+    }
+    
+    // Dragged contacts stop at the screen edge instead of failing
+    int screenWidth = GetSystemMetrics(SM_CXSCREEN);
+    int screenHeight = GetSystemMetrics(SM_CYSCREEN);
+    x = (x < 0) ? 0 : (x > screenWidth ? screenWidth : x);
+    y = (y < 0) ? 0 : (y > screenHeight ? screenHeight : y);
+    
+    if (touchId < 0 || touchId >= MAX_TOUCH_CONTACTS || !m_touches[touchId].isActive) {
+        return false;
+    }
+    
+    // Shift the contact area with the point so its shape is kept
+    TouchPoint& tp = m_touches[touchId];
+    int dx = x - tp.x;
+    int dy = y - tp.y;
+    tp.x = x;
+    tp.y = y;
+    tp.contact.pointerInfo.ptPixelLocation.x = x;
+    tp.contact.pointerInfo.ptPixelLocation.y = y;
+    tp.contact.rcContact.left += dx;
+    tp.contact.rcContact.right += dx;
+    tp.contact.rcContact.top += dy;
+    tp.contact.rcContact.bottom += dy;
+    
+    SetContactFlags(tp.contact, touchId, POINTER_FLAG_UPDATE | POINTER_FLAG_INRANGE | POINTER_FLAG_INCONTACT);
+    return Inject(tp.contact);
 }
 
 bool TouchInjector::TouchTap(int x, int y, int touchId) {
+    POINTER_TOUCH_INFO contactTemplate;
+    BuildContactTemplate(contactTemplate, x, y);
+    return TouchTap(contactTemplate, touchId);
+}
+
+bool TouchInjector::TouchTap(const POINTER_TOUCH_INFO& contactTemplate, int touchId) {
     if (!m_initialized) {
         return false;
     }
     
     if (!m_supported) {
-        return MouseSimulateTap(x, y);
+        return MouseSimulateTap(contactTemplate.pointerInfo.ptPixelLocation.x,
+                                contactTemplate.pointerInfo.ptPixelLocation.y);
     }
     
     // Touch down
-    if (!TouchDown(x, y, touchId)) {
+    if (!TouchDown(contactTemplate, touchId)) {
         return false;
     }
     
-    // Brief hold
-    Sleep(TOUCH_HOLD_DURATION_MS);
+    // Brief hold (when batching, the up goes out one frame after the down instead)
+    if (!m_frameBatching) {
+        if (m_scheduler != nullptr) {
+            int64_t releaseTime = m_scheduler->Now() + TOUCH_HOLD_DURATION_MS * 1000;
+            m_touches[touchId].releaseTask = m_scheduler->Schedule(releaseTime, ReleaseTaskProc, this, touchId, false);
+            if (m_touches[touchId].releaseTask != 0) {
+                return true;
+            }
+        }
+        Sleep(TOUCH_HOLD_DURATION_MS);
+    }
     
     // Touch up
     return TouchUp(touchId);
@@ -217,8 +244,10 @@ void TouchInjector::ReleaseAllTouches() {
         return;
     }
     
-    while (!m_activeTouches.empty()) {
-        TouchUp(m_activeTouches[0].id);
+    for (int touchId = 0; touchId < MAX_TOUCH_CONTACTS; ++touchId) {
+        if (m_touches[touchId].isActive) {
+            TouchUp(touchId);
+        }
     }
 }
 
@@ -226,32 +255,239 @@ bool TouchInjector::IsSupported() const {
     return m_supported;
 }
 
-bool TouchInjector::MouseSimulateTap(int x, int y) {
-    // Get current cursor position
-    POINT originalPos;
-    GetCursorPos(&originalPos);
+bool TouchInjector::IsTouchActive(int touchId) const {
+    return touchId >= 0 && touchId < MAX_TOUCH_CONTACTS && m_touches[touchId].isActive;
+}
+
+uint64_t TouchInjector::GetContactCount() const {
+    return m_contactCount;
+}
+
+void TouchInjector::SetFrameBatching(bool enabled) {
+    m_frameBatching = enabled;
     
-    // Move to target position
-    SetCursorPos(x, y);
-    Sleep(10);
+    // Nothing may stay queued once batching is off
+    if (!enabled) {
+        while (FlushFrame()) {
+        }
+    }
+}
+
+bool TouchInjector::IsFrameBatching() const {
+    return m_frameBatching;
+}
+
+bool TouchInjector::FlushFrame() {
+    if (m_frameCount == 0) {
+        return false;
+    }
     
-    // Simulate mouse click
-    INPUT input[2];
+    TouchFrame& frame = m_frames[m_frameHead];
+    int64_t traceBegin = Tracer::Begin();
+    if (traceBegin != 0 && frame.queuedAt != 0) {
+        Tracer::Record(TRACE_FRAME_QUEUED, frame.queuedAt, traceBegin, static_cast<int>(frame.count));
+    }
+    bool result = m_injectTouchInput(frame.count, frame.contacts) != FALSE;
+    Tracer::End(TRACE_INJECT_TOUCH, traceBegin, static_cast<int>(frame.count));
+    if (!result) {
+        std::cerr << "Failed to inject touch frame. Error: " << GetLastError() << std::endl;
+    }
+    
+    m_frameHead = (m_frameHead + 1) % MAX_PENDING_TOUCH_FRAMES;
+    --m_frameCount;
+    return true;
+}
+
+bool TouchInjector::HasPendingFrames() const {
+    return m_frameCount > 0;
+}
+
+void TouchInjector::SetEventStream(EventStream* stream) {
+    m_eventStream = stream;
+}
+
+void TouchInjector::SetScheduler(Scheduler* scheduler) {
+    // Pending holds and restores belong to the old scheduler: finish them now
+    for (int touchId = 0; touchId < MAX_TOUCH_CONTACTS; ++touchId) {
+        if (m_touches[touchId].releaseTask != 0) {
+            TouchUp(touchId);
+        }
+    }
+    if (m_cursorRestoreTask != 0) {
+        m_scheduler->Cancel(m_cursorRestoreTask);
+        m_cursorRestoreTask = 0;
+        SetCursorPos(m_cursorRestorePos.x, m_cursorRestorePos.y);
+    }
+    m_scheduler = scheduler;
+}
+
+BOOL WINAPI TouchInjector::DiscardTouchInput(UINT32 count, const void* contacts) {
+    return TRUE;
+}
+
+void TouchInjector::ReleaseTaskProc(void* context, int touchId) {
+    TouchInjector* injector = static_cast<TouchInjector*>(context);
+    injector->m_touches[touchId].releaseTask = 0;
+    injector->TouchUp(touchId);
+}
+
+void TouchInjector::CursorRestoreTaskProc(void* context, int param) {
+    TouchInjector* injector = static_cast<TouchInjector*>(context);
+    injector->m_cursorRestoreTask = 0;
+    SetCursorPos(injector->m_cursorRestorePos.x, injector->m_cursorRestorePos.y);
+}
+
+bool TouchInjector::Inject(const POINTER_TOUCH_INFO& contact) {
+    ++m_contactCount;
+    if (m_eventStream != nullptr) {
+        const DWORD flags = contact.pointerInfo.pointerFlags;
+        EventRecordType type = (flags & POINTER_FLAG_DOWN) ? EVENT_TOUCH_DOWN :
+                               (flags & POINTER_FLAG_UP) ? EVENT_TOUCH_UP : EVENT_TOUCH_UPDATE;
+        m_eventStream->Write(type, contact.pointerInfo.pointerId, 0,
+                             contact.pointerInfo.ptPixelLocation.x, contact.pointerInfo.ptPixelLocation.y);
+    }
+    
+    if (!m_frameBatching) {
+        int64_t traceBegin = Tracer::Begin();
+        bool result = m_injectTouchInput(1, &contact) != FALSE;
+        Tracer::End(TRACE_INJECT_TOUCH, traceBegin, 1);
+        return result;
+    }
+    
+    QueueContact(contact);
+    return true;
+}
+
+void TouchInjector::QueueContact(const POINTER_TOUCH_INFO& contact) {
+    TraceScope trace(TRACE_FRAME_BUILD, static_cast<int>(contact.pointerInfo.pointerId));
+    const DWORD flags = contact.pointerInfo.pointerFlags;
+    
+    if (m_frameCount > 0) {
+        TouchFrame& frame = m_frames[(m_frameHead + m_frameCount - 1) % MAX_PENDING_TOUCH_FRAMES];
+        
+        UINT32 i = 0;
+        while (i < frame.count && frame.contacts[i].pointerInfo.pointerId != contact.pointerInfo.pointerId) {
+            ++i;
+        }
+        
+        if (i == frame.count && frame.count < MAX_TOUCH_CONTACTS) {
+            frame.contacts[frame.count++] = contact;
+            return;
+        }
+        
+        if (i < frame.count) {
+            POINTER_TOUCH_INFO& pending = frame.contacts[i];
+            const DWORD pendingFlags = pending.pointerInfo.pointerFlags;
+            
+            // A newer position replaces a pending down or update (the down keeps its flags)
+            if ((flags & POINTER_FLAG_UPDATE) && !(pendingFlags & POINTER_FLAG_UP)) {
+                DWORD keepFlags = pendingFlags;
+                pending = contact;
+                pending.pointerInfo.pointerFlags = keepFlags;
+                return;
+            }
+            
+            // A lift replaces a pending update; a pending down must be seen first
+            if ((flags & POINTER_FLAG_UP) && (pendingFlags & POINTER_FLAG_UPDATE)) {
+                pending = contact;
+                return;
+            }
+        }
+    }
+    
+    // Start a new frame; with too many waiting, the oldest goes out now
+    if (m_frameCount == MAX_PENDING_TOUCH_FRAMES) {
+        FlushFrame();
+    }
+    
+    TouchFrame& frame = m_frames[(m_frameHead + m_frameCount) % MAX_PENDING_TOUCH_FRAMES];
+    frame.contacts[0] = contact;
+    frame.count = 1;
+    frame.queuedAt = Tracer::Begin();
+    ++m_frameCount;
+}
+
+void TouchInjector::BuildContact(POINTER_TOUCH_INFO& contact, int x, int y, int touchId, DWORD pointerFlags) {
+    BuildContactTemplate(contact, x, y);
+    SetContactFlags(contact, touchId, pointerFlags);
+}
+
+void TouchInjector::BuildContactTemplate(POINTER_TOUCH_INFO& contact, int x, int y,
+                                         int radius, int pressure, int orientation) {
+    memset(&contact, 0, sizeof(POINTER_TOUCH_INFO));
+    
+    if (radius <= 0) radius = TOUCH_CONTACT_RADIUS;
+    if (pressure <= 0) pressure = TOUCH_DEFAULT_PRESSURE;
+    if (orientation < 0) orientation = TOUCH_DEFAULT_ORIENTATION;
+    
+    contact.pointerInfo.pointerType = PT_TOUCH;
+    contact.pointerInfo.ptPixelLocation.x = x;
+    contact.pointerInfo.ptPixelLocation.y = y;
+    
+    // Contact area: a square around the point
+    contact.rcContact.left = x - radius;
+    contact.rcContact.right = x + radius;
+    contact.rcContact.top = y - radius;
+    contact.rcContact.bottom = y + radius;
+    
+    contact.touchFlags = 0;
+    contact.touchMask = TOUCH_MASK_CONTACTAREA | TOUCH_MASK_ORIENTATION | TOUCH_MASK_PRESSURE;
+    contact.orientation = orientation;
+    contact.pressure = pressure;
+}
+
+void TouchInjector::SetContactFlags(POINTER_TOUCH_INFO& contact, int touchId, DWORD pointerFlags) {
+    contact.pointerInfo.pointerId = touchId;
+    contact.pointerInfo.pointerFlags = pointerFlags;
+    if (touchId == 0) {
+        contact.pointerInfo.pointerFlags |= POINTER_FLAG_PRIMARY;
+    }
+}
+
+bool TouchInjector::MouseSimulateTap(int x, int y) {
+    // Remember where the cursor was, unless an earlier click's restore is still pending
+    POINT cursorPos;
+    GetCursorPos(&cursorPos);
+    if (m_cursorRestoreTask == 0) {
+        m_cursorRestorePos = cursorPos;
+    }
+    
+    // Move, press and release in one batch; the input queue keeps them in order
+    // (absolute coordinates are normalized to 0..65535 across the primary screen)
+    int screenWidth = GetSystemMetrics(SM_CXSCREEN);
+    int screenHeight = GetSystemMetrics(SM_CYSCREEN);
+    INPUT input[3];
     memset(input, 0, sizeof(input));
     
-    // Mouse down
+    // Move to target position
     input[0].type = INPUT_MOUSE;
-    input[0].mi.dwFlags = MOUSEEVENTF_LEFTDOWN;
+    input[0].mi.dx = (screenWidth > 1) ? MulDiv(x, 65535, screenWidth - 1) : 0;
+    input[0].mi.dy = (screenHeight > 1) ? MulDiv(y, 65535, screenHeight - 1) : 0;
+    input[0].mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
     
-    // Mouse up
+    // Mouse down
     input[1].type = INPUT_MOUSE;
-    input[1].mi.dwFlags = MOUSEEVENTF_LEFTUP;
+    input[1].mi.dwFlags = MOUSEEVENTF_LEFTDOWN;
     
-    SendInput(2, input, sizeof(INPUT));
+    // Mouse up
+    input[2].type = INPUT_MOUSE;
+    input[2].mi.dwFlags = MOUSEEVENTF_LEFTUP;
     
-    // Restore cursor position
-    Sleep(50);
-    SetCursorPos(originalPos.x, originalPos.y);
+    SendInput(3, input, sizeof(INPUT));
+    
+    // Restore cursor position once the target has seen the click
+    if (m_scheduler != nullptr) {
+        if (m_cursorRestoreTask != 0) {
+            m_scheduler->Cancel(m_cursorRestoreTask);
+        }
+        m_cursorRestoreTask = m_scheduler->Schedule(m_scheduler->Now() + CURSOR_RESTORE_DELAY_MS * 1000,
+                                                    CursorRestoreTaskProc, this, 0, false);
+        if (m_cursorRestoreTask != 0) {
+            return true;
+        }
+    }
+    Sleep(CURSOR_RESTORE_DELAY_MS);
+    SetCursorPos(m_cursorRestorePos.x, m_cursorRestorePos.y);
     
     return true;
 }
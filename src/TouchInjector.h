@@ -2,7 +2,7 @@
 #define TOUCH_INJECTOR_H
 
 #include <windows.h>
-#include <vector>
+#include <cstdint>
 
 // Touch input structures (compatible with Windows 7+)
 #ifndef POINTER_FLAG_DOWN
@@ -20,11 +20,27 @@
 #define TOUCH_FEEDBACK_NONE         0x3
 #endif
 
+// Most contacts one injection call (frame) can carry
+#define MAX_TOUCH_CONTACTS 10
+
+// Frames that can wait for a flush before the oldest is injected right away
+#define MAX_PENDING_TOUCH_FRAMES 4
+
+// Contact shape used where a mapping does not set its own
+#define TOUCH_CONTACT_RADIUS      2
+#define TOUCH_DEFAULT_PRESSURE    32000
+#define TOUCH_DEFAULT_ORIENTATION 90
+
+class EventStream;
+class Scheduler;
+
 struct TouchPoint {
     int x;
     int y;
     int id;
     bool isActive;
+    int releaseTask;  // Scheduled lift of a tap (0 if none)
+    POINTER_TOUCH_INFO contact;  // Record sent for this contact (flags patched per event)
 };
 
 class TouchInjector {
@@ -32,31 +48,94 @@ public:
     TouchInjector();
     ~TouchInjector();
     
-    // Initialize touch injection
-    bool Initialize();
+    // Initialize touch injection. Without sending to the system (simulated runs)
+    // contacts take the same path, frames and event stream included, and are
+    // then dropped instead of injected.
+    bool Initialize(bool sendToSystem = true);
     
     // Inject a touch down event
     bool TouchDown(int x, int y, int touchId = 0);
     
+    // Inject a touch down from a prebuilt contact (see BuildContactTemplate);
+    // the contact is copied and only its ID and flags are filled in
+    bool TouchDown(const POINTER_TOUCH_INFO& contactTemplate, int touchId);
+    
     // Inject a touch up event
     bool TouchUp(int touchId = 0);
     
     // Inject a touch update event (maintains active touch)
     bool TouchUpdate(int touchId = 0);
     
-    // Inject a complete touch (down, brief hold, up)
+    // Move an active touch to a new position (clamped to the screen)
+    bool TouchMove(int x, int y, int touchId = 0);
+    
+    // Inject a complete touch (down, brief hold, up). With a scheduler the up
+    // is a scheduled task and this returns right away; without one it blocks.
     bool TouchTap(int x, int y, int touchId = 0);
+    bool TouchTap(const POINTER_TOUCH_INFO& contactTemplate, int touchId);
     
     // Release all active touches
     void ReleaseAllTouches();
     
     // Check if touch injection is supported
     bool IsSupported() const;
+    
+    // Check if a touch ID's contact is down
+    bool IsTouchActive(int touchId) const;
+    
+    // Contact changes sent (or queued into frames) since startup
+    uint64_t GetContactCount() const;
+    
+    // Queue touch changes into frames instead of injecting them immediately
+    void SetFrameBatching(bool enabled);
+    bool IsFrameBatching() const;
+    
+    // Inject the oldest queued frame (all its contacts in one call)
+    bool FlushFrame();
+    
+    // Check if queued frames are waiting for a flush
+    bool HasPendingFrames() const;
+    
+    // Report every contact change to an event stream (null to stop)
+    void SetEventStream(EventStream* stream);
+    
+    // Time tap holds and cursor restores on a scheduler instead of sleeping (null to stop)
+    void SetScheduler(Scheduler* scheduler);
+    
+    // Fill a touch contact record for the given position and pointer flags
+    static void BuildContact(POINTER_TOUCH_INFO& contact, int x, int y, int touchId, DWORD pointerFlags);
+    
+    // Fill everything but the pointer ID and flags (done once per mapping).
+    // Radius (pixels) and pressure fall back to the defaults when 0,
+    // orientation (degrees) when negative.
+    static void BuildContactTemplate(POINTER_TOUCH_INFO& contact, int x, int y,
+                                     int radius = 0, int pressure = 0, int orientation = -1);
 
 private:
     bool m_initialized;
     bool m_supported;
-    std::vector<TouchPoint> m_activeTouches;
+    
+    // Contact state indexed by touch ID (isActive marks the held ones)
+    TouchPoint m_touches[MAX_TOUCH_CONTACTS];
+    
+    // Queued frames (ring buffer) while frame batching is on
+    struct TouchFrame {
+        POINTER_TOUCH_INFO contacts[MAX_TOUCH_CONTACTS];
+        UINT32 count;
+        int64_t queuedAt;  // Trace counter when the frame was started (0 while not tracing)
+    };
+    TouchFrame m_frames[MAX_PENDING_TOUCH_FRAMES];
+    int m_frameHead;
+    int m_frameCount;
+    bool m_frameBatching;
+    
+    EventStream* m_eventStream;
+    Scheduler* m_scheduler;
+    uint64_t m_contactCount;
+    
+    // Cursor position to put back after a simulated click, and the pending restore task
+    POINT m_cursorRestorePos;
+    int m_cursorRestoreTask;
     
     // Function pointers for Windows Touch API
     typedef BOOL (WINAPI *InitializeTouchInjectionFunc)(UINT32, DWORD);
@@ -66,8 +145,24 @@ private:
     InitializeTouchInjectionFunc m_initializeTouchInjection;
     InjectTouchInputFunc m_injectTouchInput;
     
+    // Set the pointer ID and flags of a contact (primary for touch 0)
+    static void SetContactFlags(POINTER_TOUCH_INFO& contact, int touchId, DWORD pointerFlags);
+    
+    // Inject a contact now, or queue it when frame batching is on
+    bool Inject(const POINTER_TOUCH_INFO& contact);
+    
+    // Add a contact to the newest frame, merging it with that pointer's pending change
+    void QueueContact(const POINTER_TOUCH_INFO& contact);
+    
     // Fallback to mouse simulation if touch not supported
     bool MouseSimulateTap(int x, int y);
+    
+    // Stands in for InjectTouchInput when not sending to the system
+    static BOOL WINAPI DiscardTouchInput(UINT32 count, const void* contacts);
+    
+    // Scheduled end of a tap hold / simulated click
+    static void ReleaseTaskProc(void* context, int touchId);
+    static void CursorRestoreTaskProc(void* context, int param);
 };
 
 #endif // TOUCH_INJECTOR_H
@@ -0,0 +1,162 @@
+#include "Tracer.h"
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+std::atomic<bool> Tracer::s_enabled(false);
+std::atomic<int> Tracer::s_ringCount(0);
+std::atomic<uint64_t> Tracer::s_dropped(0);
+TraceRing Tracer::s_rings[TRACE_MAX_THREADS];
+
+// Ring of the current thread (claimed on first use)
+static thread_local TraceRing* t_ring = nullptr;
+
+// Span names and the name of their argument (null: no argument) as shown in the viewer
+static const char* const s_spanNames[TRACE_SPAN_TYPE_COUNT] = {
+    "hook callback", "mapping resolve", "frame build", "frame queued",
+    "InjectTouchInput", "overlay paint", "config save", "plugin action"
+};
+static const char* const s_spanArgNames[TRACE_SPAN_TYPE_COUNT] = {
+    "vk", "vk", "pointer", "contacts", "contacts", nullptr, nullptr, "action"
+};
+
+void Tracer::SetEnabled(bool enabled) {
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+int64_t Tracer::Now() {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+TraceRing* Tracer::GetThreadRing() {
+    if (t_ring != nullptr) {
+        return t_ring;
+    }
+    
+    int index = s_ringCount.fetch_add(1, std::memory_order_relaxed);
+    if (index >= TRACE_MAX_THREADS) {
+        s_ringCount.store(TRACE_MAX_THREADS, std::memory_order_relaxed);
+        return nullptr;
+    }
+    
+    t_ring = &s_rings[index];
+    t_ring->threadId = GetCurrentThreadId();
+    return t_ring;
+}
+
+void Tracer::Record(TraceSpanType type, int64_t begin, int64_t end, int arg) {
+    TraceRing* ring = GetThreadRing();
+    if (ring == nullptr) {
+        s_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    
+    // Single writer: a plain load and a release store publish the span
+    uint64_t written = ring->written.load(std::memory_order_relaxed);
+    TraceSpan& span = ring->spans[written & (TRACE_RING_CAPACITY - 1)];
+    span.begin = begin;
+    span.end = end;
+    span.type = type;
+    span.arg = arg;
+    ring->written.store(written + 1, std::memory_order_release);
+}
+
+uint64_t Tracer::GetSpanCount() {
+    uint64_t count = 0;
+    int rings = s_ringCount.load(std::memory_order_relaxed);
+    for (int i = 0; i < rings && i < TRACE_MAX_THREADS; ++i) {
+        count += s_rings[i].written.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+uint64_t Tracer::GetDroppedCount() {
+    return s_dropped.load(std::memory_order_relaxed);
+}
+
+bool Tracer::WriteChromeTrace(const std::string& path) {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double ticksToUs = 1000000.0 / static_cast<double>(frequency.QuadPart);
+    
+    // Copy each ring first, then keep only the spans the writer cannot have
+    // overwritten during the copy (the slot after the newest may be in progress)
+    std::vector<TraceSpan> spans;
+    std::vector<DWORD> threadIds;
+    std::vector<size_t> threadStarts;
+    int64_t origin = 0;
+    int rings = s_ringCount.load(std::memory_order_relaxed);
+    for (int i = 0; i < rings && i < TRACE_MAX_THREADS; ++i) {
+        const TraceRing& ring = s_rings[i];
+        uint64_t end = ring.written.load(std::memory_order_acquire);
+        uint64_t first = (end > TRACE_RING_CAPACITY) ? end - TRACE_RING_CAPACITY : 0;
+        
+        size_t start = spans.size();
+        for (uint64_t n = first; n < end; ++n) {
+            spans.push_back(ring.spans[n & (TRACE_RING_CAPACITY - 1)]);
+        }
+        
+        uint64_t now = ring.written.load(std::memory_order_acquire);
+        uint64_t valid = (now + 1 > TRACE_RING_CAPACITY) ? now + 1 - TRACE_RING_CAPACITY : 0;
+        if (valid > first) {
+            size_t stale = static_cast<size_t>(valid - first);
+            if (stale > spans.size() - start) {
+                stale = spans.size() - start;
+            }
+            spans.erase(spans.begin() + start, spans.begin() + start + stale);
+        }
+        
+        threadIds.push_back(ring.threadId);
+        threadStarts.push_back(start);
+        for (size_t n = start; n < spans.size(); ++n) {
+            if (origin == 0 || spans[n].begin < origin) {
+                origin = spans[n].begin;
+            }
+        }
+    }
+    threadStarts.push_back(spans.size());
+    
+    // Write to a temporary file and swap it in, like the usage snapshot
+    std::string tempPath = path + ".tmp";
+    std::ofstream file(tempPath);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open trace file for writing: " << tempPath << std::endl;
+        return false;
+    }
+    
+    DWORD processId = GetCurrentProcessId();
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << std::endl;
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << processId
+         << ",\"args\":{\"name\":\"KeyboardMouseMap\"}}";
+    file << std::fixed << std::setprecision(3);
+    for (size_t t = 0; t < threadIds.size(); ++t) {
+        file << "," << std::endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << processId
+             << ",\"tid\":" << threadIds[t] << ",\"args\":{\"name\":\"thread " << t << "\"}}";
+        
+        for (size_t n = threadStarts[t]; n < threadStarts[t + 1]; ++n) {
+            const TraceSpan& span = spans[n];
+            if (span.type < 0 || span.type >= TRACE_SPAN_TYPE_COUNT) continue;
+            
+            file << "," << std::endl << "{\"name\":\"" << s_spanNames[span.type] << "\",\"cat\":\"input\",\"ph\":\"X\""
+                 << ",\"ts\":" << (span.begin - origin) * ticksToUs
+                 << ",\"dur\":" << (span.end - span.begin) * ticksToUs
+                 << ",\"pid\":" << processId << ",\"tid\":" << threadIds[t];
+            if (s_spanArgNames[span.type] != nullptr) {
+                file << ",\"args\":{\"" << s_spanArgNames[span.type] << "\":" << span.arg << "}";
+            }
+            file << "}";
+        }
+    }
+    file << std::endl << "]}" << std::endl;
+    file.close();
+    
+    if (!MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        std::cerr << "Failed to write trace file: " << path << ". Error: " << GetLastError() << std::endl;
+        return false;
+    }
+    std::cout << "Wrote " << spans.size() << " trace spans to " << path << std::endl;
+    return true;
+}
@@ -0,0 +1,115 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Spans kept per thread (power of two); the oldest are overwritten
+#define TRACE_RING_CAPACITY 8192
+
+// Threads that can record spans (spans of further threads are dropped)
+#define TRACE_MAX_THREADS 8
+
+// Traced stages of the input pipeline
+enum TraceSpanType {
+    TRACE_HOOK_CALLBACK,    // Keyboard hook callback (dispatched events only; arg: virtual key)
+    TRACE_MAPPING_RESOLVE,  // Key to mapping lookup (arg: virtual key)
+    TRACE_FRAME_BUILD,      // Contact merged into a queued touch frame (arg: pointer ID)
+    TRACE_FRAME_QUEUED,     // Touch frame waiting for its flush (arg: contacts)
+    TRACE_INJECT_TOUCH,     // InjectTouchInput call (arg: contacts)
+    TRACE_OVERLAY_PAINT,    // Overlay repaint
+    TRACE_CONFIG_SAVE,      // Config file write
+    TRACE_PLUGIN_ACTION,    // Plugin action handler (arg: action index)
+    TRACE_SPAN_TYPE_COUNT
+};
+
+// One finished span; times are performance counter ticks
+struct TraceSpan {
+    int64_t begin;
+    int64_t end;
+    int32_t type;  // TraceSpanType
+    int32_t arg;
+};
+
+// Spans of one thread. Only that thread writes; a reader copies the spans
+// and then drops the ones the writer may have overwritten meanwhile.
+struct TraceRing {
+    TraceSpan spans[TRACE_RING_CAPACITY];
+    std::atomic<uint64_t> written;  // Spans ever written (the next goes to written % capacity)
+    DWORD threadId;
+};
+
+// Records begin/end spans of the input pipeline for a trace viewer
+// (chrome://tracing or Perfetto), to see why a single event was slow.
+// Tracing is off unless enabled, and then a span costs one flag load. While
+// on, a span is two counter reads and one store into the recording thread's
+// own ring: no lock, no allocation. Spans measure real cost, so they use the
+// performance counter even where the rest of the core runs on a simulated clock.
+class Tracer {
+public:
+    // Start or stop recording (the recorded spans are kept)
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled() {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+    
+    // Start of a span: the current counter, or 0 while tracing is off
+    static int64_t Begin() {
+        return IsEnabled() ? Now() : 0;
+    }
+    
+    // Record a span that started at Begin() (nothing for a 0 start)
+    static void End(TraceSpanType type, int64_t begin, int arg = 0) {
+        if (begin != 0) {
+            Record(type, begin, Now(), arg);
+        }
+    }
+    
+    // Record a span with both ends known
+    static void Record(TraceSpanType type, int64_t begin, int64_t end, int arg);
+    
+    // Current performance counter value
+    static int64_t Now();
+    
+    // Write the spans of every thread as Chrome trace JSON (the rings keep them)
+    static bool WriteChromeTrace(const std::string& path);
+    
+    // Spans recorded since startup, and spans of threads that got no ring
+    static uint64_t GetSpanCount();
+    static uint64_t GetDroppedCount();
+
+private:
+    static std::atomic<bool> s_enabled;
+    static std::atomic<int> s_ringCount;
+    static std::atomic<uint64_t> s_dropped;
+    static TraceRing s_rings[TRACE_MAX_THREADS];
+    
+    // Ring of the calling thread, claimed on its first span (null once all are taken)
+    static TraceRing* GetThreadRing();
+};
+
+// Traces the enclosing scope as one span
+class TraceScope {
+public:
+    explicit TraceScope(TraceSpanType type, int arg = 0)
+        : m_type(type)
+        , m_arg(arg)
+        , m_begin(Tracer::Begin()) {
+    }
+    
+    ~TraceScope() {
+        Tracer::End(m_type, m_begin, m_arg);
+    }
+
+private:
+    TraceSpanType m_type;
+    int m_arg;
+    int64_t m_begin;
+    
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#endif // TRACER_H
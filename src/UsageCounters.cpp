@@ -0,0 +1,98 @@
+#include "UsageCounters.h"
+#include "ConfigManager.h"
+#include <fstream>
+#include <iostream>
+
+UsageCounters::UsageCounters() {
+    Reset();
+}
+
+UsageCounters::~UsageCounters() {
+}
+
+void UsageCounters::RecordPress(int virtualKey, int64_t nowUs) {
+    UsageSlot& slot = m_slots[virtualKey & 0xFF];
+    slot.presses.fetch_add(1, std::memory_order_relaxed);
+    slot.downUs = nowUs;
+    slot.held = true;
+}
+
+void UsageCounters::RecordRelease(int virtualKey, int64_t nowUs) {
+    UsageSlot& slot = m_slots[virtualKey & 0xFF];
+    if (!slot.held) {
+        return;
+    }
+    
+    int64_t heldUs = nowUs - slot.downUs;
+    slot.held = false;
+    
+    // Single writer: plain load/store instead of a compare-exchange loop
+    slot.totalHoldUs.fetch_add(heldUs, std::memory_order_relaxed);
+    if (heldUs > slot.maxHoldUs.load(std::memory_order_relaxed)) {
+        slot.maxHoldUs.store(heldUs, std::memory_order_relaxed);
+    }
+}
+
+uint64_t UsageCounters::GetPresses(int virtualKey) const {
+    return m_slots[virtualKey & 0xFF].presses.load(std::memory_order_relaxed);
+}
+
+int64_t UsageCounters::GetTotalHoldUs(int virtualKey) const {
+    return m_slots[virtualKey & 0xFF].totalHoldUs.load(std::memory_order_relaxed);
+}
+
+int64_t UsageCounters::GetMaxHoldUs(int virtualKey) const {
+    return m_slots[virtualKey & 0xFF].maxHoldUs.load(std::memory_order_relaxed);
+}
+
+uint64_t UsageCounters::GetMaxPresses() const {
+    uint64_t maxPresses = 0;
+    for (int virtualKey = 0; virtualKey < 256; ++virtualKey) {
+        uint64_t presses = GetPresses(virtualKey);
+        if (presses > maxPresses) {
+            maxPresses = presses;
+        }
+    }
+    return maxPresses;
+}
+
+bool UsageCounters::WriteSnapshot(const std::string& path, const KeyMapping* const* mappings) const {
+    // Write to a temporary file and swap it in, so readers never see half a snapshot
+    std::string tempPath = path + ".tmp";
+    std::ofstream file(tempPath);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open usage snapshot for writing: " << tempPath << std::endl;
+        return false;
+    }
+    
+    file << "# Key usage snapshot" << std::endl;
+    file << "# Format: VirtualKeyCode Presses TotalHoldMs MaxHoldMs KeyName" << std::endl;
+    for (int virtualKey = 0; virtualKey < 256; ++virtualKey) {
+        uint64_t presses = GetPresses(virtualKey);
+        if (presses == 0) continue;
+        
+        file << virtualKey << " " << presses << " "
+             << GetTotalHoldUs(virtualKey) / 1000 << " " << GetMaxHoldUs(virtualKey) / 1000;
+        if (mappings != nullptr && mappings[virtualKey] != nullptr) {
+            file << " " << mappings[virtualKey]->keyName;
+        }
+        file << std::endl;
+    }
+    file.close();
+    
+    if (!MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        std::cerr << "Failed to write usage snapshot: " << path << ". Error: " << GetLastError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void UsageCounters::Reset() {
+    for (UsageSlot& slot : m_slots) {
+        slot.presses.store(0, std::memory_order_relaxed);
+        slot.totalHoldUs.store(0, std::memory_order_relaxed);
+        slot.maxHoldUs.store(0, std::memory_order_relaxed);
+        slot.downUs = 0;
+        slot.held = false;
+    }
+}
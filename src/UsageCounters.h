@@ -0,0 +1,54 @@
+#ifndef USAGE_COUNTERS_H
+#define USAGE_COUNTERS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+struct KeyMapping;
+
+// Usage of one mapped key. Each slot has its own cache line, so updating
+// one key never contends with readers of another. The counters are relaxed
+// atomics: the input path only does uncontended adds and stores, and readers
+// (the overlay, snapshots) may see one counter a press ahead of another.
+struct alignas(64) UsageSlot {
+    std::atomic<uint64_t> presses;
+    std::atomic<int64_t> totalHoldUs;
+    std::atomic<int64_t> maxHoldUs;
+    int64_t downUs;  // Input path only: time of the press being held
+    bool held;
+};
+
+// Press count and hold times of every mapped key (indexed by virtual key),
+// for tuning layouts from real play
+class UsageCounters {
+public:
+    UsageCounters();
+    ~UsageCounters();
+    
+    // A mapped key fired (touch down or turbo start)
+    void RecordPress(int virtualKey, int64_t nowUs);
+    
+    // The key of a recorded press was released (ignored without a press)
+    void RecordRelease(int virtualKey, int64_t nowUs);
+    
+    // Counters of one key
+    uint64_t GetPresses(int virtualKey) const;
+    int64_t GetTotalHoldUs(int virtualKey) const;
+    int64_t GetMaxHoldUs(int virtualKey) const;
+    
+    // Highest press count of any key (for scaling the heatmap)
+    uint64_t GetMaxPresses() const;
+    
+    // Write every used key as "VK Presses TotalHoldMs MaxHoldMs KeyName" lines
+    // (names from the resolved mapping table, may be null)
+    bool WriteSnapshot(const std::string& path, const KeyMapping* const* mappings) const;
+    
+    // Zero all counters
+    void Reset();
+
+private:
+    UsageSlot m_slots[256];
+};
+
+#endif // USAGE_COUNTERS_H
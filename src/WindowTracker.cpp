@@ -0,0 +1,145 @@
+#include "WindowTracker.h"
+#include <iostream>
+
+#ifndef WINEVENT_OUTOFCONTEXT
+#define WINEVENT_OUTOFCONTEXT 0x0000
+#endif
+
+WindowTracker* WindowTracker::s_instance = nullptr;
+
+WindowTracker::WindowTracker()
+    : m_hwnd(nullptr)
+    , m_locationHook(nullptr)
+    , m_destroyHook(nullptr)
+    , m_handler(nullptr)
+    , m_handlerContext(nullptr) {
+    SetRectEmpty(&m_client);
+    s_instance = this;
+}
+
+WindowTracker::~WindowTracker() {
+    Detach();
+    s_instance = nullptr;
+}
+
+bool WindowTracker::Attach(const std::string& titlePart) {
+    Detach();
+    if (titlePart.empty()) {
+        return false;
+    }
+    m_titlePart = titlePart;
+    
+    EnumWindows(FindWindowProc, reinterpret_cast<LPARAM>(this));
+    if (m_hwnd == nullptr) {
+        return false;
+    }
+    
+    // Out of context: events are queued to this thread's message loop, and only
+    // the target's process is watched. Moves and resizes both end up as
+    // location changes of the window object.
+    DWORD processId = 0;
+    GetWindowThreadProcessId(m_hwnd, &processId);
+    m_locationHook = SetWinEventHook(EVENT_OBJECT_LOCATIONCHANGE, EVENT_OBJECT_LOCATIONCHANGE, nullptr,
+                                     WinEventProc, processId, 0, WINEVENT_OUTOFCONTEXT);
+    m_destroyHook = SetWinEventHook(EVENT_OBJECT_DESTROY, EVENT_OBJECT_DESTROY, nullptr,
+                                    WinEventProc, processId, 0, WINEVENT_OUTOFCONTEXT);
+    if (m_locationHook == nullptr || m_destroyHook == nullptr) {
+        std::cerr << "Failed to watch the target window. Error: " << GetLastError() << std::endl;
+    }
+    
+    Refresh(true);
+    return true;
+}
+
+void WindowTracker::Detach() {
+    if (m_locationHook != nullptr) {
+        UnhookWinEvent(m_locationHook);
+        m_locationHook = nullptr;
+    }
+    if (m_destroyHook != nullptr) {
+        UnhookWinEvent(m_destroyHook);
+        m_destroyHook = nullptr;
+    }
+    m_hwnd = nullptr;
+    m_titlePart.clear();
+}
+
+bool WindowTracker::IsAttached() const {
+    return m_hwnd != nullptr;
+}
+
+const std::string& WindowTracker::GetTitlePart() const {
+    return m_titlePart;
+}
+
+const RECT& WindowTracker::GetClientArea() const {
+    return m_client;
+}
+
+void WindowTracker::Refresh(bool force) {
+    RECT client;
+    if (m_hwnd == nullptr || IsIconic(m_hwnd) || !GetClientRect(m_hwnd, &client) || IsRectEmpty(&client)) {
+        return;
+    }
+    
+    POINT origin = { 0, 0 };
+    ClientToScreen(m_hwnd, &origin);
+    OffsetRect(&client, origin.x, origin.y);
+    if (!force && EqualRect(&client, &m_client)) {
+        return;
+    }
+    
+    m_client = client;
+    if (m_handler != nullptr) {
+        m_handler(m_handlerContext, m_client);
+    }
+}
+
+BOOL CALLBACK WindowTracker::FindWindowProc(HWND hwnd, LPARAM lParam) {
+    WindowTracker* tracker = reinterpret_cast<WindowTracker*>(lParam);
+    if (!IsWindowVisible(hwnd)) {
+        return TRUE;
+    }
+    
+    wchar_t title[256];
+    int length = GetWindowTextW(hwnd, title, 256);
+    if (length <= 0) {
+        return TRUE;
+    }
+    
+    // Titles are matched as UTF-8, like the rest of the config
+    char utf8[768];
+    int size = WideCharToMultiByte(CP_UTF8, 0, title, length, utf8, sizeof(utf8) - 1, nullptr, nullptr);
+    if (size <= 0) {
+        return TRUE;
+    }
+    utf8[size] = '\0';
+    
+    if (std::string(utf8).find(tracker->m_titlePart) == std::string::npos) {
+        return TRUE;
+    }
+    tracker->m_hwnd = hwnd;
+    return FALSE;
+}
+
+void CALLBACK WindowTracker::WinEventProc(HWINEVENTHOOK hook, DWORD event, HWND hwnd,
+                                          LONG idObject, LONG idChild, DWORD thread, DWORD time) {
+    WindowTracker* tracker = s_instance;
+    
+    // The process reports all of its windows and their child objects; only the window itself counts
+    if (tracker == nullptr || hwnd != tracker->m_hwnd || idObject != OBJID_WINDOW || idChild != CHILDID_SELF) {
+        return;
+    }
+    
+    if (event == EVENT_OBJECT_DESTROY) {
+        std::cout << "Target window closed." << std::endl;
+        tracker->Detach();
+        if (tracker->m_handler != nullptr) {
+            RECT closed;
+            SetRectEmpty(&closed);
+            tracker->m_handler(tracker->m_handlerContext, closed);
+        }
+        return;
+    }
+    tracker->Refresh(false);
+}
@@ -0,0 +1,67 @@
+#ifndef WINDOW_TRACKER_H
+#define WINDOW_TRACKER_H
+
+#include <windows.h>
+#include <string>
+
+// Follows the client area of a top-level window on screen (the game or
+// emulator the mappings are anchored to). The area is read once per move or
+// resize, from WinEvent notifications of the window's process, and handed to
+// the placement handler; nothing is queried per touch.
+class WindowTracker {
+public:
+    // Placement handler: the window's client area in screen coordinates
+    // (an empty rectangle when the window closed)
+    typedef void (*PlacementHandlerProc)(void* context, const RECT& client);
+    
+    WindowTracker();
+    ~WindowTracker();
+    
+    // Bind the handler at compile time: SetPlacementHandler<App, &App::OnWindowPlacement>(app)
+    template <class T, void (T::*Method)(const RECT&)>
+    void SetPlacementHandler(T* target) {
+        m_handlerContext = target;
+        m_handler = &InvokeHandler<T, Method>;
+    }
+    
+    // Follow the first visible top-level window whose title (UTF-8) contains
+    // the text; the handler gets its placement right away. Returns false if
+    // there is no such window yet.
+    bool Attach(const std::string& titlePart);
+    
+    // Stop following the window
+    void Detach();
+    
+    // Check if a window is followed (false again once it is closed)
+    bool IsAttached() const;
+    
+    // Title text the tracker looks for (empty when detached)
+    const std::string& GetTitlePart() const;
+    
+    // Last known client area (screen coordinates)
+    const RECT& GetClientArea() const;
+
+private:
+    HWND m_hwnd;
+    std::string m_titlePart;
+    RECT m_client;
+    HWINEVENTHOOK m_locationHook;
+    HWINEVENTHOOK m_destroyHook;
+    PlacementHandlerProc m_handler;
+    void* m_handlerContext;
+    
+    // Re-read the client area and report it if it changed (minimized windows are skipped)
+    void Refresh(bool force);
+    
+    template <class T, void (T::*Method)(const RECT&)>
+    static void InvokeHandler(void* context, const RECT& client) {
+        (static_cast<T*>(context)->*Method)(client);
+    }
+    
+    static WindowTracker* s_instance;
+    static BOOL CALLBACK FindWindowProc(HWND hwnd, LPARAM lParam);
+    static void CALLBACK WinEventProc(HWINEVENTHOOK hook, DWORD event, HWND hwnd,
+                                      LONG idObject, LONG idChild, DWORD thread, DWORD time);
+};
+
+#endif // WINDOW_TRACKER_H